@@ -0,0 +1,69 @@
+# 
+# compare.py  Andrew Belles 
+# 
+# Diffs two bench/run.sh result files. Records are matched on bench name 
+# and parameters, and the median time ratio (new / old) is printed with the 
+# work and allocation counts that changed. Exits 1 when any record slowed 
+# by more than --threshold, so it can gate a commit 
+# 
+# usage: python bench/compare.py old.jsonl new.jsonl [--threshold 0.05] 
+# 
+
+import argparse, json, sys 
+
+def load(path): 
+    meta, records = {}, {} 
+    with open(path) as f: 
+        for line in f: 
+            line = line.strip() 
+            if not line: 
+                continue 
+            r = json.loads(line) 
+            if "meta" in r: 
+                meta = r["meta"] 
+                continue 
+            key = (r["bench"], tuple(sorted(r["params"].items()))) 
+            records[key] = r 
+    return meta, records 
+
+def label(key): 
+    name, params = key 
+    return name + " " + " ".join(f"{k}={v:g}" for k, v in params) 
+
+def main(): 
+    parser = argparse.ArgumentParser() 
+    parser.add_argument("old") 
+    parser.add_argument("new") 
+    parser.add_argument("--threshold", type=float, default=0.05, 
+                        help="relative slowdown that counts as a regression") 
+    args = parser.parse_args() 
+
+    old_meta, old = load(args.old) 
+    new_meta, new = load(args.new) 
+    print(f"old {old_meta.get('commit', '?')}  new {new_meta.get('commit', '?')}") 
+    if old_meta.get("cpu") != new_meta.get("cpu"): 
+        print("warning: results come from different cpus") 
+
+    regressions = 0 
+    print(f"{'benchmark':<52} {'old ns':>12} {'new ns':>12} {'ratio':>7}  changes") 
+    for key in sorted(old.keys() & new.keys()): 
+        a, b = old[key], new[key] 
+        ratio = b["ns_median"] / a["ns_median"] if a["ns_median"] > 0 else float("nan") 
+        changes = [f"{f} {a[f]}->{b[f]}" for f in ("steps", "evals", "allocs", "bytes") 
+                   if a.get(f) != b.get(f)] 
+        flag = "" 
+        if ratio > 1.0 + args.threshold: 
+            flag = "  REGRESSION" 
+            regressions += 1 
+        print(f"{label(key):<52} {a['ns_median']:>12.0f} {b['ns_median']:>12.0f} " 
+              f"{ratio:>7.3f}  {', '.join(changes)}{flag}") 
+
+    for key in sorted(old.keys() - new.keys()): 
+        print(f"{label(key):<52} only in old") 
+    for key in sorted(new.keys() - old.keys()): 
+        print(f"{label(key):<52} only in new") 
+
+    sys.exit(1 if regressions else 0) 
+
+if __name__ == "__main__": 
+    main() 
@@ -0,0 +1,49 @@
+#!/usr/bin/bash 
+#
+# usage: 
+#   ./bench/run.sh [out.jsonl] 
+#
+# Builds every kernel's front end with the same flags into bench/bin and runs 
+# each --bench entry headless, one JSON record per line after a meta line. 
+# The default output is bench/results/<commit>.jsonl, diff two of them with 
+# bench/compare.py. Problem sizes can be overridden per kernel, e.g. 
+#   BESSEL="lanes=1024,1048576" ROMBERG="tol=1e-9" ./bench/run.sh 
+# CXXFLAGS is appended to the build, CXXFLAGS=-DINSTRUMENT compiles in the 
+# common/instrument.hpp counters (beam_shooting then reports its rate calls) 
+#
+
+set -e 
+
+root="$(cd "$(dirname "$0")/.." && pwd)" 
+bin="$root/bench/bin" 
+commit="$(git -C "$root" rev-parse --short HEAD 2>/dev/null || echo unknown)" 
+out="${1:-$root/bench/results/$commit.jsonl}" 
+
+mkdir -p "$bin" "$(dirname "$out")" 
+
+build() {
+  g++ -std=c++20 -O3 -march=native -pthread -I"${GPINC:-.}" ${CXXFLAGS:-} "$root/$1" -o "$bin/$2" -lm 
+}
+
+build lab1/recurrence.cpp recurrence 
+build lab4/washer.cpp washer 
+build lab5/quadrature.cpp quadrature 
+build lab6/stability.cpp stability 
+build lab7/shooting.cpp shooting 
+build testing/adaptive_multistep.cpp multistep 
+
+export NOPLOT=1 
+cpu="$(grep -m1 'model name' /proc/cpuinfo 2>/dev/null | cut -d: -f2 | sed 's/^ *//')" 
+
+{
+  printf '{"meta":{"commit":"%s","date":"%s","compiler":"g++ %s","cpu":"%s","threads":%s}}\n' \
+    "$commit" "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$(g++ -dumpfullversion)" "$cpu" "$(nproc)" 
+  "$bin/recurrence" --bench $BESSEL 
+  "$bin/quadrature" --bench $ROMBERG 
+  "$bin/washer" --bench $WASHER 
+  "$bin/stability" --bench $ABAM 
+  "$bin/shooting" --bench $BEAM 
+  "$bin/multistep" --bench $MULTIODE 
+} > "$out" 
+
+echo "wrote $out" 
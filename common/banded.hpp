@@ -0,0 +1,374 @@
+/*
+ * banded.hpp  Andrew Belles
+ *
+ * Direct solvers for banded systems without pivoting, meant for the
+ * diagonally dominant matrices finite differences produce. Tridiagonal
+ * keeps its Thomas factors so a fixed matrix (a Crank-Nicolson step, say)
+ * costs one forward and one backward sweep per solve. Banded is the same
+ * idea for any kl, ku. cyclic_reduction() trades the serial sweep for
+ * log2 n levels of independent rows that split across a pool, and Batch
+ * solves many systems of one size with the lanes of W systems interleaved
+ * so every row update is a W wide vector operation
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "pool.hpp"
+
+namespace band {
+
+/************ Tridiagonal *********************************/
+/*
+ * a is the sub diagonal (a[0] unused), b the diagonal, c the super diagonal
+ * (c[n - 1] unused). Throws on mismatched sizes or a zero pivot
+ */
+class Tridiagonal {
+public:
+  Tridiagonal() = default;
+
+  Tridiagonal(std::span<const double> a, std::span<const double> b, std::span<const double> c)
+  {
+    factor(a, b, c);
+  }
+
+  void
+  factor(std::span<const double> a, std::span<const double> b, std::span<const double> c)
+  {
+    const size_t n = b.size();
+    if ( n == 0 || a.size() != n || c.size() != n ) {
+      throw std::invalid_argument("tridiagonal bands must share a nonzero length");
+    }
+
+    a_.assign(a.begin(), a.end());
+    cp_.resize(n);
+    inv_.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      const double denom = b[i] - ( i > 0 ? a[i] * cp_[i - 1] : 0.0 );
+      if ( denom == 0.0 ) {
+        throw std::runtime_error("zero pivot in tridiagonal factorization");
+      }
+      inv_[i] = 1.0 / denom;
+      cp_[i]  = c[i] * inv_[i];
+    }
+  }
+
+  // d is overwritten by the solution
+  void
+  solve(std::span<double> d) const
+  {
+    const size_t n = size();
+    if ( d.size() != n ) {
+      throw std::invalid_argument("right hand side does not match the factorization");
+    }
+
+    d[0] *= inv_[0];
+    for (size_t i = 1; i < n; i++) {
+      d[i] = (d[i] - a_[i] * d[i - 1]) * inv_[i];
+    }
+    for (size_t i = n - 1; i-- > 0;) {
+      d[i] -= cp_[i] * d[i + 1];
+    }
+  }
+
+  size_t size() const { return inv_.size(); }
+
+private:
+  std::vector<double> a_{}, cp_{}, inv_{};
+};
+
+/************ band::apply() *******************************/
+// y = T x for the tridiagonal T = (a, b, c), y may not alias x
+inline void
+apply(std::span<const double> a, std::span<const double> b, std::span<const double> c,
+      std::span<const double> x, std::span<double> y)
+{
+  const size_t n = b.size();
+  if ( n == 0 ) {
+    return;
+  }
+  if ( n == 1 ) {
+    y[0] = b[0] * x[0];
+    return;
+  }
+
+  y[0] = b[0] * x[0] + c[0] * x[1];
+  for (size_t i = 1; i + 1 < n; i++) {
+    y[i] = a[i] * x[i - 1] + b[i] * x[i] + c[i] * x[i + 1];
+  }
+  y[n - 1] = a[n - 1] * x[n - 2] + b[n - 1] * x[n - 1];
+}
+
+/************ Banded **************************************/
+/*
+ * LU of a matrix with kl sub and ku super diagonals. Row i is stored as the
+ * kl + ku + 1 entries of columns [i - kl, i + ku], at(i, j) addresses them
+ * by matrix position. Doolittle without pivoting keeps the factors in the
+ * same band
+ */
+class Banded {
+public:
+  Banded(size_t n, size_t kl, size_t ku)
+    : n_(n), kl_(kl), ku_(ku), w_(kl + ku + 1), band_(n * (kl + ku + 1), 0.0)
+  {
+    if ( n == 0 ) {
+      throw std::invalid_argument("banded matrix needs at least one row");
+    }
+  }
+
+  double& at(size_t i, size_t j) { return band_[i * w_ + (j + kl_ - i)]; }
+  double at(size_t i, size_t j) const { return band_[i * w_ + (j + kl_ - i)]; }
+
+  // true for positions inside the band
+  bool
+  stored(size_t i, size_t j) const
+  {
+    return i < n_ && j < n_ && j + kl_ >= i && j <= i + ku_;
+  }
+
+  void
+  factor()
+  {
+    for (size_t k = 0; k < n_; k++) {
+      const double pivot = at(k, k);
+      if ( pivot == 0.0 ) {
+        throw std::runtime_error("zero pivot in banded factorization");
+      }
+
+      const size_t rows = std::min(n_, k + kl_ + 1), cols = std::min(n_, k + ku_ + 1);
+      for (size_t i = k + 1; i < rows; i++) {
+        const double l = (at(i, k) /= pivot);
+        for (size_t j = k + 1; j < cols; j++) {
+          at(i, j) -= l * at(k, j);
+        }
+      }
+    }
+    factored_ = true;
+  }
+
+  void
+  solve(std::span<double> d) const
+  {
+    if ( !factored_ ) {
+      throw std::logic_error("banded solve before factor");
+    }
+    if ( d.size() != n_ ) {
+      throw std::invalid_argument("right hand side does not match the factorization");
+    }
+
+    for (size_t i = 1; i < n_; i++) {
+      double acc = d[i];
+      for (size_t j = ( i > kl_ ) ? i - kl_ : 0; j < i; j++) {
+        acc -= at(i, j) * d[j];
+      }
+      d[i] = acc;
+    }
+    for (size_t i = n_; i-- > 0;) {
+      double acc = d[i];
+      for (size_t j = i + 1; j < std::min(n_, i + ku_ + 1); j++) {
+        acc -= at(i, j) * d[j];
+      }
+      d[i] = acc / at(i, i);
+    }
+  }
+
+  size_t size() const { return n_; }
+
+private:
+  size_t n_{0}, kl_{0}, ku_{0}, w_{1};
+  std::vector<double> band_{};
+  bool factored_{false};
+};
+
+/************ band::cyclic_reduction() ********************/
+/*
+ * Solves the tridiagonal (a, b, c) x = d in place in d. Level s folds every
+ * row i = 2s - 1 mod 2s into its neighbours i +- s, halving the system, and
+ * the back substitution unfolds them again. Rows of one level touch only
+ * rows of the other class, so with a pool each level is split into chunks
+ * of grain rows. About twice the work of Thomas, so it only pays once n is
+ * far beyond cache and there are cores to spare
+ */
+inline void
+cyclic_reduction(std::span<const double> a, std::span<const double> b,
+                 std::span<const double> c, std::span<double> d,
+                 ThreadPool* pool = nullptr, size_t grain = 8192)
+{
+  const size_t n = b.size();
+  if ( a.size() != n || c.size() != n || d.size() != n ) {
+    throw std::invalid_argument("cyclic reduction bands must share one length");
+  }
+  if ( n == 0 ) {
+    return;
+  }
+
+  std::vector<double> A(a.begin(), a.end()), B(b.begin(), b.end()), C(c.begin(), c.end());
+  A[0] = 0.0;
+  C[n - 1] = 0.0;
+
+  // fn(i) for rows first, first + step, ... below n, chunked onto the pool
+  auto rows = [&](size_t first, size_t step, auto&& fn) {
+    const size_t count = ( first < n ) ? (n - 1 - first) / step + 1 : 0;
+    if ( pool == nullptr || count <= grain ) {
+      for (size_t i = first; i < n; i += step) {
+        fn(i);
+      }
+      return;
+    }
+    const size_t chunks = (count + grain - 1) / grain;
+    pool->parallel_for(chunks, [&](size_t k) {
+      const size_t end = std::min(count, (k + 1) * grain);
+      for (size_t r = k * grain; r < end; r++) {
+        fn(first + r * step);
+      }
+    });
+  };
+
+  size_t s = 1;
+  for (; 2 * s <= n; s *= 2) {
+    rows(2 * s - 1, 2 * s, [&](size_t i) {
+      const size_t l = i - s;
+      const double alpha = -A[i] / B[l];
+      double gamma = 0.0;
+
+      B[i] += alpha * C[l];
+      d[i] += alpha * d[l];
+      A[i]  = alpha * A[l];
+      if ( i + s < n ) {
+        const size_t r = i + s;
+        gamma = -C[i] / B[r];
+        B[i] += gamma * A[r];
+        d[i] += gamma * d[r];
+      }
+      C[i] = ( i + s < n ) ? gamma * C[i + s] : 0.0;
+      if ( B[i] == 0.0 ) {
+        throw std::runtime_error("zero pivot in cyclic reduction");
+      }
+    });
+  }
+
+  // the one row left has no neighbours at stride s
+  d[s - 1] /= B[s - 1];
+  for (s /= 2; s >= 1; s /= 2) {
+    rows(s - 1, 2 * s, [&](size_t i) {
+      double acc = d[i];
+      if ( i >= s ) {
+        acc -= A[i] * d[i - s];
+      }
+      if ( i + s < n ) {
+        acc -= C[i] * d[i + s];
+      }
+      d[i] = acc / B[i];
+    });
+  }
+}
+
+/************ Batch ***************************************/
+/*
+ * Thomas factors of m independent n x n tridiagonal systems. Systems are
+ * grouped W to a block and interleaved, entry (system k, row i) lives at
+ * index(k, i) = ((k / W) n + i) W + k % W, so a row of a block is W
+ * contiguous lanes. The last block is padded with identity rows
+ */
+template<size_t W = 4>
+class Batch {
+public:
+  Batch(size_t systems, size_t n)
+    : m_(systems), n_(n), blocks_((systems + W - 1) / W),
+      a_(blocks_ * n * W, 0.0), cp_(blocks_ * n * W, 0.0), inv_(blocks_ * n * W, 1.0)
+  {
+    if ( n == 0 ) {
+      throw std::invalid_argument("batched systems need at least one row");
+    }
+  }
+
+  // storage slots for coefficients and right hand sides
+  size_t length() const { return blocks_ * n_ * W; }
+  size_t index(size_t k, size_t i) const { return ((k / W) * n_ + i) * W + k % W; }
+  size_t systems() const { return m_; }
+  size_t size() const { return n_; }
+
+  // a, b, c in the interleaved layout of length(); padded lanes are ignored
+  void
+  factor(std::span<const double> a, std::span<const double> b, std::span<const double> c)
+  {
+    if ( a.size() != length() || b.size() != length() || c.size() != length() ) {
+      throw std::invalid_argument("batched bands must use the interleaved length");
+    }
+
+    for (size_t blk = 0; blk < blocks_; blk++) {
+      const size_t live = std::min(W, m_ - blk * W);
+      for (size_t i = 0; i < n_; i++) {
+        const size_t at = (blk * n_ + i) * W;
+        double denom[W];
+        for (size_t l = 0; l < W; l++) {
+          const double bl = ( l < live ) ? b[at + l] : 1.0;
+          const double al = ( l < live && i > 0 ) ? a[at + l] : 0.0;
+          const double cl = ( l < live ) ? c[at + l] : 0.0;
+          denom[l] = bl - ( i > 0 ? al * cp_[at - W + l] : 0.0 );
+          a_[at + l]  = al;
+          cp_[at + l] = cl;
+        }
+        for (size_t l = 0; l < W; l++) {
+          if ( denom[l] == 0.0 ) {
+            throw std::runtime_error("zero pivot in batched tridiagonal factorization");
+          }
+          inv_[at + l] = 1.0 / denom[l];
+          cp_[at + l] *= inv_[at + l];
+        }
+      }
+    }
+  }
+
+  // every system at once, d in the interleaved layout
+  void
+  solve(std::span<double> d, ThreadPool* pool = nullptr) const
+  {
+    if ( d.size() != length() ) {
+      throw std::invalid_argument("batched right hand side must use the interleaved length");
+    }
+    if ( pool == nullptr || blocks_ == 1 ) {
+      for (size_t blk = 0; blk < blocks_; blk++) {
+        block_(blk, d.data());
+      }
+      return;
+    }
+    pool->parallel_for(blocks_, [&](size_t blk) { block_(blk, d.data()); });
+  }
+
+private:
+  size_t m_{0}, n_{0}, blocks_{0};
+  std::vector<double> a_{}, cp_{}, inv_{};
+
+  void
+  block_(size_t blk, double* __restrict d) const
+  {
+    const size_t base = blk * n_ * W;
+    const double* __restrict a   = a_.data() + base;
+    const double* __restrict cp  = cp_.data() + base;
+    const double* __restrict inv = inv_.data() + base;
+    d += base;
+
+    for (size_t l = 0; l < W; l++) {
+      d[l] *= inv[l];
+    }
+    for (size_t i = 1; i < n_; i++) {
+      for (size_t l = 0; l < W; l++) {
+        d[i * W + l] = (d[i * W + l] - a[i * W + l] * d[(i - 1) * W + l]) * inv[i * W + l];
+      }
+    }
+    for (size_t i = n_ - 1; i-- > 0;) {
+      for (size_t l = 0; l < W; l++) {
+        d[i * W + l] -= cp[i * W + l] * d[(i + 1) * W + l];
+      }
+    }
+  }
+};
+
+}  // namespace band
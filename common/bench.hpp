@@ -0,0 +1,290 @@
+/*
+ * bench.hpp  Andrew Belles
+ *
+ * Headless benchmark harness behind every front end's --bench mode. A kernel
+ * is a callable returning the Work it did (steps and, where the kernel
+ * counts them, rate or integrand evaluations). measure() runs it once to
+ * warm up and then reps times, and the Record holds the min and median wall
+ * time, ns per step, evaluations per second, heap allocations and bytes per
+ * rep, and hardware cache references and misses when perf_event_open is
+ * permitted. emit() writes the Record as one JSON line on stdout so runs on
+ * different commits can be diffed (bench/compare.py). Parameters arrive as
+ * key=value arguments, a comma list sweeps a size
+ *
+ * Replaces the global operator new to count allocations, so include it from
+ * the program's one translation unit only
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+// process wide, every thread's allocations land here
+inline std::atomic<uint64_t> allocs{0}, bytes{0};
+
+}  // namespace bench
+
+// the replacement pair is malloc/free, which gcc cannot see through 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void*
+operator new(size_t size)
+{
+  bench::allocs.fetch_add(1, std::memory_order_relaxed);
+  bench::bytes.fetch_add(size, std::memory_order_relaxed);
+  if ( void* p = std::malloc(size ? size : 1) ) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+#pragma GCC diagnostic pop
+
+namespace bench {
+
+struct Work {
+  uint64_t steps{0};
+  uint64_t evals{0};  // 0 when the kernel does not count them
+};
+
+/************ bench::Perf *********************************/
+/*
+ * Hardware cache references and misses of this process and the threads it
+ * spawns after start(), user space only. available() is false when the
+ * kernel refuses the events (containers, perf_event_paranoid)
+ */
+class Perf {
+public:
+  Perf()
+  {
+#if defined(__linux__)
+    fd_[0] = open_(PERF_COUNT_HW_CACHE_REFERENCES);
+    fd_[1] = open_(PERF_COUNT_HW_CACHE_MISSES);
+#endif
+  }
+
+  ~Perf()
+  {
+    for (int fd : fd_) {
+      if ( fd >= 0 ) {
+        close(fd);
+      }
+    }
+  }
+
+  Perf(const Perf&) = delete;
+  Perf& operator=(const Perf&) = delete;
+
+  bool available() const { return fd_[0] >= 0 && fd_[1] >= 0; }
+
+  void
+  start()
+  {
+#if defined(__linux__)
+    for (int fd : fd_) {
+      if ( fd >= 0 ) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  // {references, misses} since start()
+  std::pair<uint64_t, uint64_t>
+  stop()
+  {
+    uint64_t v[2]{0, 0};
+#if defined(__linux__)
+    for (size_t i = 0; i < 2; i++) {
+      if ( fd_[i] >= 0 ) {
+        ioctl(fd_[i], PERF_EVENT_IOC_DISABLE, 0);
+        if ( read(fd_[i], &v[i], sizeof(v[i])) != sizeof(v[i]) ) {
+          v[i] = 0;
+        }
+      }
+    }
+#endif
+    return {v[0], v[1]};
+  }
+
+private:
+  int fd_[2]{-1, -1};
+
+#if defined(__linux__)
+  static int
+  open_(uint64_t config)
+  {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+#endif
+};
+
+/************ bench::Args *********************************/
+// key=value arguments after --bench, a value may be a comma separated list
+class Args {
+public:
+  Args(int argc, char* argv[], int first = 2)
+  {
+    for (int i = first; i < argc; i++) {
+      const char* eq = std::strchr(argv[i], '=');
+      if ( eq == nullptr || eq == argv[i] ) {
+        throw std::invalid_argument(std::string("expected key=value, got ") + argv[i]);
+      }
+      pairs_.emplace_back(std::string(argv[i], static_cast<size_t>(eq - argv[i])), eq + 1);
+    }
+  }
+
+  // throws on a key the kernel does not take, so typos do not bench defaults
+  void
+  allow(std::initializer_list<const char*> keys) const
+  {
+    for (auto& [k, v] : pairs_) {
+      if ( std::none_of(keys.begin(), keys.end(), [&](const char* a) { return k == a; }) ) {
+        throw std::invalid_argument("unknown bench parameter " + k);
+      }
+    }
+  }
+
+  std::vector<double>
+  list(const char* key, std::vector<double> fallback) const
+  {
+    for (auto& [k, v] : pairs_) {
+      if ( k != key ) {
+        continue;
+      }
+      std::vector<double> out;
+      size_t pos = 0;
+      while ( pos <= v.size() ) {
+        const size_t end = std::min(v.find(',', pos), v.size());
+        out.push_back(std::stod(v.substr(pos, end - pos)));
+        pos = end + 1;
+      }
+      return out;
+    }
+    return fallback;
+  }
+
+  double get(const char* key, double fallback) const { return list(key, {fallback}).front(); }
+
+private:
+  std::vector<std::pair<std::string, std::string>> pairs_{};
+};
+
+/************ bench::Record *******************************/
+struct Record {
+  std::string name;
+  std::vector<std::pair<std::string, double>> params{};
+  size_t reps{0};
+  Work work{};
+  double ns_min{0.0}, ns_median{0.0};
+  double allocs{0.0}, bytes{0.0};  // per rep
+  bool perf{false};
+  double references{0.0}, misses{0.0};  // per rep
+};
+
+/************ bench::measure() ****************************/
+template<typename Kernel>
+inline Record
+measure(std::string name, std::vector<std::pair<std::string, double>> params, size_t reps,
+        Kernel&& kernel)
+{
+  using clock = std::chrono::steady_clock;
+  reps = std::max<size_t>(1, reps);
+
+  Record rec{std::move(name), std::move(params), reps};
+  rec.work = kernel();
+
+  Perf perf;
+  std::vector<double> ns(reps);
+  const uint64_t a0 = allocs.load(), b0 = bytes.load();
+  perf.start();
+  for (size_t r = 0; r < reps; r++) {
+    const auto t0 = clock::now();
+    kernel();
+    const auto t1 = clock::now();
+    ns[r] = std::chrono::duration<double, std::nano>(t1 - t0).count();
+  }
+  const auto [refs, misses] = perf.stop();
+  const uint64_t a1 = allocs.load(), b1 = bytes.load();
+
+  std::sort(ns.begin(), ns.end());
+  const double per = 1.0 / static_cast<double>(reps);
+  rec.ns_min = ns.front();
+  rec.ns_median = ( reps % 2 ) ? ns[reps / 2] : 0.5 * (ns[reps / 2 - 1] + ns[reps / 2]);
+  rec.allocs = static_cast<double>(a1 - a0) * per;
+  rec.bytes = static_cast<double>(b1 - b0) * per;
+  rec.perf = perf.available();
+  rec.references = static_cast<double>(refs) * per;
+  rec.misses = static_cast<double>(misses) * per;
+  return rec;
+}
+
+/************ bench::emit() *******************************/
+inline void
+emit(const Record& r, std::FILE* out = stdout)
+{
+  const double steps = static_cast<double>(r.work.steps);
+  const double evals = static_cast<double>(r.work.evals);
+
+  std::fprintf(out, "{\"bench\":\"%s\",\"params\":{", r.name.c_str());
+  for (size_t i = 0; i < r.params.size(); i++) {
+    std::fprintf(out, "%s\"%s\":%.12g", i ? "," : "", r.params[i].first.c_str(),
+                 r.params[i].second);
+  }
+  std::fprintf(out, "},\"reps\":%zu,\"steps\":%llu,", r.reps,
+               static_cast<unsigned long long>(r.work.steps));
+  if ( r.work.evals > 0 ) {
+    std::fprintf(out, "\"evals\":%llu,\"evals_per_sec\":%.6g,",
+                 static_cast<unsigned long long>(r.work.evals), evals / (1e-9 * r.ns_median));
+  } else {
+    std::fprintf(out, "\"evals\":null,\"evals_per_sec\":null,");
+  }
+  std::fprintf(out, "\"ns_min\":%.1f,\"ns_median\":%.1f,\"ns_per_step\":%.6g,", r.ns_min,
+               r.ns_median, ( steps > 0.0 ) ? r.ns_median / steps : 0.0);
+  std::fprintf(out, "\"allocs\":%.6g,\"bytes\":%.6g,", r.allocs, r.bytes);
+  if ( r.perf ) {
+    std::fprintf(out, "\"cache_references\":%.6g,\"cache_misses\":%.6g}\n", r.references,
+                 r.misses);
+  } else {
+    std::fprintf(out, "\"cache_references\":null,\"cache_misses\":null}\n");
+  }
+  std::fflush(out);
+}
+
+}  // namespace bench
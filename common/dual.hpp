@@ -0,0 +1,195 @@
+/*
+ * dual.hpp  Andrew Belles
+ *
+ * Forward mode automatic differentiation. Dual<N> carries a value and its
+ * gradient along N seed directions, and every operation applies the chain
+ * rule as it goes, so a residual written once over a scalar template gives
+ * its Jacobian (N = unknowns) or one Jacobian-vector product (N = 1, seeded
+ * with the vector) from a single evaluation. Shared subexpressions are
+ * computed once for the value and every derivative, and no extra residual
+ * evaluations are spent on differences
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace ad {
+
+template<size_t N>
+struct Dual {
+  double v{0.0};
+  std::array<double, N> d{};
+
+  Dual() = default;
+  Dual(double value) : v(value) {}
+  Dual(double value, const std::array<double, N>& grad) : v(value), d(grad) {}
+
+  // independent variable k of N
+  static Dual
+  variable(double value, size_t k)
+  {
+    Dual x(value);
+    x.d[k] = 1.0;
+    return x;
+  }
+
+  Dual& operator+=(const Dual& b) { return *this = *this + b; }
+  Dual& operator-=(const Dual& b) { return *this = *this - b; }
+  Dual& operator*=(const Dual& b) { return *this = *this * b; }
+  Dual& operator/=(const Dual& b) { return *this = *this / b; }
+
+  /************ arithmetic ********************************/
+  friend Dual
+  operator+(const Dual& a, const Dual& b)
+  {
+    Dual r(a.v + b.v);
+    for (size_t k = 0; k < N; k++) {
+      r.d[k] = a.d[k] + b.d[k];
+    }
+    return r;
+  }
+
+  friend Dual
+  operator-(const Dual& a, const Dual& b)
+  {
+    Dual r(a.v - b.v);
+    for (size_t k = 0; k < N; k++) {
+      r.d[k] = a.d[k] - b.d[k];
+    }
+    return r;
+  }
+
+  friend Dual
+  operator-(const Dual& a)
+  {
+    Dual r(-a.v);
+    for (size_t k = 0; k < N; k++) {
+      r.d[k] = -a.d[k];
+    }
+    return r;
+  }
+
+  friend Dual
+  operator*(const Dual& a, const Dual& b)
+  {
+    Dual r(a.v * b.v);
+    for (size_t k = 0; k < N; k++) {
+      r.d[k] = a.d[k] * b.v + a.v * b.d[k];
+    }
+    return r;
+  }
+
+  friend Dual
+  operator/(const Dual& a, const Dual& b)
+  {
+    const double inv = 1.0 / b.v;
+    Dual r(a.v * inv);
+    for (size_t k = 0; k < N; k++) {
+      r.d[k] = (a.d[k] - r.v * b.d[k]) * inv;
+    }
+    return r;
+  }
+
+  friend bool operator<(const Dual& a, const Dual& b) { return a.v < b.v; }
+  friend bool operator>(const Dual& a, const Dual& b) { return a.v > b.v; }
+};
+
+/************ elementary functions ************************/
+// f(a) with f'(a) = df, the chain rule for every direction
+template<size_t N>
+inline Dual<N>
+chain(const Dual<N>& a, double f, double df)
+{
+  Dual<N> r(f);
+  for (size_t k = 0; k < N; k++) {
+    r.d[k] = df * a.d[k];
+  }
+  return r;
+}
+
+template<size_t N>
+inline Dual<N>
+sqrt(const Dual<N>& a)
+{
+  const double s = std::sqrt(a.v);
+  return chain(a, s, 0.5 / s);
+}
+
+template<size_t N>
+inline Dual<N>
+exp(const Dual<N>& a)
+{
+  const double e = std::exp(a.v);
+  return chain(a, e, e);
+}
+
+template<size_t N>
+inline Dual<N>
+log(const Dual<N>& a)
+{
+  return chain(a, std::log(a.v), 1.0 / a.v);
+}
+
+template<size_t N>
+inline Dual<N>
+pow(const Dual<N>& a, double p)
+{
+  return chain(a, std::pow(a.v, p), p * std::pow(a.v, p - 1.0));
+}
+
+template<size_t N>
+inline Dual<N>
+sin(const Dual<N>& a)
+{
+  return chain(a, std::sin(a.v), std::cos(a.v));
+}
+
+template<size_t N>
+inline Dual<N>
+cos(const Dual<N>& a)
+{
+  return chain(a, std::cos(a.v), -std::sin(a.v));
+}
+
+template<size_t N>
+inline Dual<N>
+abs(const Dual<N>& a)
+{
+  return ( a.v < 0.0 ) ? -a : a;
+}
+
+// plain doubles pass through, so residuals can call value() on either type
+inline double value(double a) { return a; }
+
+template<size_t N>
+inline double value(const Dual<N>& a) { return a.v; }
+
+/************ ad::jacobian() ******************************/
+/*
+ * F and its row-major Jacobian at x for f(const std::array<Dual<N>, N>&)
+ * returning std::array<Dual<N>, M>, in one evaluation
+ */
+template<size_t N, size_t M = N, typename Fn>
+inline void
+jacobian(Fn&& f, const std::array<double, N>& x, std::array<double, M>& F,
+         std::array<double, M * N>& J)
+{
+  std::array<Dual<N>, N> X;
+  for (size_t k = 0; k < N; k++) {
+    X[k] = Dual<N>::variable(x[k], k);
+  }
+
+  const std::array<Dual<N>, M> R = f(X);
+  for (size_t i = 0; i < M; i++) {
+    F[i] = R[i].v;
+    for (size_t k = 0; k < N; k++) {
+      J[i * N + k] = R[i].d[k];
+    }
+  }
+}
+
+}  // namespace ad
@@ -0,0 +1,343 @@
+/*
+ * implicit.hpp  Andrew Belles
+ *
+ * Implicit steppers for stiff problems, BDF1-5 and Crank-Nicolson, with the
+ * same step(t, y, h) shape as the explicit ones so they run under
+ * integrate(). Every step solves y = psi + gh f(t, y) with a simplified
+ * Newton iteration on I - gh J; the Jacobian is taken by forward differences
+ * and its LU factors are kept across steps, refreshed only when the
+ * iteration contracts slowly or fails, and refactored when gh changes
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "integrate.hpp"
+
+namespace ode {
+
+/************ flat component access ***********************/
+template<typename S>
+struct Components;
+
+template<>
+struct Components<double> {
+  static constexpr size_t n = 1;
+  static double& at(double& s, size_t) { return s; }
+  static double at(const double& s, size_t) { return s; }
+};
+
+template<size_t N, size_t W>
+struct Components<Vec<N, W>> {
+  static constexpr size_t n = N * W;
+  static double& at(Vec<N, W>& s, size_t i) { return s.v[i]; }
+  static double at(const Vec<N, W>& s, size_t i) { return s.v[i]; }
+};
+
+/************ Newton **************************************/
+struct NewtonOptions {
+  double atol{1e-10}, rtol{1e-10};   // on the Newton update
+  size_t iters{7};
+  double slow{0.3};                  // contraction that marks the Jacobian stale
+};
+
+/*
+ * Solves y = psi + gh f(t, y) by simplified Newton on M = I - gh J. The
+ * factored M is reused while it converges, a slow contraction marks J
+ * stale for the next solve and a failure retries once with a fresh J
+ */
+template<typename S, typename Rate>
+class Newton {
+  using C = Components<S>;
+  static constexpr size_t n = C::n;
+
+public:
+  Newton(Rate& f, NewtonOptions opt) : f_(f), opt_(opt), jac_(n * n), lu_(n * n), piv_(n) {}
+
+  // y holds the initial guess on entry, the solution on success
+  bool
+  solve(double t, double gh, const S& psi, S& y)
+  {
+    PROBE_TIME(Newton);
+    const S guess = y;
+    const Tolerance tol{opt_.atol, opt_.rtol};
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+      if ( stale_ ) {
+        jacobian_(t, y);
+      }
+      if ( stale_ || gh != gh_ ) {
+        factor_(gh);
+        stale_ = false;
+      }
+
+      double prev = std::numeric_limits<double>::infinity();
+      for (size_t it = 0; it < opt_.iters; it++) {
+        S dy = psi + gh * f_(t, y) - y;
+        evals_++;
+        lu_solve_(dy);
+        y = y + dy;
+        iterations_++;
+        PROBE_ADD(RateEvals, 1);
+        PROBE_ADD(NewtonIterations, 1);
+
+        const double d = error_norm(dy, y, y, tol);
+        const double rate = ( it > 0 ) ? d / prev : 0.0;
+        if ( d <= 1.0 ) {
+          if ( rate > opt_.slow ) {
+            stale_ = true;
+          }
+          return true;
+        }
+        if ( rate > 0.9 ) {
+          break;
+        }
+        prev = d;
+      }
+
+      // diverged or ran out of iterations, start over on a fresh Jacobian
+      stale_ = true;
+      y = guess;
+    }
+    return false;
+  }
+
+  void reset() { stale_ = true; }
+  size_t evals() const { return evals_; }
+  size_t jacobians() const { return jacobians_; }
+  size_t factorizations() const { return factorizations_; }
+  size_t iterations() const { return iterations_; }
+
+private:
+  Rate& f_;
+  NewtonOptions opt_{};
+  std::vector<double> jac_{}, lu_{};
+  std::vector<size_t> piv_{};
+  double gh_{0.0};
+  bool stale_{true};
+  size_t evals_{0}, jacobians_{0}, factorizations_{0}, iterations_{0};
+
+  // forward difference columns of df/dy at (t, y)
+  void
+  jacobian_(double t, const S& y)
+  {
+    const S f0 = f_(t, y);
+    for (size_t j = 0; j < n; j++) {
+      S yp = y;
+      const double yj = C::at(y, j);
+      const double d = std::sqrt(std::numeric_limits<double>::epsilon())
+                     * std::max(1.0, std::abs(yj));
+      C::at(yp, j) = yj + d;
+      const S fp = f_(t, yp);
+      for (size_t i = 0; i < n; i++) {
+        jac_[i * n + j] = (C::at(fp, i) - C::at(f0, i)) / d;
+      }
+    }
+    evals_ += n + 1;
+    jacobians_++;
+    PROBE_ADD(RateEvals, n + 1);
+    PROBE_ADD(Jacobians, 1);
+  }
+
+  // LU of I - gh J with partial pivoting, in place in lu_
+  void
+  factor_(double gh)
+  {
+    for (size_t i = 0; i < n * n; i++) {
+      lu_[i] = -gh * jac_[i];
+    }
+    for (size_t i = 0; i < n; i++) {
+      lu_[i * n + i] += 1.0;
+    }
+
+    for (size_t c = 0; c < n; c++) {
+      size_t p = c;
+      for (size_t r = c + 1; r < n; r++) {
+        if ( std::abs(lu_[r * n + c]) > std::abs(lu_[p * n + c]) ) {
+          p = r;
+        }
+      }
+      piv_[c] = p;
+      if ( p != c ) {
+        for (size_t j = 0; j < n; j++) {
+          std::swap(lu_[c * n + j], lu_[p * n + j]);
+        }
+      }
+      if ( lu_[c * n + c] == 0.0 ) {
+        throw std::runtime_error("singular Newton matrix");
+      }
+
+      const double inv = 1.0 / lu_[c * n + c];
+      for (size_t r = c + 1; r < n; r++) {
+        const double l = (lu_[r * n + c] *= inv);
+        if ( l != 0.0 ) {
+          for (size_t j = c + 1; j < n; j++) {
+            lu_[r * n + j] -= l * lu_[c * n + j];
+          }
+        }
+      }
+    }
+    gh_ = gh;
+    factorizations_++;
+  }
+
+  void
+  lu_solve_(S& b) const
+  {
+    for (size_t c = 0; c < n; c++) {
+      if ( piv_[c] != c ) {
+        std::swap(C::at(b, c), C::at(b, piv_[c]));
+      }
+    }
+    for (size_t r = 1; r < n; r++) {
+      double acc = C::at(b, r);
+      for (size_t j = 0; j < r; j++) {
+        acc -= lu_[r * n + j] * C::at(b, j);
+      }
+      C::at(b, r) = acc;
+    }
+    for (size_t r = n; r-- > 0;) {
+      double acc = C::at(b, r);
+      for (size_t j = r + 1; j < n; j++) {
+        acc -= lu_[r * n + j] * C::at(b, j);
+      }
+      C::at(b, r) = acc / lu_[r * n + r];
+    }
+  }
+};
+
+/************ coefficient tables **************************/
+/*
+ * y_{n+1} + sum_j a[j] y_{n-j} = h b f_{n+1}, row k - 1 is BDFk
+ */
+struct BDFRow {
+  std::array<double, 5> a;
+  double b;
+};
+
+inline constexpr std::array<BDFRow, 5> BDFTable{{
+  {{-1.0, 0.0, 0.0, 0.0, 0.0}, 1.0},
+  {{-4.0 / 3.0, 1.0 / 3.0, 0.0, 0.0, 0.0}, 2.0 / 3.0},
+  {{-18.0 / 11.0, 9.0 / 11.0, -2.0 / 11.0, 0.0, 0.0}, 6.0 / 11.0},
+  {{-48.0 / 25.0, 36.0 / 25.0, -16.0 / 25.0, 3.0 / 25.0, 0.0}, 12.0 / 25.0},
+  {{-300.0 / 137.0, 300.0 / 137.0, -200.0 / 137.0, 75.0 / 137.0, -12.0 / 137.0}, 60.0 / 137.0}
+}};
+
+/************ implicit steppers ***************************/
+/*
+ * Fixed step BDF of order K (1 to 5). The order ramps up from BDF1 as
+ * states accumulate, and any change of h restarts the history there since
+ * the fixed coefficients assume uniform spacing. Throws if Newton fails
+ */
+template<typename S, typename Rate, size_t K = 2>
+class BDF {
+  static_assert(K >= 1 && K <= 5, "BDF is only zero stable through order 5");
+
+public:
+  BDF(Rate f, NewtonOptions opt = {}) : f_(std::move(f)), newton_(f_, opt) {}
+
+  // newton_ refers to f_
+  BDF(const BDF&) = delete;
+  BDF& operator=(const BDF&) = delete;
+
+  // earlier states at the coming step size, oldest first, to start above BDF1
+  void
+  seed(const S& y, double h)
+  {
+    if ( h != h_ ) {
+      hist_.clear();
+      h_ = h;
+    }
+    hist_.push(y);
+  }
+
+  void
+  reset()
+  {
+    hist_.clear();
+    newton_.reset();
+  }
+
+  void
+  step(double t, S& y, double h)
+  {
+    if ( h != h_ || hist_.size() == 0 ) {
+      hist_.clear();
+      hist_.push(y);
+      h_ = h;
+    }
+
+    const size_t k = hist_.size();
+    const BDFRow& row = BDFTable[k - 1];
+    S psi = (-row.a[0]) * hist_[0];
+    for (size_t j = 1; j < k; j++) {
+      psi = psi + (-row.a[j]) * hist_[j];
+    }
+
+    // linear extrapolation of the history as the Newton guess
+    S y1 = ( k > 1 ) ? 2.0 * hist_[0] - hist_[1] : hist_[0];
+    if ( !newton_.solve(t + h, row.b * h, psi, y1) ) {
+      throw std::runtime_error("BDF Newton corrector failed to converge");
+    }
+    y = y1;
+    hist_.push(y1);
+    PROBE_ADD(StepsAccepted, 1);
+  }
+
+  size_t order() const { return hist_.size(); }
+  const Newton<S, Rate>& newton() const { return newton_; }
+
+private:
+  Rate f_;
+  Newton<S, Rate> newton_;
+  Ring<S, K> hist_{};
+  double h_{0.0};
+};
+
+/*
+ * Implicit trapezoid, y_{n+1} = y_n + h / 2 (f_n + f_{n+1}). A-stable but
+ * not L-stable, so very stiff modes ring rather than damp
+ */
+template<typename S, typename Rate>
+class CrankNicolson {
+public:
+  CrankNicolson(Rate f, NewtonOptions opt = {}) : f_(std::move(f)), newton_(f_, opt) {}
+
+  CrankNicolson(const CrankNicolson&) = delete;
+  CrankNicolson& operator=(const CrankNicolson&) = delete;
+
+  void reset() { newton_.reset(); }
+
+  void
+  step(double t, S& y, double h)
+  {
+    const S psi = y + (0.5 * h) * f_(t, y);
+    evals_++;
+    PROBE_ADD(RateEvals, 1);
+
+    S y1 = y;
+    if ( !newton_.solve(t + h, 0.5 * h, psi, y1) ) {
+      throw std::runtime_error("Crank-Nicolson Newton corrector failed to converge");
+    }
+    y = y1;
+    PROBE_ADD(StepsAccepted, 1);
+  }
+
+  size_t evals() const { return evals_ + newton_.evals(); }
+  const Newton<S, Rate>& newton() const { return newton_; }
+
+private:
+  Rate f_;
+  Newton<S, Rate> newton_;
+  size_t evals_{0};
+};
+
+}  // namespace ode
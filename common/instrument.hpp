@@ -0,0 +1,277 @@
+/*
+ * instrument.hpp  Andrew Belles
+ *
+ * Work counters and scoped timers for the solver hot paths, compiled in
+ * only with -DINSTRUMENT. Rate and integrand evaluations, Newton (and
+ * Levenberg-Marquardt) iterations, Jacobians, accepted and rejected steps
+ * and LAPACK calls are added to a per thread tally through PROBE_ADD, and
+ * PROBE_TIME charges the enclosing scope's wall time to one Timer. Without
+ * the flag both macros expand to nothing and their arguments are never
+ * evaluated, so the engines pay nothing in normal builds.
+ *
+ * total() sums every live thread and the threads that have exited, so a
+ * solve is measured as the difference of two totals taken while the pool
+ * is idle. Setting PROBE_JSON=path writes the process total there as JSON
+ * at exit ("-" for stderr). Timers are inclusive and may nest, a Newton
+ * solve inside an integration is charged to both
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+namespace probe {
+
+#if defined(INSTRUMENT)
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+enum Counter : size_t {
+  RateEvals,          // calls of an ODE rate, a lane batched call counts once
+  IntegrandEvals,     // quadrature integrand points
+  NewtonIterations,   // Newton and Levenberg-Marquardt updates
+  Jacobians,
+  StepsAccepted,
+  StepsRejected,
+  LapackCalls,
+  Counters
+};
+
+enum Timer : size_t { Quadrature, Integrate, Newton, Lapack, Fit, Timers };
+
+inline constexpr const char* counter_names[Counters] = {
+  "rate_evals", "integrand_evals", "newton_iterations", "jacobians",
+  "steps_accepted", "steps_rejected", "lapack_calls"};
+inline constexpr const char* timer_names[Timers] = {
+  "quadrature", "integrate", "newton", "lapack", "fit"};
+
+/************ probe::Stats ********************************/
+struct Stats {
+  std::array<uint64_t, Counters> count{};
+  std::array<uint64_t, Timers> calls{};
+  std::array<double, Timers> seconds{};
+
+  uint64_t operator[](Counter c) const { return count[c]; }
+
+  Stats&
+  operator+=(const Stats& b)
+  {
+    for (size_t i = 0; i < Counters; i++) {
+      count[i] += b.count[i];
+    }
+    for (size_t i = 0; i < Timers; i++) {
+      calls[i] += b.calls[i];
+      seconds[i] += b.seconds[i];
+    }
+    return *this;
+  }
+
+  friend Stats
+  operator-(Stats a, const Stats& b)
+  {
+    for (size_t i = 0; i < Counters; i++) {
+      a.count[i] -= b.count[i];
+    }
+    for (size_t i = 0; i < Timers; i++) {
+      a.calls[i] -= b.calls[i];
+      a.seconds[i] -= b.seconds[i];
+    }
+    return a;
+  }
+};
+
+/************ per thread tallies **************************/
+/*
+ * Only the owning thread writes its slot, so updates are a relaxed load and
+ * store with no locked instruction; the atomics just make total()'s reads
+ * from another thread well defined
+ */
+struct Slot {
+  std::array<std::atomic<uint64_t>, Counters> count{};
+  std::array<std::atomic<uint64_t>, Timers> calls{}, ns{};
+
+  static void
+  bump(std::atomic<uint64_t>& c, uint64_t n)
+  {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  Stats
+  read() const
+  {
+    Stats s;
+    for (size_t i = 0; i < Counters; i++) {
+      s.count[i] = count[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < Timers; i++) {
+      s.calls[i] = calls[i].load(std::memory_order_relaxed);
+      s.seconds[i] = 1e-9 * static_cast<double>(ns[i].load(std::memory_order_relaxed));
+    }
+    return s;
+  }
+};
+
+// live slots plus whatever exited threads left behind
+class Registry {
+public:
+  void
+  attach(Slot* s)
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    live_.push_back(s);
+  }
+
+  void
+  retire(Slot* s)
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    retired_ += s->read();
+    std::erase(live_, s);
+  }
+
+  Stats
+  total()
+  {
+    std::lock_guard<std::mutex> lock(m_);
+    Stats s = retired_;
+    for (const Slot* l : live_) {
+      s += l->read();
+    }
+    return s;
+  }
+
+private:
+  std::mutex m_;
+  std::vector<Slot*> live_{};
+  Stats retired_{};
+};
+
+inline Registry&
+registry()
+{
+  static Registry r;
+  return r;
+}
+
+inline Slot&
+local()
+{
+  struct Owner {
+    Slot slot;
+    Owner() { registry().attach(&slot); }
+    ~Owner() { registry().retire(&slot); }
+  };
+  thread_local Owner owner;
+  return owner.slot;
+}
+
+/************ probe::add(), probe::Scope ******************/
+inline void
+add(Counter c, uint64_t n = 1)
+{
+  if constexpr ( enabled ) {
+    Slot::bump(local().count[c], n);
+  }
+}
+
+class Scope {
+public:
+  explicit Scope(Timer t) : t_(t), t0_(std::chrono::steady_clock::now()) {}
+
+  ~Scope()
+  {
+    const auto t1 = std::chrono::steady_clock::now();
+    Slot& s = local();
+    Slot::bump(s.calls[t_], 1);
+    Slot::bump(s.ns[t_], static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0_).count()));
+  }
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+private:
+  Timer t_;
+  std::chrono::steady_clock::time_point t0_;
+};
+
+/************ probe::total(), probe::json() ***************/
+// every thread's work so far, call while no solver is running on the pool
+inline Stats
+total()
+{
+  if constexpr ( !enabled ) {
+    return {};
+  }
+  return registry().total();
+}
+
+inline void
+json(const Stats& s, std::FILE* out = stdout)
+{
+  std::fprintf(out, "{\"counters\":{");
+  for (size_t i = 0; i < Counters; i++) {
+    std::fprintf(out, "%s\"%s\":%llu", i ? "," : "", counter_names[i],
+                 static_cast<unsigned long long>(s.count[i]));
+  }
+  std::fprintf(out, "},\"timers\":{");
+  for (size_t i = 0; i < Timers; i++) {
+    std::fprintf(out, "%s\"%s\":{\"calls\":%llu,\"seconds\":%.9f}", i ? "," : "",
+                 timer_names[i], static_cast<unsigned long long>(s.calls[i]), s.seconds[i]);
+  }
+  std::fprintf(out, "}}\n");
+  std::fflush(out);
+}
+
+#if defined(INSTRUMENT)
+/*
+ * PROBE_JSON=path dump of the process total. Statics are destroyed after
+ * the main thread's thread_locals, so its slot has already retired, and
+ * touching the registry here makes it outlive the dump
+ */
+struct AtExit {
+  AtExit() { registry(); }
+
+  ~AtExit()
+  {
+    const char* path = std::getenv("PROBE_JSON");
+    if ( path == nullptr || *path == '\0' ) {
+      return;
+    }
+    std::FILE* out = ( path[0] == '-' && path[1] == '\0' ) ? stderr : std::fopen(path, "w");
+    if ( out == nullptr ) {
+      return;
+    }
+    json(total(), out);
+    if ( out != stderr ) {
+      std::fclose(out);
+    }
+  }
+};
+
+inline AtExit at_exit{};
+#endif
+
+}  // namespace probe
+
+#define PROBE_CAT_(a, b) a##b
+#define PROBE_CAT(a, b) PROBE_CAT_(a, b)
+
+#if defined(INSTRUMENT)
+#define PROBE_ADD(counter, n) probe::add(probe::counter, (n))
+#define PROBE_TIME(timer) const probe::Scope PROBE_CAT(probe_scope_, __LINE__)(probe::timer)
+#else
+#define PROBE_ADD(counter, n) ((void)0)
+#define PROBE_TIME(timer) ((void)0)
+#endif
@@ -0,0 +1,908 @@
+/*
+ * integrate.hpp  Andrew Belles
+ *
+ * Header only explicit integrators shared by the ODE labs. Steppers are
+ * templated on the state type, anything with +, - and scalar *, so a plain
+ * double, a lab's own struct or the SoA Vec<N, W> below all work. Butcher
+ * and Adams coefficients are compile time tables, multistep methods keep
+ * their last k rates in a fixed ring, and integrate() hands every accepted
+ * node to a sink so callers choose between preallocated columns, their own
+ * containers, a decimated subset or nothing at all; memory only scales with
+ * the step count when a full trajectory is asked for. Adaptive steppers
+ * (embedded Dormand-Prince, variable order Adams) control the local error
+ * and expose dense output, so samples never force the step size down
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "instrument.hpp"
+
+namespace ode {
+
+/************ state ***************************************/
+/*
+ * N components for each of W independent lanes, component major so a
+ * component across lanes is contiguous and every operator is one flat loop
+ * the compiler vectorizes
+ */
+template<size_t N, size_t W = 1>
+struct Vec {
+  double v[N * W]{};
+
+  static constexpr size_t dim = N, lanes = W;
+
+  double& operator()(size_t c, size_t l = 0) { return v[c * W + l]; }
+  double operator()(size_t c, size_t l = 0) const { return v[c * W + l]; }
+  double& operator[](size_t i) { return v[i]; }
+  double operator[](size_t i) const { return v[i]; }
+};
+
+template<size_t N, size_t W>
+inline Vec<N, W>
+operator+(const Vec<N, W>& a, const Vec<N, W>& b)
+{
+  Vec<N, W> r;
+  for (size_t i = 0; i < N * W; i++) {
+    r.v[i] = a.v[i] + b.v[i];
+  }
+  return r;
+}
+
+template<size_t N, size_t W>
+inline Vec<N, W>
+operator-(const Vec<N, W>& a, const Vec<N, W>& b)
+{
+  Vec<N, W> r;
+  for (size_t i = 0; i < N * W; i++) {
+    r.v[i] = a.v[i] - b.v[i];
+  }
+  return r;
+}
+
+template<size_t N, size_t W>
+inline Vec<N, W>
+operator*(const double c, const Vec<N, W>& a)
+{
+  Vec<N, W> r;
+  for (size_t i = 0; i < N * W; i++) {
+    r.v[i] = c * a.v[i];
+  }
+  return r;
+}
+
+/************ coefficient tables **************************/
+template<size_t S>
+struct Butcher {
+  std::array<std::array<double, S>, S> a;
+  std::array<double, S> b, c;
+};
+
+inline constexpr Butcher<1> Euler{{{{0.0}}}, {1.0}, {0.0}};
+inline constexpr Butcher<2> Midpoint{{{{0.0, 0.0}, {0.5, 0.0}}}, {0.0, 1.0}, {0.0, 0.5}};
+inline constexpr Butcher<2> Heun{{{{0.0, 0.0}, {1.0, 0.0}}}, {0.5, 0.5}, {0.0, 1.0}};
+inline constexpr Butcher<4> RK4{
+  {{{0.0, 0.0, 0.0, 0.0}, {0.5, 0.0, 0.0, 0.0}, {0.0, 0.5, 0.0, 0.0}, {0.0, 0.0, 1.0, 0.0}}},
+  {1.0 / 6.0, 1.0 / 3.0, 1.0 / 3.0, 1.0 / 6.0},
+  {0.0, 0.5, 0.5, 1.0}
+};
+
+/*
+ * Dormand-Prince 5(4). The last row of a equals b, so the final stage is the
+ * first stage of the next step (FSAL)
+ */
+inline constexpr Butcher<7> DOPRI5{
+  {{{0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {1.0 / 5.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {3.0 / 40.0, 9.0 / 40.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0, 0.0, 0.0, 0.0, 0.0},
+    {19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0, 0.0, 0.0, 0.0},
+    {9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0, 0.0, 0.0},
+    {35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0, 0.0}}},
+  {35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0, 0.0},
+  {0.0, 1.0 / 5.0, 3.0 / 10.0, 4.0 / 5.0, 8.0 / 9.0, 1.0, 1.0}
+};
+
+// b minus the embedded 4th order weights, h sum e_j k_j is the local error
+inline constexpr std::array<double, 7> DOPRI5_err{
+  71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0, -17253.0 / 339200.0,
+  22.0 / 525.0, -1.0 / 40.0
+};
+
+// Hairer's 4th order continuous extension of DOPRI5
+inline constexpr std::array<double, 7> DOPRI5_dense{
+  -12715105075.0 / 11282082432.0, 0.0, 87487479700.0 / 32700410799.0,
+  -10690763975.0 / 1880347072.0, 701980252875.0 / 199316789632.0,
+  -1453857185.0 / 822651844.0, 69997945.0 / 29380423.0
+};
+
+/*
+ * y_{n+1} = y_n + h / den * sum_j w[j] f_{n-j}. Bashforth rows start at the
+ * newest stored rate, Moulton rows start at the predicted rate f_{n+1}
+ */
+template<size_t K>
+struct Adams {
+  std::array<double, K> w;
+  double den;
+};
+
+inline constexpr Adams<2> AB2{{3.0, -1.0}, 2.0};
+inline constexpr Adams<3> AB3{{23.0, -16.0, 5.0}, 12.0};
+inline constexpr Adams<4> AB4{{55.0, -59.0, 37.0, -9.0}, 24.0};
+inline constexpr Adams<3> AM2{{5.0, 8.0, -1.0}, 12.0};
+inline constexpr Adams<4> AM3{{9.0, 19.0, -5.0, 1.0}, 24.0};
+inline constexpr Adams<5> AM4{{251.0, 646.0, -264.0, 106.0, -19.0}, 720.0};
+
+/************ Ring ****************************************/
+// last K values, r[0] is the newest
+template<typename S, size_t K>
+class Ring {
+public:
+  void
+  push(const S& s)
+  {
+    head_ = (head_ + 1) % K;
+    buf_[head_] = s;
+    if ( size_ < K ) {
+      size_++;
+    }
+  }
+
+  const S& operator[](size_t j) const { return buf_[(head_ + K - j) % K]; }
+  size_t size() const { return size_; }
+  bool full() const { return size_ == K; }
+  void clear() { size_ = 0; }
+
+private:
+  std::array<S, K> buf_{};
+  size_t head_{K - 1}, size_{0};
+};
+
+/************ steppers ************************************/
+/*
+ * Every stepper advances y in place from t to t + h. Rate is any callable
+ * S(double t, const S& y)
+ */
+template<typename S, size_t St, typename Rate>
+class RungeKutta {
+public:
+  RungeKutta(const Butcher<St>& tab, Rate f) : tab_(tab), f_(std::move(f)) {}
+
+  void
+  step(double t, S& y, double h)
+  {
+    for (size_t i = 0; i < St; i++) {
+      S yi = y;
+      for (size_t j = 0; j < i; j++) {
+        if ( tab_.a[i][j] != 0.0 ) {
+          yi = yi + (h * tab_.a[i][j]) * k_[j];
+        }
+      }
+      k_[i] = f_(t + tab_.c[i] * h, yi);
+    }
+    PROBE_ADD(RateEvals, St);
+    PROBE_ADD(StepsAccepted, 1);
+    for (size_t i = 0; i < St; i++) {
+      if ( tab_.b[i] != 0.0 ) {
+        y = y + (h * tab_.b[i]) * k_[i];
+      }
+    }
+  }
+
+private:
+  Butcher<St> tab_;
+  Rate f_;
+  std::array<S, St> k_{};
+};
+
+// sum_j w[j + from] r[j], Moulton rows skip their leading predicted weight
+template<typename S, size_t K, size_t R>
+inline S
+adams_sum_(const Adams<K>& tab, const Ring<S, R>& r, size_t from)
+{
+  S acc = tab.w[from] * r[0];
+  for (size_t j = from + 1; j < K; j++) {
+    acc = acc + tab.w[j] * r[j - from];
+  }
+  return acc;
+}
+
+/*
+ * P step Adams-Bashforth. Needs P seeded rates, oldest first, before the
+ * first step; h may change between steps (the weights do not)
+ */
+template<typename S, size_t P, typename Rate>
+class AdamsBashforth {
+public:
+  AdamsBashforth(const Adams<P>& ab, Rate f) : ab_(ab), f_(std::move(f)) {}
+
+  void
+  seed(double t, const S& y)
+  {
+    rates_.push(f_(t, y));
+    PROBE_ADD(RateEvals, 1);
+  }
+
+  void reset() { rates_.clear(); }
+  const Ring<S, P>& rates() const { return rates_; }
+
+  void
+  step(double t, S& y, double h)
+  {
+    y = y + (h / ab_.den) * adams_sum_(ab_, rates_, 0);
+    rates_.push(f_(t + h, y));
+    PROBE_ADD(RateEvals, 1);
+    PROBE_ADD(StepsAccepted, 1);
+  }
+
+private:
+  Adams<P> ab_;
+  Rate f_;
+  Ring<S, P> rates_{};
+};
+
+/*
+ * P step Bashforth predictor, C weight Moulton corrector, both evaluated
+ * (PECE). The ring holds max(P, C - 1) rates
+ */
+template<typename S, size_t P, size_t C, typename Rate>
+class AdamsPC {
+public:
+  static constexpr size_t depth = ( P > C - 1 ) ? P : C - 1;
+
+  AdamsPC(const Adams<P>& ab, const Adams<C>& am, Rate f)
+    : ab_(ab), am_(am), f_(std::move(f)) {}
+
+  void
+  seed(double t, const S& y)
+  {
+    rates_.push(f_(t, y));
+    PROBE_ADD(RateEvals, 1);
+  }
+
+  void reset() { rates_.clear(); }
+  const Ring<S, depth>& rates() const { return rates_; }
+
+  void
+  step(double t, S& y, double h)
+  {
+    const S pred  = y + (h / ab_.den) * adams_sum_(ab_, rates_, 0);
+    const S fpred = f_(t + h, pred);
+    const S corr  = am_.w[0] * fpred + adams_sum_(am_, rates_, 1);
+
+    y = y + (h / am_.den) * corr;
+    rates_.push(f_(t + h, y));
+    PROBE_ADD(RateEvals, 2);
+    PROBE_ADD(StepsAccepted, 1);
+  }
+
+private:
+  Adams<P> ab_;
+  Adams<C> am_;
+  Rate f_;
+  Ring<S, depth> rates_{};
+};
+
+/************ driving and storage *************************/
+/*
+ * Steps y from node first to node last - 1 on the uniform grid t0 + i h,
+ * calling sink(i, t_i, y) after every accepted step
+ */
+template<typename Stepper, typename S, typename Sink>
+inline void
+integrate(Stepper& stepper, S& y, double t0, double h, size_t first, size_t last, Sink&& sink)
+{
+  PROBE_TIME(Integrate);
+  for (size_t i = first + 1; i < last; i++) {
+    stepper.step(t0 + static_cast<double>(i - 1) * h, y, h);
+    sink(i, t0 + static_cast<double>(i) * h, y);
+  }
+}
+
+/*
+ * integrate() that returns after the first node where stop(i, t_i, y) holds,
+ * the result is the number of nodes reached (last if it never stops)
+ */
+template<typename Stepper, typename S, typename Sink, typename Stop>
+inline size_t
+integrate_until(Stepper& stepper, S& y, double t0, double h, size_t first, size_t last,
+                Sink&& sink, Stop&& stop)
+{
+  PROBE_TIME(Integrate);
+  for (size_t i = first + 1; i < last; i++) {
+    const double ti = t0 + static_cast<double>(i) * h;
+    stepper.step(t0 + static_cast<double>(i - 1) * h, y, h);
+    sink(i, ti, y);
+    if ( stop(i, ti, y) ) {
+      return i + 1;
+    }
+  }
+  return last;
+}
+
+// sink for integrations where only the final state matters 
+struct Discard {
+  template<typename S>
+  void operator()(size_t, double, const S&) const {}
+};
+
+/*
+ * Forwards node 0, every stride-th node and the final node (last - 1) to 
+ * sink, renumbered 0, 1, 2, ... so the kept output is dense 
+ */ 
+template<typename Sink>
+class Decimate {
+public:
+  Decimate(Sink& sink, size_t stride, size_t last) 
+    : sink_(sink), stride_(std::max<size_t>(1, stride)), last_(last) {}
+
+  // nodes of [0, last) that will be kept 
+  static size_t 
+  kept(size_t stride, size_t last)
+  {
+    stride = std::max<size_t>(1, stride); 
+    return ( last == 0 ) ? 0 : (last - 1) / stride + 1 + ( (last - 1) % stride != 0 ); 
+  }
+
+  template<typename S>
+  void 
+  operator()(size_t i, double t, const S& y)
+  {
+    if ( i % stride_ == 0 || i + 1 == last_ ) {
+      sink_(next_++, t, y); 
+    }
+  }
+
+private:
+  Sink& sink_; 
+  size_t stride_{1}, last_{0}, next_{0}; 
+};
+
+/*
+ * Preallocated SoA sink for Vec<N, W>: every (component, lane) pair is one
+ * contiguous column of n nodes
+ */
+template<size_t N, size_t W = 1>
+class Trajectory {
+public:
+  explicit Trajectory(size_t n) : n_(n), t_(n), data_(N * W * n) {}
+
+  void
+  operator()(size_t i, double t, const Vec<N, W>& y)
+  {
+    t_[i] = t;
+    for (size_t k = 0; k < N * W; k++) {
+      data_[k * n_ + i] = y.v[k];
+    }
+  }
+
+  Vec<N, W>
+  at(size_t i) const
+  {
+    Vec<N, W> y;
+    for (size_t k = 0; k < N * W; k++) {
+      y.v[k] = data_[k * n_ + i];
+    }
+    return y;
+  }
+
+  std::span<const double>
+  column(size_t c, size_t l = 0) const
+  {
+    return {data_.data() + (c * W + l) * n_, n_};
+  }
+
+  std::span<const double> time() const { return t_; }
+  size_t size() const { return n_; }
+
+private:
+  size_t n_{0};
+  std::vector<double> t_{}, data_{};
+};
+
+/************ adaptive stepping ***************************/
+struct Tolerance {
+  double atol{1e-9}, rtol{1e-9};
+  double hmin{1e-14}, hmax{std::numeric_limits<double>::infinity()};
+};
+
+// scaled local error, at most 1 when e is within atol + rtol max(|y0|, |y1|)
+inline double
+error_norm(double e, double y0, double y1, const Tolerance& tol)
+{
+  return std::abs(e) / (tol.atol + tol.rtol * std::max(std::abs(y0), std::abs(y1)));
+}
+
+// RMS of the scaled error over every component and lane
+template<size_t N, size_t W>
+inline double
+error_norm(const Vec<N, W>& e, const Vec<N, W>& y0, const Vec<N, W>& y1, const Tolerance& tol)
+{
+  double acc = 0.0;
+  for (size_t i = 0; i < N * W; i++) {
+    const double r = error_norm(e.v[i], y0.v[i], y1.v[i], tol);
+    acc += r * r;
+  }
+  return std::sqrt(acc / static_cast<double>(N * W));
+}
+
+// cubic Hermite through (t0, y0, f0) and (t1, y1, f1), evaluated at t
+template<typename S>
+inline S
+hermite(double t0, const S& y0, const S& f0, double t1, const S& y1, const S& f1, double t)
+{
+  const double h = t1 - t0;
+  if ( h == 0.0 ) {
+    return y1;
+  }
+  const double s = (t - t0) / h, s2 = s * s, s3 = s2 * s;
+  return (2.0 * s3 - 3.0 * s2 + 1.0) * y0 + (h * (s3 - 2.0 * s2 + s)) * f0
+       + (3.0 * s2 - 2.0 * s3) * y1 + (h * (s3 - s2)) * f1;
+}
+
+/*
+ * PI step size control (Gustafsson; Hairer, Norsett and Wanner II.4). Scale
+ * for h after a step whose error estimate is of order p, damped by the
+ * error of the previous accepted step; err <= 1 accepts. No growth is
+ * allowed directly after a rejection
+ */
+class PIController {
+public:
+  explicit PIController(double safety = 0.9, double fmin = 0.2, double fmax = 5.0)
+    : safety_(safety), fmin_(fmin), fmax_(fmax) {}
+
+  double
+  scale(double err, int p)
+  {
+    const double k = static_cast<double>(p) + 1.0;
+    const double beta = 0.4 / k, alpha = 1.0 / k - 0.75 * beta;
+
+    err = std::max(err, 1e-10);
+    if ( err <= 1.0 ) {
+      const double f = safety_ * std::pow(err, -alpha) * std::pow(prev_, beta);
+      prev_ = std::max(err, 1e-4);
+      const bool held = rejected_;
+      rejected_ = false;
+      return std::clamp(f, fmin_, held ? 1.0 : fmax_);
+    }
+    rejected_ = true;
+    return std::max(fmin_, safety_ * std::pow(err, -1.0 / k));
+  }
+
+  void
+  reset()
+  {
+    prev_ = 1e-4;
+    rejected_ = false;
+  }
+
+private:
+  double safety_{0.9}, fmin_{0.2}, fmax_{5.0}, prev_{1e-4};
+  bool rejected_{false};
+};
+
+/*
+ * Adaptive steppers share one shape: step(t_end) takes a single accepted
+ * step toward t_end (retrying rejected ones internally) and returns false
+ * once t_end is reached or h underflows hmin; t(), y() give the current
+ * node and operator()(t) the dense output anywhere in the last step
+ */
+
+/*
+ * Embedded Dormand-Prince 5(4) with PI control, FSAL so an accepted step
+ * costs six rate evaluations and a rejected one six more
+ */
+template<typename S, typename Rate>
+class DormandPrince {
+public:
+  DormandPrince(Rate f, Tolerance tol = {}) : f_(std::move(f)), tol_(tol) {}
+
+  // restart at (t0, y0), h0 = 0 picks the first step from the rate scale
+  void
+  start(double t0, const S& y0, double h0 = 0.0)
+  {
+    t_ = tprev_ = t0;
+    y_ = y0;
+    last_ = 0.0;
+    k_[0] = f_(t0, y0);
+    evals_++;
+    PROBE_ADD(RateEvals, 1);
+    ctrl_.reset();
+    h_ = ( h0 > 0.0 ) ? h0 : guess_();
+  }
+
+  bool
+  step(double t_end)
+  {
+    PROBE_TIME(Integrate);
+    while ( t_ < t_end ) {
+      bool ends = false;
+      double h = std::min(h_, tol_.hmax);
+      if ( h < tol_.hmin ) {
+        return false;
+      }
+      if ( t_ + 1.01 * h >= t_end ) {
+        h = t_end - t_;
+        ends = true;
+      }
+
+      for (size_t i = 1; i < 7; i++) {
+        S yi = y_;
+        for (size_t j = 0; j < i; j++) {
+          if ( DOPRI5.a[i][j] != 0.0 ) {
+            yi = yi + (h * DOPRI5.a[i][j]) * k_[j];
+          }
+        }
+        k_[i] = f_(t_ + DOPRI5.c[i] * h, yi);
+        if ( i == 6 ) {
+          y1_ = yi;         // row 7 of a is b, the stage point is y_{n+1}
+        }
+      }
+      evals_ += 6;
+      PROBE_ADD(RateEvals, 6);
+
+      S e = (h * DOPRI5_err[0]) * k_[0];
+      for (size_t j = 2; j < 7; j++) {
+        e = e + (h * DOPRI5_err[j]) * k_[j];
+      }
+      const double err = error_norm(e, y_, y1_, tol_);
+      const double f = ctrl_.scale(err, 4);
+
+      if ( err <= 1.0 ) {
+        dense_(h);
+        tprev_ = t_;
+        t_ = ( ends ) ? t_end : t_ + h;
+        y_ = y1_;
+        k_[0] = k_[6];
+        last_ = h;
+        h_ = h * f;
+        accepted_++;
+        PROBE_ADD(StepsAccepted, 1);
+        return true;
+      }
+      h_ = h * f;
+      rejected_++;
+      PROBE_ADD(StepsRejected, 1);
+    }
+    return false;
+  }
+
+  S
+  operator()(double t) const
+  {
+    if ( last_ == 0.0 ) {
+      return y_;
+    }
+    const double th = (t - tprev_) / last_, th1 = 1.0 - th;
+    return r_[0] + th * (r_[1] + th1 * (r_[2] + th * (r_[3] + th1 * r_[4])));
+  }
+
+  double t() const { return t_; }
+  const S& y() const { return y_; }
+  double h() const { return h_; }
+  size_t evals() const { return evals_; }
+  size_t accepted() const { return accepted_; }
+  size_t rejected() const { return rejected_; }
+
+private:
+  Rate f_;
+  Tolerance tol_{};
+  PIController ctrl_{};
+  std::array<S, 7> k_{};
+  std::array<S, 5> r_{};
+  S y_{}, y1_{};
+  double t_{0.0}, tprev_{0.0}, h_{0.0}, last_{0.0};
+  size_t evals_{0}, accepted_{0}, rejected_{0};
+
+  // Hairer's starting guess, h ~ 0.01 |y| / |f| in the tolerance norm
+  double
+  guess_() const
+  {
+    const double d0 = error_norm(y_, y_, y_, tol_), d1 = error_norm(k_[0], y_, y_, tol_);
+    const double h = ( d0 < 1e-5 || d1 < 1e-5 ) ? 1e-6 : 0.01 * d0 / d1;
+    return std::clamp(h, tol_.hmin, tol_.hmax);
+  }
+
+  // continuous extension coefficients of the step just taken from y_ to y1_
+  void
+  dense_(double h)
+  {
+    const S dy = y1_ - y_;
+    const S bspl = h * k_[0] - dy;
+    S d = (h * DOPRI5_dense[0]) * k_[0];
+    for (size_t j = 2; j < 7; j++) {
+      d = d + (h * DOPRI5_dense[j]) * k_[j];
+    }
+    r_[0] = y_;
+    r_[1] = dy;
+    r_[2] = bspl;
+    r_[3] = dy - h * k_[6] - bspl;
+    r_[4] = d;
+  }
+};
+
+/*
+ * Variable step, variable order Adams PECE, orders 1 through K. Weights are
+ * rebuilt every attempt from the actual node spacing by integrating the
+ * interpolant of the stored rates, the local error is Milne's estimate
+ * from predictor and corrector, and once p + 1 steps have been taken at
+ * order p the order among p - 1, p, p + 1 allowing the longest next step
+ * is chosen. Self starting at order 1, or seeded with a history to start
+ * at its length. An accepted step costs two rate evaluations, a rejected
+ * one a single evaluation. Dense output is the cubic Hermite of the step
+ */
+template<typename S, typename Rate, size_t K = 5>
+class VariableAdams {
+  static_assert(K >= 1 && K <= 5, "Milne constants are tabulated through order 5");
+
+public:
+  VariableAdams(Rate f, Tolerance tol = {}) : f_(std::move(f)), tol_(tol) {}
+
+  // history nodes oldest first, stepping starts from the last one seeded
+  void
+  seed(double t, const S& y)
+  {
+    ts_.push(t);
+    fs_.push(f_(t, y));
+    evals_++;
+    PROBE_ADD(RateEvals, 1);
+    t_ = tprev_ = t;
+    y_ = yprev_ = y;
+    last_ = 0.0;
+    order_ = fs_.size();
+    same_ = 0;
+  }
+
+  void
+  reset()
+  {
+    ts_.clear();
+    fs_.clear();
+    ctrl_.reset();
+    misses_ = 0;
+    same_ = 0;
+  }
+
+  // trial size of the first step
+  void start(double h0) { h_ = h0; }
+
+  bool
+  step(double t_end)
+  {
+    PROBE_TIME(Integrate);
+    while ( t_ < t_end && fs_.size() > 0 ) {
+      bool ends = false;
+      double h = std::min(h_, tol_.hmax);
+      if ( h < tol_.hmin ) {
+        return false;
+      }
+      if ( t_ + 1.01 * h >= t_end ) {
+        h = t_end - t_;
+        ends = true;
+      }
+
+      const size_t p = order_;
+      S pred{}, corr{};
+      predict_(p, h, pred);
+      const S fpred = f_(t_ + h, pred);
+      evals_++;
+      PROBE_ADD(RateEvals, 1);
+      const double err = estimate_(p, h, pred, fpred, corr);
+
+      if ( err > 1.0 ) {
+        h_ = h * ctrl_.scale(err, static_cast<int>(p));
+        rejected_++;
+        PROBE_ADD(StepsRejected, 1);
+        if ( ++misses_ >= 2 && order_ > 1 ) {
+          order_--;
+          same_ = 0;
+        }
+        continue;
+      }
+
+      // order for the next step, estimates at p +- 1 reuse fpred
+      size_t next = p;
+      double best = err, gain = std::pow(std::max(err, 1e-10), -1.0 / (p + 1.0));
+      if ( ++same_ >= p + 1 ) {
+        for (size_t q = p - 1; q <= p + 1; q += 2) {
+          if ( q < 1 || q > K || q > fs_.size() ) {
+            continue;
+          }
+          S pq{}, cq{};
+          predict_(q, h, pq);
+          const double eq = estimate_(q, h, pq, fpred, cq);
+          const double g = std::pow(std::max(eq, 1e-10), -1.0 / (q + 1.0));
+          if ( g > gain ) {
+            gain = g;
+            best = eq;
+            next = q;
+          }
+        }
+      }
+
+      tprev_ = t_;
+      yprev_ = y_;
+      t_ = ( ends ) ? t_end : t_ + h;
+      y_ = corr;
+      ts_.push(t_);
+      fs_.push(f_(t_, y_));
+      evals_++;
+      PROBE_ADD(RateEvals, 1);
+      last_ = h;
+      misses_ = 0;
+      if ( next != order_ ) {
+        order_ = next;
+        same_ = 0;
+      }
+      h_ = h * ctrl_.scale(best, static_cast<int>(order_));
+      accepted_++;
+      PROBE_ADD(StepsAccepted, 1);
+      return true;
+    }
+    return false;
+  }
+
+  S
+  operator()(double t) const
+  {
+    if ( last_ == 0.0 ) {
+      return y_;
+    }
+    return hermite(tprev_, yprev_, fs_[1], t_, y_, fs_[0], t);
+  }
+
+  double t() const { return t_; }
+  const S& y() const { return y_; }
+  double h() const { return h_; }
+  size_t order() const { return order_; }
+  size_t evals() const { return evals_; }
+  size_t accepted() const { return accepted_; }
+  size_t rejected() const { return rejected_; }
+
+private:
+  Rate f_;
+  Tolerance tol_{};
+  PIController ctrl_{0.9, 0.2, 2.0};   // variable step Adams dislikes large ratios
+  Ring<double, K> ts_{};
+  Ring<S, K> fs_{};
+  S y_{}, yprev_{};
+  double t_{0.0}, tprev_{0.0}, h_{0.0}, last_{0.0};
+  size_t order_{1}, same_{0}, misses_{0};
+  size_t evals_{0}, accepted_{0}, rejected_{0};
+
+  // |c*_q / (c_q - c*_q)| from the Bashforth and Moulton error constants
+  static constexpr std::array<double, 6> milne_{
+    0.0, 1.0 / 2.0, 1.0 / 6.0, 1.0 / 10.0, 19.0 / 270.0, 27.0 / 502.0
+  };
+
+  /*
+   * w with sum_j w[j] g(x[j]) equal to the integral over [0, 1] of the
+   * polynomial interpolating g at the q nodes x (in units of h), from the
+   * moment equations sum_j w[j] x[j]^m = 1 / (m + 1)
+   */
+  static void
+  weights_(const double* x, size_t q, double* w)
+  {
+    double m[K][K + 1];
+    for (size_t r = 0; r < q; r++) {
+      for (size_t j = 0; j < q; j++) {
+        m[r][j] = ( r == 0 ) ? 1.0 : m[r - 1][j] * x[j];
+      }
+      m[r][q] = 1.0 / static_cast<double>(r + 1);
+    }
+
+    for (size_t c = 0; c < q; c++) {
+      size_t piv = c;
+      for (size_t r = c + 1; r < q; r++) {
+        if ( std::abs(m[r][c]) > std::abs(m[piv][c]) ) {
+          piv = r;
+        }
+      }
+      for (size_t j = c; j <= q; j++) {
+        std::swap(m[c][j], m[piv][j]);
+      }
+      for (size_t r = c + 1; r < q; r++) {
+        const double l = m[r][c] / m[c][c];
+        for (size_t j = c; j <= q; j++) {
+          m[r][j] -= l * m[c][j];
+        }
+      }
+    }
+    for (size_t c = q; c-- > 0;) {
+      double acc = m[c][q];
+      for (size_t j = c + 1; j < q; j++) {
+        acc -= m[c][j] * w[j];
+      }
+      w[c] = acc / m[c][c];
+    }
+  }
+
+  // order q Bashforth over the last q rates
+  void
+  predict_(size_t q, double h, S& pred) const
+  {
+    double x[K]{}, w[K]{};
+    for (size_t j = 0; j < q; j++) {
+      x[j] = (ts_[j] - t_) / h;
+    }
+    weights_(x, q, w);
+
+    S acc = w[0] * fs_[0];
+    for (size_t j = 1; j < q; j++) {
+      acc = acc + w[j] * fs_[j];
+    }
+    pred = y_ + h * acc;
+  }
+
+  // order q Moulton on fpred and the last q - 1 rates, returns Milne's error
+  double
+  estimate_(size_t q, double h, const S& pred, const S& fpred, S& corr) const
+  {
+    double x[K]{}, w[K]{};
+    x[0] = 1.0;
+    for (size_t j = 1; j < q; j++) {
+      x[j] = (ts_[j - 1] - t_) / h;
+    }
+    weights_(x, q, w);
+
+    S acc = w[0] * fpred;
+    for (size_t j = 1; j < q; j++) {
+      acc = acc + w[j] * fs_[j - 1];
+    }
+    corr = y_ + h * acc;
+    return milne_[q] * error_norm(corr - pred, y_, corr, tol_);
+  }
+};
+
+/*
+ * Drives an adaptive stepper to t_end, calling sink(stepper) at the start
+ * and after every accepted step so the sink can read t(), y() and the
+ * dense output of the step just taken
+ */
+template<typename Stepper, typename Sink>
+inline void
+integrate_adaptive(Stepper& stepper, double t_end, Sink&& sink)
+{
+  sink(std::as_const(stepper));
+  while ( stepper.step(t_end) ) {
+    sink(std::as_const(stepper));
+  }
+}
+
+/*
+ * Adaptive sink forwarding the dense solution at sorted sample times to
+ * sink(i, t_i, y), however the controller chose its steps
+ */
+template<typename Sink>
+class Sample {
+public:
+  Sample(std::span<const double> times, Sink& sink) : times_(times), sink_(sink) {}
+
+  template<typename Stepper>
+  void
+  operator()(const Stepper& stepper)
+  {
+    while ( next_ < times_.size() && times_[next_] <= stepper.t() ) {
+      sink_(next_, times_[next_], stepper(times_[next_]));
+      next_++;
+    }
+  }
+
+  size_t size() const { return next_; }
+
+private:
+  std::span<const double> times_{};
+  Sink& sink_;
+  size_t next_{0};
+};
+
+}  // namespace ode
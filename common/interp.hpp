@@ -0,0 +1,372 @@
+/*
+ * interp.hpp  Andrew Belles
+ *
+ * Interpolation engine behind DataSet and the lab3 port. Spline is the
+ * natural cubic spline through arbitrary increasing knots, built in O(n) by
+ * the shared Thomas solver, with each interval's knot and coefficients
+ * packed together so one lookup touches one cache line. Queries come in
+ * batches: a nondecreasing batch walks the knots forward without any
+ * search, a random batch goes through an Eytzinger (breadth first) copy of
+ * the knots whose descent is branch free and prefetches four levels ahead.
+ * Chebyshev interpolates at the first kind Chebyshev nodes and evaluates
+ * by Clenshaw, a block of queries at a time so the recurrence vectorizes
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "banded.hpp"
+#include "pool.hpp"
+
+namespace interp {
+
+// fn(lo, hi) over [0, n) in chunks of grain, on the pool when one is given
+template<typename Fn>
+inline void
+chunked(size_t n, ThreadPool* pool, size_t grain, Fn&& fn)
+{
+  if ( pool == nullptr || n <= grain ) {
+    fn(size_t{0}, n);
+    return;
+  }
+  const size_t chunks = (n + grain - 1) / grain;
+  pool->parallel_for(chunks, [&](size_t k) {
+    fn(k * grain, std::min(n, (k + 1) * grain));
+  });
+}
+
+/************ Eytzinger ***********************************/
+/*
+ * Sorted keys rearranged in breadth first order (node k has children 2k and
+ * 2k + 1) so the top levels of every search share a few cache lines and the
+ * descent is a fixed sequence of compares with no unpredictable branches
+ */
+class Eytzinger {
+public:
+  Eytzinger() = default;
+
+  explicit Eytzinger(std::span<const double> sorted)
+  {
+    const size_t n = sorted.size();
+    keys_.assign(n + 1, 0.0);
+    rank_.assign(n + 1, n);
+    size_t i = 0;
+    fill_(sorted, i, 1);
+  }
+
+  // number of keys <= x, the upper_bound position in the sorted order
+  size_t
+  rank(const double x) const
+  {
+    const size_t n = size();
+    const double* keys = keys_.data();
+    size_t k = 1;
+    while ( k <= n ) {
+      __builtin_prefetch(keys + 16 * k);  // the great grandchildren, 4 levels down
+      k = 2 * k + static_cast<size_t>(keys[k] <= x);
+    }
+    // strip the trailing right turns, lands on the first key > x (0 if none)
+    k >>= __builtin_ffsll(static_cast<long long>(~k));
+    return rank_[k];
+  }
+
+  size_t size() const { return keys_.empty() ? 0 : keys_.size() - 1; }
+
+private:
+  std::vector<double> keys_{};
+  std::vector<size_t> rank_{};  // sorted position of node k, slot 0 is "past the end"
+
+  void
+  fill_(std::span<const double> sorted, size_t& i, size_t k)
+  {
+    if ( k > sorted.size() ) {
+      return;
+    }
+    fill_(sorted, i, 2 * k);
+    keys_[k] = sorted[i];
+    rank_[k] = i++;
+    fill_(sorted, i, 2 * k + 1);
+  }
+};
+
+/************ Spline **************************************/
+/*
+ * Natural cubic spline, S'' = 0 at both ends. x must be strictly increasing.
+ * Outside the knots the end cubics are extended
+ */
+class Spline {
+public:
+  // S(x) = a + b t + c t^2 + d t^3 with t = x - x0 on [x0, next knot)
+  struct Piece {
+    double x0, a, b, c, d;
+  };
+
+  static constexpr size_t grain = 16384;  // queries per pool task
+
+  Spline() = default;
+
+  Spline(std::span<const double> x, std::span<const double> y) { build(x, y); }
+
+  /********** Spline::build() *****************************/
+  /*
+   * Solves the tridiagonal system for the knot curvatures M, the end rows
+   * pinning M = 0, then packs the interval coefficients. The same system as
+   * the lab3 prototype with its uniform h generalized to h_i
+   */
+  void
+  build(std::span<const double> x, std::span<const double> y)
+  {
+    const size_t n = x.size();
+    if ( n < 2 || y.size() != n ) {
+      throw std::invalid_argument("spline needs at least two (x, y) pairs");
+    }
+    for (size_t i = 1; i < n; i++) {
+      if ( !(x[i] > x[i - 1]) ) {
+        throw std::invalid_argument("spline knots must be strictly increasing");
+      }
+    }
+
+    std::vector<double> a(n, 0.0), b(n, 1.0), c(n, 0.0), M(n, 0.0);
+    for (size_t i = 1; i + 1 < n; i++) {
+      const double hl = x[i] - x[i - 1], hr = x[i + 1] - x[i];
+      a[i] = hl;
+      b[i] = 2.0 * (hl + hr);
+      c[i] = hr;
+      M[i] = 6.0 * ((y[i + 1] - y[i]) / hr - (y[i] - y[i - 1]) / hl);
+    }
+    band::Tridiagonal(a, b, c).solve(M);
+
+    pieces_.resize(n - 1);
+    for (size_t i = 0; i + 1 < n; i++) {
+      const double h = x[i + 1] - x[i];
+      pieces_[i] = {x[i], y[i],
+                    (y[i + 1] - y[i]) / h - h * (2.0 * M[i] + M[i + 1]) / 6.0,
+                    0.5 * M[i], (M[i + 1] - M[i]) / (6.0 * h)};
+    }
+    curvature_ = std::move(M);
+    hi_ = x[n - 1];
+
+    // interior knots only, so the rank is the interval and clamps at both ends
+    index_ = Eytzinger(x.subspan(1, n - 2));
+  }
+
+  double operator()(const double x) const { return eval_(pieces_[index_.rank(x)], x); }
+
+  /********** Spline::evaluate() **************************/
+  // random queries, one Eytzinger descent each, split across the pool
+  void
+  evaluate(std::span<const double> x, std::span<double> y, ThreadPool* pool = nullptr) const
+  {
+    check_(x, y);
+    chunked(x.size(), pool, grain, [&](size_t lo, size_t hi) {
+      for (size_t i = lo; i < hi; i++) {
+        y[i] = eval_(pieces_[index_.rank(x[i])], x[i]);
+      }
+    });
+  }
+
+  /********** Spline::evaluate_sorted() *******************/
+  /*
+   * Nondecreasing queries advance a cursor along the knots instead of
+   * searching, O(queries + knots) per batch. A query behind the cursor
+   * (unsorted input) falls back to the index, so the result is always right
+   */
+  void
+  evaluate_sorted(std::span<const double> x, std::span<double> y,
+                  ThreadPool* pool = nullptr) const
+  {
+    check_(x, y);
+    chunked(x.size(), pool, grain, [&](size_t lo, size_t hi) {
+      if ( lo == hi ) {
+        return;
+      }
+      const size_t last = pieces_.size() - 1;
+      size_t k = index_.rank(x[lo]);
+      for (size_t i = lo; i < hi; i++) {
+        const double xi = x[i];
+        if ( xi < pieces_[k].x0 ) {
+          k = index_.rank(xi);
+        }
+        while ( k < last && xi >= pieces_[k + 1].x0 ) {
+          k++;
+        }
+        y[i] = eval_(pieces_[k], xi);
+      }
+    });
+  }
+
+  const std::vector<Piece>& pieces() const { return pieces_; }
+  const std::vector<double>& curvature() const { return curvature_; }
+  std::pair<double, double> domain() const { return {pieces_.front().x0, hi_}; }
+  size_t size() const { return curvature_.size(); }
+
+private:
+  std::vector<Piece> pieces_{};
+  std::vector<double> curvature_{};  // M_i = S''(x_i)
+  double hi_{0.0};
+  Eytzinger index_{};
+
+  static inline double
+  eval_(const Piece& p, const double x)
+  {
+    const double t = x - p.x0;
+    return p.a + t * (p.b + t * (p.c + t * p.d));
+  }
+
+  void
+  check_(std::span<const double> x, std::span<double> y) const
+  {
+    if ( pieces_.empty() ) {
+      throw std::logic_error("spline evaluated before build()");
+    }
+    if ( x.size() != y.size() ) {
+      throw std::invalid_argument("query and output batches differ in length");
+    }
+  }
+};
+
+/************ Chebyshev ***********************************/
+/*
+ * Degree n interpolant through f at the n + 1 first kind nodes on [a, b],
+ * stored as coefficients of T_j(t) with t the image of x on [-1, 1]
+ */
+class Chebyshev {
+public:
+  static constexpr size_t lanes = 8;      // queries per Clenshaw block
+  static constexpr size_t grain = 16384;  // queries per pool task
+
+  Chebyshev() = default;
+
+  // values[k] = f(nodes(a, b, n)[k])
+  Chebyshev(std::span<const double> values, double a, double b) : a_(a), b_(b)
+  {
+    if ( values.empty() || !(b > a) ) {
+      throw std::invalid_argument("chebyshev needs values and an interval a < b");
+    }
+    transform_(values);
+  }
+
+  template<typename Fn>
+  Chebyshev(Fn&& f, double a, double b, size_t degree)
+  {
+    const std::vector<double> x = nodes(a, b, degree);
+    std::vector<double> v(x.size());
+    for (size_t k = 0; k < x.size(); k++) {
+      v[k] = f(x[k]);
+    }
+    *this = Chebyshev(v, a, b);
+  }
+
+  // x_k = (a + b) / 2 + (b - a) / 2 cos((2k + 1) pi / (2n + 2)), descending
+  static std::vector<double>
+  nodes(double a, double b, size_t degree)
+  {
+    const size_t N = degree + 1;
+    std::vector<double> x(N);
+    for (size_t k = 0; k < N; k++) {
+      x[k] = 0.5 * (a + b) + 0.5 * (b - a) * std::cos(theta_(k, N));
+    }
+    return x;
+  }
+
+  // Clenshaw, b_j = 2t b_{j+1} - b_{j+2} + c_j
+  double
+  operator()(const double x) const
+  {
+    const double t = map_(x), t2 = 2.0 * t;
+    const double* c = c_.data();
+    double b1 = 0.0, b2 = 0.0;
+    for (size_t j = c_.size() - 1; j >= 1; j--) {
+      const double b0 = t2 * b1 - b2 + c[j];
+      b2 = b1;
+      b1 = b0;
+    }
+    return t * b1 - b2 + c[0];
+  }
+
+  /********** Chebyshev::evaluate() ***********************/
+  // lanes queries share each coefficient load, the tail runs one at a time
+  void
+  evaluate(std::span<const double> x, std::span<double> y, ThreadPool* pool = nullptr) const
+  {
+    if ( x.size() != y.size() ) {
+      throw std::invalid_argument("query and output batches differ in length");
+    }
+    chunked(x.size(), pool, grain, [&](size_t lo, size_t hi) {
+      size_t i = lo;
+      for (; i + lanes <= hi; i += lanes) {
+        block_(&x[i], &y[i]);
+      }
+      for (; i < hi; i++) {
+        y[i] = (*this)(x[i]);
+      }
+    });
+  }
+
+  const std::vector<double>& coefficients() const { return c_; }
+  size_t degree() const { return c_.size() - 1; }
+
+private:
+  std::vector<double> c_{0.0};
+  double a_{-1.0}, b_{1.0};
+
+  static double
+  theta_(size_t k, size_t N)
+  {
+    return (2.0 * static_cast<double>(k) + 1.0) * std::numbers::pi / (2.0 * static_cast<double>(N));
+  }
+
+  double map_(const double x) const { return (2.0 * x - a_ - b_) / (b_ - a_); }
+
+  // discrete orthogonality of T_j over the nodes, c_j = 2/N sum f_k T_j(t_k)
+  void
+  transform_(std::span<const double> f)
+  {
+    const size_t N = f.size();
+    c_.assign(N, 0.0);
+    for (size_t k = 0; k < N; k++) {
+      const double t = std::cos(theta_(k, N));
+      double Tm = 1.0, T = t;
+      c_[0] += f[k];
+      for (size_t j = 1; j < N; j++) {
+        c_[j] += f[k] * T;
+        const double Tp = 2.0 * t * T - Tm;
+        Tm = T;
+        T = Tp;
+      }
+    }
+    c_[0] /= static_cast<double>(N);
+    for (size_t j = 1; j < N; j++) {
+      c_[j] *= 2.0 / static_cast<double>(N);
+    }
+  }
+
+  void
+  block_(const double* x, double* y) const
+  {
+    double t[lanes], b1[lanes]{}, b2[lanes]{};
+    for (size_t l = 0; l < lanes; l++) {
+      t[l] = map_(x[l]);
+    }
+    for (size_t j = c_.size() - 1; j >= 1; j--) {
+      const double cj = c_[j];
+      for (size_t l = 0; l < lanes; l++) {
+        const double b0 = 2.0 * t[l] * b1[l] - b2[l] + cj;
+        b2[l] = b1[l];
+        b1[l] = b0;
+      }
+    }
+    for (size_t l = 0; l < lanes; l++) {
+      y[l] = t[l] * b1[l] - b2[l] + c_[0];
+    }
+  }
+};
+
+}  // namespace interp
@@ -0,0 +1,605 @@
+/*
+ * multigrid.hpp  Andrew Belles
+ *
+ * Iterative solvers for -lap u + kappa u = f on a uniform D dimensional
+ * grid (D = 1, 2, 3) with Dirichlet values folded into f. Fields carry one
+ * ghost layer of zeros so the stencil never branches. Red-black ordering
+ * makes every point of one colour independent of the others, so SOR and
+ * Gauss-Seidel sweeps split across a pool; a geometric multigrid V-cycle
+ * on the same smoother gives a contraction that does not degrade with the
+ * grid, standalone or as the preconditioner of conjugate gradients. Every
+ * solve returns its residual history, whose mean contraction is the
+ * measured spectral radius of the iteration
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "pool.hpp"
+
+namespace mg {
+
+/************ Grid ****************************************/
+/*
+ * n[d] interior nodes of spacing h[d] along each axis, axis 0 contiguous.
+ * Interior indices are 1-based, 0 and n[d] + 1 are the ghosts
+ */
+template<size_t D>
+struct Grid {
+  static_assert(D >= 1 && D <= 3, "grids are 1, 2 or 3 dimensional");
+
+  std::array<size_t, D> n{};
+  std::array<double, D> h{};
+  double kappa{0.0};
+
+  size_t
+  stride(size_t d) const
+  {
+    size_t s = 1;
+    for (size_t k = 0; k < d; k++) {
+      s *= n[k] + 2;
+    }
+    return s;
+  }
+
+  // padded length of a field
+  size_t length() const { return stride(D); }
+
+  size_t
+  interior() const
+  {
+    size_t c = 1;
+    for (size_t d = 0; d < D; d++) {
+      c *= n[d];
+    }
+    return c;
+  }
+
+  size_t
+  index(const std::array<size_t, D>& i) const
+  {
+    size_t p = 0;
+    for (size_t d = 0; d < D; d++) {
+      p += i[d] * stride(d);
+    }
+    return p;
+  }
+
+  double
+  diagonal() const
+  {
+    double c = kappa;
+    for (size_t d = 0; d < D; d++) {
+      c += 2.0 / (h[d] * h[d]);
+    }
+    return c;
+  }
+
+  // every axis has an odd count of at least 3, so a grid of 2h nests in it
+  bool
+  coarsens() const
+  {
+    for (size_t d = 0; d < D; d++) {
+      if ( n[d] < 3 || n[d] % 2 == 0 ) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  Grid
+  coarse() const
+  {
+    Grid c = *this;
+    for (size_t d = 0; d < D; d++) {
+      c.n[d] = (n[d] - 1) / 2;
+      c.h[d] = 2.0 * h[d];
+    }
+    return c;
+  }
+};
+
+/************ History *************************************/
+struct History {
+  std::vector<double> residual{};   // relative 2-norm, entry 0 before any work
+  size_t iterations{0};
+  bool converged{false};
+
+  // mean contraction per iteration
+  double
+  rate() const
+  {
+    if ( iterations == 0 || residual.front() == 0.0 ) {
+      return 0.0;
+    }
+    return std::pow(residual.back() / residual.front(), 1.0 / static_cast<double>(iterations));
+  }
+};
+
+struct Options {
+  double tol{1e-10};       // on ||f - A u|| / ||f||
+  size_t maxiter{1000};
+  double omega{0.0};        // SOR relaxation, 0 picks the optimum for the grid
+  size_t pre{2}, post{2};   // smoothing sweeps around the coarse correction
+  size_t coarsest{2000};    // SOR sweep cap on the coarsest level
+  ThreadPool* pool{nullptr};
+  size_t grain{16384};      // fewest points worth a task
+};
+
+/************ Solver **************************************/
+template<size_t D>
+class Solver {
+public:
+  Solver(Grid<D> grid, Options opt = {}) : opt_(opt)
+  {
+    for (size_t d = 0; d < D; d++) {
+      if ( grid.n[d] == 0 || !(grid.h[d] > 0.0) ) {
+        throw std::invalid_argument("grid needs nodes and a positive spacing on every axis");
+      }
+    }
+    if ( grid.kappa < 0.0 ) {
+      throw std::invalid_argument("negative kappa makes the operator indefinite");
+    }
+
+    levels_.push_back(Level(grid));
+    while ( levels_.back().grid.coarsens() ) {
+      levels_.push_back(Level(levels_.back().grid.coarse()));
+    }
+  }
+
+  const Grid<D>& grid() const { return levels_.front().grid; }
+  size_t levels() const { return levels_.size(); }
+
+  /*
+   * Burden and Faires Theorem 7.26 with the Jacobi spectral radius of the
+   * discrete operator, sum_d 2 cos(pi / (n_d + 1)) / h_d^2 over the diagonal
+   */
+  double
+  optimal_omega(const Grid<D>& g) const
+  {
+    double off = 0.0;
+    for (size_t d = 0; d < D; d++) {
+      off += 2.0 * std::cos(M_PI / static_cast<double>(g.n[d] + 1)) / (g.h[d] * g.h[d]);
+    }
+    const double rho = off / g.diagonal();
+    return 2.0 / (1.0 + std::sqrt(1.0 - rho * rho));
+  }
+
+  // f - A u, ghosts of u must hold zeros
+  void
+  residual(std::span<const double> u, std::span<const double> f, std::span<double> r) const
+  {
+    residual_(levels_.front(), u, f, r);
+  }
+
+  /*
+   * Red-black SOR to tolerance, one history entry per sweep (red then black)
+   */
+  History
+  sor(std::span<double> u, std::span<const double> f)
+  {
+    check_(u, f);
+    Level& top = levels_.front();
+    const double omega = ( opt_.omega > 0.0 ) ? opt_.omega : optimal_omega(top.grid);
+    const double fn = norm_(top.grid, f);
+
+    History hist;
+    hist.residual.push_back(relative_(top, u, f, fn));
+    while ( hist.iterations < opt_.maxiter && hist.residual.back() > opt_.tol ) {
+      smooth_(top, u, f, omega, 0);
+      smooth_(top, u, f, omega, 1);
+      hist.iterations++;
+      hist.residual.push_back(relative_(top, u, f, fn));
+    }
+    hist.converged = hist.residual.back() <= opt_.tol;
+    return hist;
+  }
+
+  /*
+   * V-cycles to tolerance, one history entry per cycle. Stops early once a
+   * cycle no longer reduces the residual, which is the rounding floor of
+   * A u on fine grids rather than a failure to converge
+   */
+  History
+  vcycles(std::span<double> u, std::span<const double> f)
+  {
+    check_(u, f);
+    Level& top = levels_.front();
+    const double fn = norm_(top.grid, f);
+
+    History hist;
+    hist.residual.push_back(relative_(top, u, f, fn));
+    while ( hist.iterations < opt_.maxiter && hist.residual.back() > opt_.tol ) {
+      vcycle_(0, u, f);
+      hist.iterations++;
+      hist.residual.push_back(relative_(top, u, f, fn));
+      if ( hist.residual.back() >= hist.residual[hist.residual.size() - 2] ) {
+        break;
+      }
+    }
+    hist.converged = hist.residual.back() <= opt_.tol;
+    return hist;
+  }
+
+  /*
+   * Conjugate gradients preconditioned by one V-cycle from zero. Red-black
+   * before and black-red after the correction keeps the cycle symmetric
+   */
+  History
+  pcg(std::span<double> u, std::span<const double> f)
+  {
+    check_(u, f);
+    Level& top = levels_.front();
+    const Grid<D>& g = top.grid;
+    const size_t len = g.length();
+    const double fn = norm_(g, f);
+
+    std::vector<double> r(len, 0.0), z(len, 0.0), p(len, 0.0), q(len, 0.0);
+    residual_(top, u, f, r);
+
+    History hist;
+    hist.residual.push_back(( fn > 0.0 ) ? norm_(g, r) / fn : norm_(g, r));
+    precondition_(r, z);
+    p = z;
+    double rz = dot_(g, r, z);
+
+    while ( hist.iterations < opt_.maxiter && hist.residual.back() > opt_.tol ) {
+      apply_(g, p, q);
+      const double alpha = rz / dot_(g, p, q);
+      axpy_(g, alpha, p, u);
+      axpy_(g, -alpha, q, r);
+      hist.iterations++;
+      hist.residual.push_back(( fn > 0.0 ) ? norm_(g, r) / fn : norm_(g, r));
+      if ( hist.residual.back() <= opt_.tol ) {
+        break;
+      }
+
+      precondition_(r, z);
+      const double next = dot_(g, r, z);
+      const double beta = next / rz;
+      rz = next;
+      each_(g, -1, [&](size_t i) { p[i] = z[i] + beta * p[i]; });
+    }
+    hist.converged = hist.residual.back() <= opt_.tol;
+    return hist;
+  }
+
+private:
+  struct Level {
+    Grid<D> grid;
+    std::vector<double> u, f, r;
+
+    explicit Level(const Grid<D>& g)
+      : grid(g), u(g.length(), 0.0), f(g.length(), 0.0), r(g.length(), 0.0) {}
+  };
+
+  Options opt_{};
+  std::vector<Level> levels_{};
+
+  void
+  check_(std::span<const double> u, std::span<const double> f) const
+  {
+    const size_t len = levels_.front().grid.length();
+    if ( u.size() != len || f.size() != len ) {
+      throw std::invalid_argument("fields must use the padded grid length");
+    }
+  }
+
+  /*
+   * Interior points are handed out in tasks of about grain points: rows of
+   * axis 0 for D > 1, runs of the one row for D = 1. Points of one colour
+   * never neighbour each other, so a colour's tasks are independent
+   */
+  size_t
+  per_(const Grid<D>& g) const
+  {
+    return ( D == 1 ) ? opt_.grain : std::max<size_t>(1, opt_.grain / g.n[0]);
+  }
+
+  size_t
+  tasks_(const Grid<D>& g) const
+  {
+    if ( opt_.pool == nullptr || g.interior() <= opt_.grain ) {
+      return 1;
+    }
+    const size_t units = ( D == 1 ) ? g.n[0] : g.interior() / g.n[0];
+    return (units + per_(g) - 1) / per_(g);
+  }
+
+  // fn(p) for the points of the colour (-1 for all) in task k of tasks
+  template<typename Fn>
+  void
+  task_(const Grid<D>& g, int colour, size_t k, size_t tasks, Fn&& fn) const
+  {
+    const size_t n0 = g.n[0], rows = g.interior() / n0, per = per_(g);
+    const size_t step = ( colour < 0 ) ? 1 : 2;
+    size_t row_lo = 0, row_hi = rows, i_lo = 1, i_hi = n0;
+    if ( tasks > 1 && D == 1 ) {
+      i_lo = 1 + k * per;
+      i_hi = std::min(n0, (k + 1) * per);
+    } else if ( tasks > 1 ) {
+      row_lo = k * per;
+      row_hi = std::min(rows, (k + 1) * per);
+    }
+
+    for (size_t row = row_lo; row < row_hi; row++) {
+      // the row's interior indices on axes 1.. and their parity
+      size_t base = 0, parity = 0, rest = row;
+      for (size_t d = 1; d < D; d++) {
+        const size_t i = rest % g.n[d] + 1;
+        rest /= g.n[d];
+        base += i * g.stride(d);
+        parity += i;
+      }
+      size_t i = i_lo;
+      if ( colour >= 0 && (i + parity) % 2 != static_cast<size_t>(colour) ) {
+        i++;
+      }
+      for (; i <= i_hi; i += step) {
+        fn(base + i);
+      }
+    }
+  }
+
+  template<typename Fn>
+  void
+  each_(const Grid<D>& g, int colour, Fn&& fn) const
+  {
+    const size_t tasks = tasks_(g);
+    if ( tasks == 1 ) {
+      task_(g, colour, 0, 1, fn);
+      return;
+    }
+    opt_.pool->parallel_for(tasks, [&](size_t k) { task_(g, colour, k, tasks, fn); });
+  }
+
+  // sum of a per point term over the interior, one partial per task
+  template<typename Fn>
+  double
+  sum_(const Grid<D>& g, Fn&& fn) const
+  {
+    const size_t tasks = tasks_(g);
+    std::vector<double> part(tasks, 0.0);
+    auto partial = [&](size_t k) {
+      double acc = 0.0;
+      task_(g, -1, k, tasks, [&](size_t p) { acc += fn(p); });
+      part[k] = acc;
+    };
+    if ( tasks == 1 ) {
+      partial(0);
+    } else {
+      opt_.pool->parallel_for(tasks, partial);
+    }
+
+    double acc = 0.0;
+    for (double v : part) {
+      acc += v;
+    }
+    return acc;
+  }
+
+  double
+  lap_(const Grid<D>& g, const double* u, size_t p) const
+  {
+    double acc = 0.0;
+    for (size_t d = 0; d < D; d++) {
+      const size_t s = g.stride(d);
+      acc += (u[p - s] + u[p + s]) / (g.h[d] * g.h[d]);
+    }
+    return acc;
+  }
+
+  void
+  apply_(const Grid<D>& g, std::span<const double> u, std::span<double> out) const
+  {
+    const double diag = g.diagonal();
+    each_(g, -1, [&](size_t p) { out[p] = diag * u[p] - lap_(g, u.data(), p); });
+  }
+
+  void
+  residual_(const Level& lv, std::span<const double> u, std::span<const double> f,
+            std::span<double> r) const
+  {
+    const Grid<D>& g = lv.grid;
+    const double diag = g.diagonal();
+    each_(g, -1, [&](size_t p) { r[p] = f[p] - diag * u[p] + lap_(g, u.data(), p); });
+  }
+
+  double
+  norm_(const Grid<D>& g, std::span<const double> v) const
+  {
+    return std::sqrt(sum_(g, [&](size_t p) { return v[p] * v[p]; }));
+  }
+
+  double
+  dot_(const Grid<D>& g, std::span<const double> a, std::span<const double> b) const
+  {
+    return sum_(g, [&](size_t p) { return a[p] * b[p]; });
+  }
+
+  void
+  axpy_(const Grid<D>& g, double a, std::span<const double> x, std::span<double> y) const
+  {
+    each_(g, -1, [&](size_t p) { y[p] += a * x[p]; });
+  }
+
+  double
+  relative_(Level& lv, std::span<const double> u, std::span<const double> f, double fn) const
+  {
+    residual_(lv, u, f, lv.r);
+    const double rn = norm_(lv.grid, lv.r);
+    return ( fn > 0.0 ) ? rn / fn : rn;
+  }
+
+  // one colour of an SOR sweep, omega = 1 is Gauss-Seidel
+  void
+  smooth_(const Level& lv, std::span<double> u, std::span<const double> f, double omega,
+          int colour) const
+  {
+    const Grid<D>& g = lv.grid;
+    const double inv = 1.0 / g.diagonal();
+    double* v = u.data();
+    each_(g, colour, [&](size_t p) {
+      const double gs = (f[p] + lap_(g, v, p)) * inv;
+      v[p] += omega * (gs - v[p]);
+    });
+  }
+
+  /*
+   * Full weighting of the fine residual onto the coarse grid. Coarse node j
+   * sits on fine node 2j, its neighbours weigh 1/2 per offset axis
+   */
+  void
+  restrict_(const Grid<D>& fine, std::span<const double> r, Level& coarse) const
+  {
+    const Grid<D>& g = coarse.grid;
+    std::array<size_t, D> fs{};
+    for (size_t d = 0; d < D; d++) {
+      fs[d] = fine.stride(d);
+    }
+
+    each_(g, -1, [&](size_t p) {
+      std::array<size_t, D> j{};
+      size_t rest = p;
+      for (size_t d = D; d-- > 0;) {
+        j[d] = rest / g.stride(d);
+        rest %= g.stride(d);
+      }
+      size_t centre = 0;
+      for (size_t d = 0; d < D; d++) {
+        centre += 2 * j[d] * fs[d];
+      }
+
+      double acc = 0.0;
+      size_t combos = 1;
+      for (size_t d = 0; d < D; d++) {
+        combos *= 3;
+      }
+      for (size_t c = 0; c < combos; c++) {
+        size_t q = centre, code = c;
+        double w = 1.0;
+        for (size_t d = 0; d < D; d++) {
+          const size_t o = code % 3;
+          code /= 3;
+          if ( o == 1 ) {
+            q -= fs[d];
+            w *= 0.25;
+          } else if ( o == 2 ) {
+            q += fs[d];
+            w *= 0.25;
+          } else {
+            w *= 0.5;
+          }
+        }
+        acc += w * r[q];
+      }
+      coarse.f[p] = acc;
+      coarse.u[p] = 0.0;
+    });
+  }
+
+  // adds the linear interpolation of the coarse correction to u
+  void
+  prolong_(const Level& coarse, const Grid<D>& fine, std::span<double> u) const
+  {
+    const Grid<D>& g = coarse.grid;
+    each_(fine, -1, [&](size_t p) {
+      std::array<size_t, D> i{};
+      size_t rest = p;
+      for (size_t d = D; d-- > 0;) {
+        i[d] = rest / fine.stride(d);
+        rest %= fine.stride(d);
+      }
+
+      // even fine nodes lie on coarse ones, odd ones average two neighbours
+      double acc = 0.0;
+      const size_t combos = size_t{1} << D;
+      for (size_t c = 0; c < combos; c++) {
+        size_t q = 0;
+        double w = 1.0;
+        bool skip = false;
+        for (size_t d = 0; d < D && !skip; d++) {
+          const bool hi = (c >> d) & 1;
+          if ( i[d] % 2 == 0 ) {
+            skip = hi;
+            q += (i[d] / 2) * g.stride(d);
+          } else {
+            q += ((i[d] - 1) / 2 + ( hi ? 1 : 0 )) * g.stride(d);
+            w *= 0.5;
+          }
+        }
+        if ( !skip ) {
+          acc += w * coarse.u[q];
+        }
+      }
+      u[p] += acc;
+    });
+  }
+
+  void
+  vcycle_(size_t l, std::span<double> u, std::span<const double> f)
+  {
+    Level& lv = levels_[l];
+    if ( l + 1 == levels_.size() ) {
+      coarsest_(lv, u, f);
+      return;
+    }
+
+    for (size_t k = 0; k < opt_.pre; k++) {
+      smooth_(lv, u, f, 1.0, 0);
+      smooth_(lv, u, f, 1.0, 1);
+    }
+
+    residual_(lv, u, f, lv.r);
+    Level& next = levels_[l + 1];
+    restrict_(lv.grid, lv.r, next);
+    vcycle_(l + 1, next.u, next.f);
+    prolong_(next, lv.grid, u);
+
+    for (size_t k = 0; k < opt_.post; k++) {
+      smooth_(lv, u, f, 1.0, 1);
+      smooth_(lv, u, f, 1.0, 0);
+    }
+  }
+
+  /*
+   * SOR on the coarsest grid until its residual drops well below the
+   * target, symmetric sweeps so the cycle stays a valid preconditioner
+   */
+  void
+  coarsest_(Level& lv, std::span<double> u, std::span<const double> f)
+  {
+    const double omega = optimal_omega(lv.grid);
+    const double fn = norm_(lv.grid, f);
+    if ( fn == 0.0 ) {
+      return;
+    }
+    for (size_t k = 0; k < opt_.coarsest; k++) {
+      smooth_(lv, u, f, omega, 0);
+      smooth_(lv, u, f, omega, 1);
+      smooth_(lv, u, f, omega, 1);
+      smooth_(lv, u, f, omega, 0);
+
+      residual_(lv, u, f, lv.r);
+      if ( norm_(lv.grid, lv.r) <= 1e-3 * opt_.tol * fn ) {
+        return;
+      }
+    }
+  }
+
+  void
+  precondition_(std::span<const double> r, std::span<double> z)
+  {
+    std::fill(z.begin(), z.end(), 0.0);
+    vcycle_(0, z, r);
+  }
+};
+
+}  // namespace mg
@@ -0,0 +1,186 @@
+/*
+ * pool.hpp  Andrew Belles
+ *
+ * Work stealing thread pool shared by the sweep and batch drivers. Every
+ * worker owns a deque, pops its own work from the back and steals from the
+ * front of the others once it runs dry, so uneven tasks balance without a
+ * central queue. Tasks submitted from inside a worker land on its own deque
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+  using Task = std::function<void()>;
+
+  explicit ThreadPool(size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+  {
+    threads = std::max<size_t>(1, threads);
+    for (size_t i = 0; i < threads; i++) {
+      queues_.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+      workers_.emplace_back([this, i]() { work_(i); });
+    }
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(sleep_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& w : workers_) {
+      w.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t size() const { return workers_.size(); }
+
+  // index of the calling worker, size() when called from outside the pool
+  size_t
+  current() const
+  {
+    return ( owner_ == this ) ? self_ : size();
+  }
+
+  void
+  submit(Task task)
+  {
+    const size_t me = current();
+    const size_t to = ( me < size() ) ? me : next_++ % size();
+
+    pending_++;
+    {
+      std::lock_guard<std::mutex> lock(queues_[to]->m);
+      queues_[to]->q.push_back(std::move(task));
+    }
+    {
+      std::lock_guard<std::mutex> lock(sleep_);
+      queued_++;
+    }
+    wake_.notify_one();
+  }
+
+  /*
+   * Blocks until every submitted task has run, rethrows the first exception
+   * a task raised. Must not be called from inside a task
+   */
+  void
+  wait()
+  {
+    std::unique_lock<std::mutex> lock(sleep_);
+    idle_.wait(lock, [this]() { return pending_ == 0; });
+    if ( error_ ) {
+      auto e = error_;
+      error_ = nullptr;
+      std::rethrow_exception(e);
+    }
+  }
+
+  // fn(i) for every i in [0, n), returns once all have finished
+  template<typename Fn>
+  void
+  parallel_for(size_t n, Fn&& fn)
+  {
+    for (size_t i = 0; i < n; i++) {
+      submit([&fn, i]() { fn(i); });
+    }
+    wait();
+  }
+
+private:
+  struct Queue {
+    std::mutex m;
+    std::deque<Task> q;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues_{};
+  std::vector<std::thread> workers_{};
+  std::mutex sleep_;
+  std::condition_variable wake_, idle_;
+  std::atomic<size_t> pending_{0}, next_{0};
+  size_t queued_{0};
+  bool stop_{false};
+  std::exception_ptr error_{nullptr};
+
+  static inline thread_local const ThreadPool* owner_{nullptr};
+  static inline thread_local size_t self_{0};
+
+  // own deque back first (LIFO, cache warm), then steal the front of others
+  bool
+  pop_(size_t self, Task& task)
+  {
+    const size_t n = size();
+    for (size_t k = 0; k < n; k++) {
+      Queue& victim = *queues_[(self + k) % n];
+      std::lock_guard<std::mutex> lock(victim.m);
+      if ( victim.q.empty() ) {
+        continue;
+      }
+      if ( k == 0 ) {
+        task = std::move(victim.q.back());
+        victim.q.pop_back();
+      } else {
+        task = std::move(victim.q.front());
+        victim.q.pop_front();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void
+  work_(size_t self)
+  {
+    owner_ = this;
+    self_  = self;
+
+    while ( true ) {
+      {
+        std::unique_lock<std::mutex> lock(sleep_);
+        wake_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+        if ( stop_ && queued_ == 0 ) {
+          return;
+        }
+        queued_--;
+      }
+
+      // a queued task is reserved for us, spin until a deque hands it over
+      Task task;
+      while ( !pop_(self, task) ) {
+        std::this_thread::yield();
+      }
+
+      try {
+        task();
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(sleep_);
+        if ( !error_ ) {
+          error_ = std::current_exception();
+        }
+      }
+
+      if ( --pending_ == 0 ) {
+        std::lock_guard<std::mutex> lock(sleep_);
+        idle_.notify_all();
+      }
+    }
+  }
+};
@@ -0,0 +1,261 @@
+/*
+ * render.hpp  Andrew Belles
+ *
+ * Asynchronous render stage shared by every gplot++ front end. Figures are
+ * described as plain data, submitted to a single background worker that owns
+ * the gnuplot pipes, and decimated to the output pixel width before they are
+ * written so compute never blocks on plotting. Setting NOPLOT in the
+ * environment runs headless, submit() then drops figures without rendering
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <gplot++.h>
+
+class RenderQueue {
+public:
+
+  enum class Scale : int8_t {
+    Linear,
+    LogX,
+    LogY,
+    LogXY
+  };
+
+  struct Series {
+    std::vector<double> x, y;
+    std::string label;
+    Gnuplot::LineStyle style{Gnuplot::LineStyle::LINES};
+  };
+
+  struct Panel {
+    std::string title, xlabel, ylabel;
+    std::optional<std::pair<double, double>> xrange{}, yrange{};
+    Scale scale{Scale::Linear};
+    std::vector<Series> series{};
+  };
+
+  // more than one panel renders as a single-row multiplot under title
+  struct Figure {
+    std::string png;
+    std::string size{"1200,800"};
+    std::string title{};
+    std::vector<Panel> panels{};
+  };
+
+  // process wide queue, drained and joined at exit
+  static RenderQueue&
+  instance()
+  {
+    static RenderQueue queue;
+    return queue;
+  }
+
+  static bool
+  headless()
+  {
+    static const bool off = ( std::getenv("NOPLOT") != nullptr );
+    return off;
+  }
+
+  // pixel width from a gnuplot size string such as "1200,800"
+  static size_t
+  width(const std::string& size)
+  {
+    return std::max<size_t>(1, std::strtoul(size.c_str(), nullptr, 10));
+  }
+
+  /********** RenderQueue::decimate() *********************/
+  /*
+   * Min/max (M4) decimation: keeps the first, last, lowest and highest point
+   * of every pixel column, so the rendered line is identical to the full
+   * series at that width. Unsorted x (parametric curves) is left untouched
+   */
+  static void
+  decimate(Series& s, size_t pixels)
+  {
+    const size_t n = std::min(s.x.size(), s.y.size());
+    if ( n <= 4 * pixels || !std::is_sorted(s.x.begin(), s.x.begin() + n) ) {
+      return;
+    }
+
+    const double x0 = s.x.front(), span = s.x[n - 1] - x0;
+    if ( !(span > 0.0) ) {
+      return;
+    }
+
+    std::vector<double> dx, dy;
+    dx.reserve(4 * pixels);
+    dy.reserve(4 * pixels);
+
+    size_t i = 0;
+    while ( i < n ) {
+      const size_t col = std::min(pixels - 1,
+        static_cast<size_t>((s.x[i] - x0) / span * pixels));
+      size_t first = i, last = i, lo = i, hi = i;
+
+      while ( i < n && std::min(pixels - 1,
+              static_cast<size_t>((s.x[i] - x0) / span * pixels)) == col ) {
+        if ( s.y[i] < s.y[lo] ) {
+          lo = i;
+        }
+        if ( s.y[i] > s.y[hi] ) {
+          hi = i;
+        }
+        last = i++;
+      }
+
+      size_t keep[4] = {first, std::min(lo, hi), std::max(lo, hi), last};
+      for (size_t k = 0; k < 4; k++) {
+        if ( k > 0 && keep[k] == keep[k - 1] ) {
+          continue;
+        }
+        dx.push_back(s.x[keep[k]]);
+        dy.push_back(s.y[keep[k]]);
+      }
+    }
+
+    s.x = std::move(dx);
+    s.y = std::move(dy);
+  }
+
+  // non-blocking, the figure is moved onto the worker
+  void
+  submit(Figure fig)
+  {
+    if ( headless() ) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      todo_.push_back(std::move(fig));
+      if ( !worker_.joinable() ) {
+        worker_ = std::thread([this]() { work_(); });
+      }
+    }
+    cv_.notify_one();
+  }
+
+  // blocks until every submitted figure has been written
+  void
+  wait()
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    idle_.wait(lock, [this]() { return todo_.empty() && !busy_; });
+  }
+
+  ~RenderQueue()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      done_ = true;
+    }
+    cv_.notify_one();
+    if ( worker_.joinable() ) {
+      worker_.join();
+    }
+  }
+
+private:
+  std::mutex mtx_;
+  std::condition_variable cv_, idle_;
+  std::deque<Figure> todo_{};
+  std::thread worker_{};
+  bool busy_{false}, done_{false};
+
+  RenderQueue() = default;
+
+  void
+  work_()
+  {
+    while ( true ) {
+      Figure fig;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this]() { return done_ || !todo_.empty(); });
+        if ( todo_.empty() ) {
+          return;
+        }
+        fig = std::move(todo_.front());
+        todo_.pop_front();
+        busy_ = true;
+      }
+
+      render_(fig);
+
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        busy_ = false;
+      }
+      idle_.notify_all();
+    }
+  }
+
+  static void
+  render_(Figure& fig)
+  {
+    Gnuplot plt{};
+    const size_t pixels = width(fig.size) / std::max<size_t>(1, fig.panels.size());
+
+    plt.redirect_to_png(fig.png, fig.size);
+    if ( fig.panels.size() > 1 ) {
+      plt.multiplot(1, fig.panels.size(), fig.title);
+    }
+
+    for (auto& panel : fig.panels) {
+      // multiplot keeps settings across panels, each one starts from defaults
+      plt.sendcommand("unset logscale");
+      plt.sendcommand("set autoscale x");
+      plt.sendcommand("set autoscale y");
+      if ( !panel.title.empty() ) {
+        plt.set_title(panel.title);
+      }
+      if ( !panel.xlabel.empty() ) {
+        plt.set_xlabel(panel.xlabel);
+      }
+      if ( !panel.ylabel.empty() ) {
+        plt.set_ylabel(panel.ylabel);
+      }
+      if ( panel.xrange ) {
+        plt.set_xrange(panel.xrange->first, panel.xrange->second);
+      }
+      if ( panel.yrange ) {
+        plt.set_yrange(panel.yrange->first, panel.yrange->second);
+      }
+
+      switch (panel.scale) {
+        case Scale::LogX:
+          plt.set_logscale(Gnuplot::AxisScale::LOGX);
+          break;
+        case Scale::LogY:
+          plt.set_logscale(Gnuplot::AxisScale::LOGY);
+          break;
+        case Scale::LogXY:
+          plt.set_logscale(Gnuplot::AxisScale::LOGXY);
+          break;
+        case Scale::Linear:
+        default:
+          break;
+      }
+
+      for (auto& s : panel.series) {
+        decimate(s, pixels);
+        plt.plot(s.x, s.y, s.label, s.style);
+      }
+      plt.show();
+    }
+  }
+};
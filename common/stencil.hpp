@@ -0,0 +1,306 @@
+/*
+ * stencil.hpp  Andrew Belles
+ *
+ * Finite difference stencils of any derivative order and order of accuracy,
+ * forward or centered, with one-sided stencils of matching accuracy at the
+ * bounds. Weights come from Fornberg's recurrence once at construction and
+ * are applied in a single pass into caller provided spans, with any constant
+ * scale (such as a motor speed) folded into the weights. Two derivatives of
+ * the same signal can be fused so the signal is only read once
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace stencil {
+
+constexpr size_t max_taps = 16;
+
+enum class Kind : int8_t {
+  Forward,
+  Centered
+};
+
+/********** stencil::fornberg() *************************/
+/*
+ * Weights of the m-th derivative at x = 0 from samples at offsets z (in
+ * units of h). Fornberg, "Generation of Finite Difference Formulas on
+ * Arbitrarily Spaced Grids" (1988)
+ */
+inline std::vector<double>
+fornberg(int m, std::span<const double> z)
+{
+  const size_t n = z.size();
+  std::vector<double> c(n * (m + 1), 0.0);
+  auto C = [&](size_t i, int k) -> double& { return c[i * (m + 1) + k]; };
+
+  double c1 = 1.0, c4 = z[0];
+  C(0, 0) = 1.0;
+  for (size_t i = 1; i < n; i++) {
+    const int mn = std::min<int>(i, m);
+    double c2 = 1.0, c5 = c4;
+    c4 = z[i];
+
+    for (size_t j = 0; j < i; j++) {
+      const double c3 = z[i] - z[j];
+      c2 *= c3;
+      if ( j == i - 1 ) {
+        for (int k = mn; k > 0; k--) {
+          C(i, k) = c1 * (k * C(i - 1, k - 1) - c5 * C(i - 1, k)) / c2;
+        }
+        C(i, 0) = -c1 * c5 * C(i - 1, 0) / c2;
+      }
+      for (int k = mn; k > 0; k--) {
+        C(j, k) = (c4 * C(j, k) - k * C(j, k - 1)) / c3;
+      }
+      C(j, 0) = c4 * C(j, 0) / c3;
+    }
+    c1 = c2;
+  }
+
+  std::vector<double> w(n);
+  for (size_t i = 0; i < n; i++) {
+    w[i] = C(i, m);
+  }
+  return w;
+}
+
+class Derivative;
+inline void fused(const Derivative& a, const Derivative& b, std::span<const double> f,
+                  double h, std::span<double> out_a, std::span<double> out_b,
+                  double scale_a = 1.0, double scale_b = 1.0);
+
+/*
+ * order-th derivative of uniformly sampled data with error O(h^accuracy).
+ * Forward stencils turn backward at the right bound, centered stencils
+ * (even accuracy only) turn one-sided at both bounds
+ */
+class Derivative {
+public:
+  Derivative(int order, int accuracy, Kind kind = Kind::Centered)
+    : order_(order)
+  {
+    if ( order < 1 || accuracy < 1 ) {
+      throw std::invalid_argument("stencil order and accuracy must be positive");
+    }
+    if ( kind == Kind::Centered && accuracy % 2 != 0 ) {
+      throw std::invalid_argument("centered stencils need an even accuracy");
+    }
+
+    // one-sided window width for the requested accuracy
+    bound_ = static_cast<size_t>(order + accuracy);
+    if ( kind == Kind::Centered ) {
+      const int r = (order + 1) / 2 - 1 + accuracy / 2;
+      taps_  = static_cast<size_t>(2 * r + 1);
+      first_ = -r;
+      left_  = static_cast<size_t>(r);
+      right_ = static_cast<size_t>(r);
+    } else {
+      taps_  = bound_;
+      first_ = 0;
+      left_  = 0;
+      right_ = bound_ - 1;
+    }
+    if ( std::max(taps_, bound_) > max_taps ) {
+      throw std::invalid_argument("stencil wider than max_taps");
+    }
+
+    std::vector<double> z(taps_);
+    for (size_t k = 0; k < taps_; k++) {
+      z[k] = static_cast<double>(first_ + static_cast<int>(k));
+    }
+    auto w = fornberg(order_, z);
+    std::copy(w.begin(), w.end(), interior_.begin());
+
+    // boundary rows, left row i samples [0, bound), right row j (node n-1-j)
+    // samples [n - bound, n)
+    z.resize(bound_);
+    for (size_t i = 0; i < left_; i++) {
+      for (size_t k = 0; k < bound_; k++) {
+        z[k] = static_cast<double>(k) - static_cast<double>(i);
+      }
+      lrows_.push_back(fornberg(order_, z));
+    }
+    for (size_t j = 0; j < right_; j++) {
+      for (size_t k = 0; k < bound_; k++) {
+        z[k] = static_cast<double>(j) + 1.0 + static_cast<double>(k)
+             - static_cast<double>(bound_);
+      }
+      rrows_.push_back(fornberg(order_, z));
+    }
+  }
+
+  int order() const { return order_; }
+  size_t taps() const { return taps_; }
+
+  // fewest samples the stencil can be applied to
+  size_t
+  minimum() const
+  {
+    return std::max({taps_, bound_, left_ + right_ + 1});
+  }
+
+  // out[i] = scale * f^(order)(x_i), out may not alias f
+  void
+  apply(std::span<const double> f, double h, std::span<double> out, double scale = 1.0) const
+  {
+    check_(f, out);
+    const size_t n = f.size();
+    const double s = scale_(h, scale);
+    bounds_(f, out, s, left_, n - right_);
+
+    double w[2][max_taps]{};
+    weigh_(w[0], s, first_);
+    dispatch_<1>(taps_, f.data() + (left_ + first_), n - right_ - left_, w,
+                 out.data() + left_, nullptr);
+  }
+
+private:
+  int order_{1};
+  size_t taps_{0}, bound_{0}, left_{0}, right_{0};
+  int first_{0};
+  std::array<double, max_taps> interior_{};
+  std::vector<std::vector<double>> lrows_{}, rrows_{};
+
+  friend void fused(const Derivative&, const Derivative&, std::span<const double>,
+                    double, std::span<double>, std::span<double>, double, double);
+
+  void
+  check_(std::span<const double> f, std::span<double> out) const
+  {
+    if ( f.size() < minimum() ) {
+      throw std::invalid_argument("too few samples for stencil");
+    }
+    if ( out.size() != f.size() ) {
+      throw std::invalid_argument("stencil output must match input length");
+    }
+  }
+
+  double
+  scale_(double h, double scale) const
+  {
+    double hm = 1.0;
+    for (int k = 0; k < order_; k++) {
+      hm *= h;
+    }
+    return scale / hm;
+  }
+
+  // scaled interior weights, left aligned on the stencil window
+  void
+  weigh_(double* w, double s, int first) const
+  {
+    for (size_t k = 0; k < taps_; k++) {
+      w[k + (first_ - first)] = s * interior_[k];
+    }
+  }
+
+  // every node outside [lo, hi): boundary rows, otherwise interior weights
+  void
+  bounds_(std::span<const double> f, std::span<double> out, double s,
+          size_t lo, size_t hi) const
+  {
+    const size_t n = f.size();
+    auto dot = [&](const double* w, size_t taps, size_t begin) {
+      double acc = 0.0;
+      for (size_t k = 0; k < taps; k++) {
+        acc += w[k] * f[begin + k];
+      }
+      return s * acc;
+    };
+
+    for (size_t i = 0; i < lo; i++) {
+      out[i] = ( i < left_ ) ? dot(lrows_[i].data(), bound_, 0)
+                             : dot(interior_.data(), taps_, i + first_);
+    }
+    for (size_t i = hi; i < n; i++) {
+      const size_t j = n - 1 - i;
+      out[i] = ( j < right_ ) ? dot(rrows_[j].data(), bound_, n - bound_)
+                              : dot(interior_.data(), taps_, i + first_);
+    }
+  }
+
+  /********** Derivative::kernel_() ***********************/
+  /*
+   * T taps and D outputs known at compile time, so the tap loop unrolls
+   * and the node loop vectorizes. f points at the first tap of the first
+   * node, o0/o1 at that node's outputs
+   */
+  template<size_t T, size_t D>
+  static void
+  kernel_(const double* __restrict f, size_t count,
+          const double (&w)[2][max_taps], double* __restrict o0, double* __restrict o1)
+  {
+    for (size_t i = 0; i < count; i++) {
+      double a0 = 0.0, a1 = 0.0;
+      for (size_t k = 0; k < T; k++) {
+        a0 += w[0][k] * f[i + k];
+        if constexpr ( D == 2 ) {
+          a1 += w[1][k] * f[i + k];
+        }
+      }
+      o0[i] = a0;
+      if constexpr ( D == 2 ) {
+        o1[i] = a1;
+      }
+    }
+  }
+
+  template<size_t D, size_t T = 1>
+  static void
+  dispatch_(size_t taps, const double* f, size_t count,
+            const double (&w)[2][max_taps], double* o0, double* o1)
+  {
+    if constexpr ( T <= max_taps ) {
+      if ( taps == T ) {
+        kernel_<T, D>(f, count, w, o0, o1);
+      } else {
+        dispatch_<D, T + 1>(taps, f, count, w, o0, o1);
+      }
+    }
+  }
+};
+
+/********** stencil::fused() ****************************/
+/*
+ * a and b of the same signal in one read of f, e.g. first and second
+ * derivative. Interior weights are padded onto the union of both windows
+ */
+inline void
+fused(const Derivative& a, const Derivative& b, std::span<const double> f, double h,
+      std::span<double> out_a, std::span<double> out_b, double scale_a, double scale_b)
+{
+  a.check_(f, out_a);
+  b.check_(f, out_b);
+
+  const size_t n  = f.size();
+  const size_t lo = std::max(a.left_, b.left_), hi = n - std::max(a.right_, b.right_);
+  const int first = std::min(a.first_, b.first_);
+  const int last  = std::max(a.first_ + static_cast<int>(a.taps_),
+                             b.first_ + static_cast<int>(b.taps_));
+  const double sa = a.scale_(h, scale_a), sb = b.scale_(h, scale_b);
+
+  if ( last - first > static_cast<int>(max_taps) || lo >= hi ) {
+    a.apply(f, h, out_a, scale_a);
+    b.apply(f, h, out_b, scale_b);
+    return;
+  }
+
+  a.bounds_(f, out_a, sa, lo, hi);
+  b.bounds_(f, out_b, sb, lo, hi);
+
+  double w[2][max_taps]{};
+  a.weigh_(w[0], sa, first);
+  b.weigh_(w[1], sb, first);
+  Derivative::dispatch_<2>(static_cast<size_t>(last - first), f.data() + (lo + first),
+                           hi - lo, w, out_a.data() + lo, out_b.data() + lo);
+}
+
+}  // namespace stencil
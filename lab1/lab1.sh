@@ -1,8 +1,10 @@
 rm -f *.o *.png
 rm -f recurrence 
 
-g++ recurrence.cpp -lm -o recurrence 
+g++ -std=c++20 -O3 -march=native recurrence.cpp -lm -o recurrence 
 
 cat ic_front.txt | ./recurrence 1.0 15.0 40.0 1 | python plot.py --direction "Forward" 
 
 cat ic_back.txt | ./recurrence 1.0 15.0 40.0 0 | python plot.py --direction "Backward"
+
+./recurrence 1.0 15.0 40.0 2 | python plot.py --direction "Miller"
@@ -3,16 +3,21 @@
  *
  * Defines methods for computing nth bessel functions
  * from initial conditions, as well as computing error 
+ * ./recurrence --bench [lanes=...] [orders=...] [reps=n] times Bessel::run() 
  *
  */
 
 #include <iostream> 
 #include <cmath> 
 #include <vector> 
-#include <array> 
+#include <span> 
+#include <cstring> 
+#include <algorithm> 
 #include <cstdint>
 #include <cstdio> 
 
+#include "../common/bench.hpp"
+
 /*
  * Cyclindrical bessel values to compare computed values to 
  */ 
@@ -26,76 +31,211 @@ besselj(double x, uint32_t N)
   return vec; 
 }
 
+/*
+ * Advances one order of the recurrence across every x lane at once: 
+ *   next[i] = (2n / x_i) * curr[i] - prev[i]
+ * Rows are contiguous and non-aliasing so -O3 -march=native emits packed 
+ * AVX2/AVX-512 multiplies over the lanes 
+ */ 
+static inline void 
+recurrence_row(double* __restrict next, const double* __restrict curr, 
+               const double* __restrict prev, const double* __restrict inv_x, 
+               const double two_n, const size_t m)
+{
+  for (size_t i(0); i < m; i++) {
+    next[i] = (two_n * inv_x[i]) * curr[i] - prev[i]; 
+  }
+}
+
+/*
+ * Start order for Miller's algorithm. Seeded far enough above both N and x 
+ * that the dominant solution has washed out to tol by the time the recurrence 
+ * reaches N (Numerical Recipes heuristic, ACC scaled by the requested digits)
+ */ 
+static inline uint32_t 
+miller_start(double x, uint32_t N, double tol)
+{
+  const double digits = -std::log10(tol); 
+  const double top = std::max(static_cast<double>(N), std::abs(x)); 
+  return static_cast<uint32_t>(top + std::sqrt(10.0 * digits * top)) + 2; 
+}
+
 class Bessel {
 public: 
-  std::vector<std::vector<double>> computed;  // computed from recurrence  
-  std::vector<std::vector<double>> error;     // residual error 
+  enum Direction : int8_t {
+    Backward, 
+    Forward, 
+    Miller 
+  };
+
+  /* 
+   * Both tables are flat and order-major: J_n(x_i) lives at [n * lanes() + i] 
+   */
+  std::vector<double> computed;  // computed from recurrence  
+  std::vector<double> error;     // residual error 
 
   Bessel(
-      std::array<double, 3> x_values, 
-      std::array<std::pair<double, double>, 3> ic, 
+      std::span<const double> x_values, 
+      std::span<const std::pair<double, double>> ic, 
       uint32_t N,
-      bool forward
-  ) : forward_(forward), initial_conditions_(ic), N_(N), x_values_(x_values) {
+      Direction direction
+  ) : direction_(direction), N_(N), 
+      initial_conditions_(ic.begin(), ic.end()), 
+      x_values_(x_values.begin(), x_values.end()) 
+  {
+    inv_x_.resize(x_values_.size()); 
+    for (size_t i(0); i < x_values_.size(); i++) {
+      inv_x_[i] = 1.0 / x_values_[i]; 
+    }
+  }
 
-      for (auto& x : x_values) {
-        real_.push_back(besselj(x, N));
-      }
+  // Miller's algorithm needs no initial conditions, only a target accuracy 
+  Bessel(std::span<const double> x_values, uint32_t N, double tol = 1e-16)
+    : Bessel(x_values, {}, N, Miller) 
+  {
+    tol_ = tol; 
   }
 
+  /*
+   * Reference values from std::cyl_bessel_j are only computed when the 
+   * caller asks for the error table 
+   */ 
   void 
-  run() 
+  run(bool with_error = true) 
   {
     compute_recurrence_();
-    compute_error_(); 
+    if ( with_error ) {
+      compute_error_(); 
+    } else {
+      error.clear(); 
+    }
   }
 
+  size_t lanes() const { return x_values_.size(); }
+  uint32_t orders() const { return N_; }
+
+  // J_n(x_i) from the flat buffer 
+  double at(uint32_t n, size_t i) const { return computed[n * lanes() + i]; }
+  double error_at(uint32_t n, size_t i) const { return error[n * lanes() + i]; }
+
 private: 
-  std::array<std::pair<double, double>, 3> initial_conditions_; // J_0,  J_1 
-  bool forward_; 
+  Direction direction_; 
   uint32_t N_; 
-  std::vector<std::vector<double>> real_; 
-  std::array<double, 3> x_values_;
+  double tol_{1e-16}; 
+  std::vector<std::pair<double, double>> initial_conditions_; // J_0,  J_1 
+  std::vector<double> x_values_;
+  std::vector<double> inv_x_;  // 1/x per lane, keeps divides out of the kernel 
+  std::vector<double> work_;   // three rotating rows for Miller orders >= N 
+
+  static constexpr double big = 1e10;  // rescale threshold for Miller lanes 
 
   /* 
    * From recurrence relation: 
    *   J_{n+1}(x) = \frac{2 * n}{x} * J_n(x) - J_{n-1}(x)
    * Or, if backwards: 
    *   J_{n-1}(x) = \frac{2 * n}{x} * J_n(x) - J_{n+1}(x)
+   *
+   * All x values are walked in lockstep, one order row at a time 
    */
   void
   compute_recurrence_() 
   {
-    computed.clear(); 
-    error.clear();         // set first two to zero ? 
-    double C = 0.0, next = 0.0, x= 0.0;  
+    const size_t m = lanes(); 
+    computed.assign(N_ * m, 0.0); 
+    error.clear(); 
+
+    double* J = computed.data(); 
+    const double* ix = inv_x_.data(); 
+
+    if ( direction_ == Miller ) {
+      miller_(); 
+    } else if ( direction_ == Forward ) {
+      for (size_t i(0); i < m; i++) {
+        J[i]     = initial_conditions_[i].first; 
+        J[m + i] = initial_conditions_[i].second; 
+      }
+
+      for (uint32_t j(1); j < N_ - 1; j++) {
+        recurrence_row(J + (j + 1) * m, J + j * m, J + (j - 1) * m, 
+                       ix, 2.0 * j, m);
+      }
+
+    } else { // from iter downto 0 
+      for (size_t i(0); i < m; i++) {
+        J[(N_ - 2) * m + i] = initial_conditions_[i].first; 
+        J[(N_ - 1) * m + i] = initial_conditions_[i].second; 
+      }
 
-    computed.resize(3);
-    for (auto& arr : computed) {
-      arr.resize(N_);
+      for (uint32_t j(N_ - 2); j > 0; j--) {
+        recurrence_row(J + (j - 1) * m, J + j * m, J + (j + 1) * m, 
+                       ix, 2.0 * j, m);
+      }
     }
+  }
 
-    for (int i(0); i < 3; i++) {
-      x = x_values_[i];
-      if ( forward_ ) {
-        computed[i][0] = initial_conditions_[i].first; 
-        computed[i][1] = initial_conditions_[i].second; 
+  /*
+   * Miller's algorithm: seed J_{M+1} = 0, J_M = 1 at a start order M above 
+   * every lane, recur downward in lockstep, then normalize each lane with 
+   *   J_0(x) + 2 * \sum_{k >= 1} J_{2k}(x) = 1 
+   * Orders >= N live in three rotating work rows and are never stored 
+   */ 
+  void 
+  miller_() 
+  {
+    const size_t m = lanes(); 
+    double* J = computed.data(); 
+    const double* ix = inv_x_.data(); 
 
-        for (uint32_t j(1); j < N_ - 1; j++) {
-          C = (2.0 * j) / x; 
-          next = C * computed[i][j] - computed[i][j - 1];
-          computed[i][j + 1] = next;  
-        }
+    uint32_t M = N_ + 1; 
+    for (auto& x : x_values_) {
+      M = std::max(M, miller_start(x, N_, tol_)); 
+    }
+
+    work_.assign(3 * m, 0.0); 
+    std::vector<double> sum(m, 0.0); 
+    auto row = [&](uint32_t n) -> double* {
+      return ( n < N_ ) ? J + n * m : work_.data() + (n % 3) * m; 
+    }; 
 
-      } else { // from iter downto 0 
-        computed[i][N_ - 2] = initial_conditions_[i].first; 
-        computed[i][N_ - 1] = initial_conditions_[i].second; 
+    std::fill_n(row(M + 1), m, 0.0); 
+    std::fill_n(row(M), m, 1.0); 
+    if ( M % 2 == 0 ) {
+      for (size_t i(0); i < m; i++) {
+        sum[i] += 2.0; 
+      }
+    }
+
+    for (uint32_t j(M); j > 0; j--) {
+      double* prev = row(j - 1); 
+      recurrence_row(prev, row(j), row(j + 1), ix, 2.0 * j, m);
+
+      if ( (j - 1) % 2 == 0 ) {
+        const double w = ( j == 1 ) ? 1.0 : 2.0; 
+        for (size_t i(0); i < m; i++) {
+          sum[i] += w * prev[i]; 
+        }
+      }
 
-        for (uint32_t j(N_ - 2); j > 0; j--) {
-          C = (2.0 * j) / x; 
-          next = C * computed[i][j] - computed[i][j + 1];
-          computed[i][j - 1] = next;  
+      // rescale any lane about to overflow, including rows already stored 
+      for (size_t i(0); i < m; i++) {
+        if ( std::abs(prev[i]) <= big ) {
+          continue; 
         }
+        prev[i] /= big; 
+        row(j)[i] /= big; 
+        sum[i] /= big; 
+        for (uint32_t n(j + 1); n < N_; n++) {
+          J[n * m + i] /= big; 
+        }
+      }
+    }
+
+    for (size_t i(0); i < m; i++) {
+      sum[i] = 1.0 / sum[i]; 
+    }
+    for (uint32_t n(0); n < N_; n++) {
+      for (size_t i(0); i < m; i++) {
+        J[n * m + i] *= sum[i]; 
       }
     }
   }
@@ -103,76 +243,137 @@ private:
   void 
   compute_error_()
   {
-    error.clear();
-    error.resize(3);
-    for (auto& arr : error) {
-      arr.resize(N_);
-    }
-
-    for (int i(0); i < 3; i++) {
-      for (uint32_t j(0); j < N_; j++) {
-        error[i][j] = computed[i][j] - real_[i][j];
+    const size_t m = lanes(); 
+    error.resize(computed.size());
+    for (size_t i(0); i < m; i++) {
+      auto real = besselj(x_values_[i], N_); 
+      for (uint32_t n(0); n < N_; n++) {
+        error[n * m + i] = computed[n * m + i] - real[n];
       }
     }
   }
 };
 
 
+int benchmark(int argc, char* argv[]); 
+
 int main(int argc, char* argv[]) 
 {
+  if ( argc > 1 && std::strcmp(argv[1], "--bench") == 0 ) {
+    return benchmark(argc, argv); 
+  }
+
   std::pair<double, double> ic(0.0, 0.0);
-  std::array<std::pair<double, double>, 3> ics;
+  std::vector<std::pair<double, double>> ics;
   double x = 0.0; 
-  int forward = 0; 
-  std::array<double, 3> x_values;
+  int mode = 0; 
+  std::vector<double> x_values;
+  bool with_error = true; 
+  int first = 1; 
+
+  // -n: skip reference values and the error table entirely 
+  if ( argc > 1 && std::strcmp(argv[1], "-n") == 0 ) {
+    with_error = false; 
+    first++; 
+  }
 
-  if ( argc != 5) {
-    std::cerr << "Expects 3 x values and forward (0,1)\n"; 
+  if ( argc - first < 2 ) {
+    std::cerr << "Expects 1 or more x values and direction (0 back, 1 forward, 2 miller)\n"; 
     return 1; 
   }
 
-  for (int i(1); i < 4; i++) {
+  for (int i(first); i < argc - 1; i++) {
     if ( sscanf(argv[i], "%lf", &x) != 1 ) {
       std::cerr << "Choked converting argument to x value\n";
       return 2; 
     } else {
-      x_values[i - 1] = x;
+      x_values.push_back(x);
     }
   }
 
-  if ( sscanf(argv[4], "%d", &forward) != 1 ) {
-    std::cerr << "Expected T/F for forward\n";
+  if ( sscanf(argv[argc - 1], "%d", &mode) != 1 || mode < 0 || mode > 2 ) {
+    std::cerr << "Expected 0, 1, or 2 for direction\n";
     return 3; 
   }
 
-  // expect initial condition pair off stdin
-  for (int i(0); i < 3; i++) {
+  auto direction = static_cast<Bessel::Direction>(mode); 
+
+  // expect initial condition pair off stdin, one per x value (not for miller) 
+  for (size_t i(0); direction != Bessel::Miller && i < x_values.size(); i++) {
     if ( fscanf(stdin, "%lf %lf", &ic.first, &ic.second) != 2 ) {
       std::cerr << "Expects initial conditions off stdin\n";
       return 4;
     } else {
-      ics[i] = ic;
+      ics.push_back(ic);
     }
   }
 
-  Bessel bessel = Bessel(x_values, ics, 51, forward);  
-  bessel.run();
+  Bessel bessel = ( direction == Bessel::Miller ) 
+    ? Bessel(x_values, 51) 
+    : Bessel(x_values, ics, 51, direction);  
+  bessel.run(with_error);
 
   for (auto& x : x_values) {
     std::cout << x << ' ';
   }
   fputc('\n', stdout);
 
-  for (int i(0); i < 3; i++) {
-    for (auto& val : bessel.computed[i]) {
-      std::cout << val << '\n';
+  for (size_t i(0); i < bessel.lanes(); i++) {
+    for (uint32_t n(0); n < bessel.orders(); n++) {
+      std::cout << bessel.at(n, i) << '\n';
     }
 
-    for (auto& err : bessel.error[i]) {
-      std::cout << err << '\n';
+    for (uint32_t n(0); with_error && n < bessel.orders(); n++) {
+      std::cout << bessel.error_at(n, i) << '\n';
     }
   }
 
 
   return 0; 
 }
+
+/************ benchmark() *********************************/
+/*
+ * ./recurrence --bench [lanes=64,4096,65536] [orders=51] [reps=5] 
+ * Forward and Miller tables without reference values, x spread over 
+ * [0.5, 20]. A step is one table entry J_n(x_i) 
+ */ 
+int 
+benchmark(int argc, char* argv[]) 
+{
+  try {
+    const bench::Args args(argc, argv); 
+    args.allow({"lanes", "orders", "reps"}); 
+    const size_t reps = static_cast<size_t>(args.get("reps", 5)); 
+
+    for (double orders : args.list("orders", {51})) {
+      for (double count : args.list("lanes", {64, 4096, 65536})) {
+        const size_t m = static_cast<size_t>(count); 
+        const uint32_t N = static_cast<uint32_t>(orders); 
+        std::vector<double> x(m); 
+        std::vector<std::pair<double, double>> ic(m); 
+        for (size_t i(0); i < m; i++) {
+          x[i] = 0.5 + 19.5 * static_cast<double>(i) / static_cast<double>(std::max<size_t>(1, m - 1)); 
+          ic[i] = {std::cyl_bessel_j(0.0, x[i]), std::cyl_bessel_j(1.0, x[i])}; 
+        }
+
+        Bessel forward(x, ic, N, Bessel::Forward), miller(x, N); 
+        const bench::Work work{m * N, 0}; 
+        const std::vector<std::pair<std::string, double>> params{{"lanes", count}, {"orders", orders}}; 
+        bench::emit(bench::measure("bessel_forward", params, reps, [&]() {
+          forward.run(false); 
+          return work; 
+        })); 
+        bench::emit(bench::measure("bessel_miller", params, reps, [&]() {
+          miller.run(false); 
+          return work; 
+        })); 
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "invalid usage: ./recurrence --bench [lanes=...] [orders=...] [reps=n]: " 
+              << e.what() << '\n'; 
+    return 1; 
+  }
+  return 0; 
+}
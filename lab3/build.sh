@@ -0,0 +1,5 @@
+#!/usr/bin/bash 
+
+rm -f *.o interpolate
+
+g++ -std=c++20 -O3 -march=native -pthread interpolate.cpp -o interpolate -lm 
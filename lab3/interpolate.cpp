@@ -0,0 +1,198 @@
+/*
+ * interpolate.cpp  Andrew Belles
+ *
+ * Port of polyfit.py and parametric.py onto the shared interpolation
+ * engine. Chebyshev interpolants of the polyfit.py function on [-2, 2] are
+ * compared against natural splines through the same number of uniform
+ * samples, the lab3 parametric curve is fit both globally (data placed on
+ * the Chebyshev nodes as in the prototype) and by splines in s, and the
+ * batched query paths are timed against a plain binary search
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <gplot++.h>
+
+#include "../common/interp.hpp"
+#include "../common/pool.hpp"
+#include "../common/render.hpp"
+
+static double
+func(double x)
+{
+  return std::sin(6.0 * x) * std::cos(std::sqrt(5.0) * x) - x * x * std::exp(-x / 5.0);
+}
+
+static std::vector<double>
+linspace(double a, double b, size_t n)
+{
+  std::vector<double> v(n);
+  for (size_t i = 0; i < n; i++) {
+    v[i] = a + (b - a) * static_cast<double>(i) / static_cast<double>(n - 1);
+  }
+  return v;
+}
+
+template<typename Fn>
+static double
+milliseconds(Fn&& fn)
+{
+  const auto t0 = std::chrono::steady_clock::now();
+  fn();
+  const auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+/************ polyfit.py **********************************/
+static void
+degrees(ThreadPool& pool)
+{
+  const double a = -2.0, b = 2.0;
+  const std::vector<double> x = linspace(a, b, 1000);
+  std::vector<double> fx(x.size()), p(x.size());
+  std::transform(x.begin(), x.end(), fx.begin(), func);
+
+  RenderQueue::Panel panel{"Global Error for Select Chebyshev Polynomials", "x",
+                           "|f(x) - P_N(x)|", std::pair{a, b}};
+  panel.scale = RenderQueue::Scale::LogY;
+
+  std::printf("%5s %14s %14s\n", "N", "chebyshev", "spline");
+  const size_t N[] = {5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17,
+                      18, 19, 20, 21, 22, 23, 24, 25, 26, 60, 75, 90};
+  for (size_t n : N) {
+    const interp::Chebyshev cheb(func, a, b, n);
+    cheb.evaluate(x, p, &pool);
+    double ec = 0.0;
+    std::vector<double> err(x.size());
+    for (size_t i = 0; i < x.size(); i++) {
+      err[i] = std::max(std::abs(fx[i] - p[i]), 1e-16);
+      ec = std::max(ec, err[i]);
+    }
+    if ( n == 5 || n == 20 || n == 26 || n == 75 ) {
+      panel.series.push_back({x, std::move(err), "deg=" + std::to_string(n)});
+    }
+
+    // the natural spline through the n + 1 uniform samples polyfit.py used
+    const std::vector<double> knots = linspace(a, b, n + 1);
+    std::vector<double> fk(knots.size());
+    std::transform(knots.begin(), knots.end(), fk.begin(), func);
+    interp::Spline(knots, fk).evaluate_sorted(x, p);
+    double es = 0.0;
+    for (size_t i = 0; i < x.size(); i++) {
+      es = std::max(es, std::abs(fx[i] - p[i]));
+    }
+    std::printf("%5zu %14.6e %14.6e\n", n, ec, es);
+  }
+
+  RenderQueue::instance().submit({"chebyshev_errors.png", "1200,800", "", {panel}});
+}
+
+/************ parametric.py *******************************/
+static void
+parametric(const char* path)
+{
+  std::FILE* f = std::fopen(path, "r");
+  if ( !f ) {
+    throw std::runtime_error("choked on invalid file");
+  }
+  std::vector<double> x, y;
+  double xi = 0.0, yi = 0.0;
+  while ( std::fscanf(f, "%lf %lf", &xi, &yi) == 2 ) {
+    x.push_back(xi);
+    y.push_back(yi);
+  }
+  std::fclose(f);
+
+  const size_t n = x.size();
+  const std::vector<double> knots = linspace(0.0, 1.0, n), s = linspace(0.0, 1.0, 1000);
+  const interp::Spline sx(knots, x), sy(knots, y);
+  const interp::Chebyshev gx(x, 0.0, 1.0), gy(y, 0.0, 1.0);
+
+  std::vector<double> xs(s.size()), ys(s.size()), xg(s.size()), yg(s.size());
+  sx.evaluate_sorted(s, xs);
+  sy.evaluate_sorted(s, ys);
+  gx.evaluate(s, xg);
+  gy.evaluate(s, yg);
+
+  auto [xlo, xhi] = std::minmax_element(xs.begin(), xs.end());
+  auto [ylo, yhi] = std::minmax_element(ys.begin(), ys.end());
+  std::printf("\n%zu parametric points, spline x(s) in [%.4f, %.4f], y(s) in [%.4f, %.4f]\n", n,
+              *xlo, *xhi, *ylo, *yhi);
+  std::printf("%4s %12s %12s %12s %12s\n", "k", "a", "b", "c", "d");
+  for (size_t k = 0; k < sx.pieces().size(); k++) {
+    const auto& p = sx.pieces()[k];
+    std::printf("%4zu %12.6f %12.6f %12.6f %12.6f\n", k, p.a, p.b, p.c, p.d);
+  }
+
+  RenderQueue::Panel panel{"Natural Spline and Global Approximation of Parametric Curve", "x",
+                           "y"};
+  panel.series.push_back({std::move(xs), std::move(ys), "natural spline"});
+  panel.series.push_back({std::move(xg), std::move(yg), "global"});
+  panel.series.push_back({x, y, "original parametric", Gnuplot::LineStyle::LINESPOINTS});
+  RenderQueue::instance().submit({"comp_spline_global.png", "1200,800", "", {panel}});
+}
+
+/************ query throughput ****************************/
+static void
+throughput(ThreadPool& pool)
+{
+  const size_t knots = size_t{1} << 16, queries = size_t{1} << 22;
+  const std::vector<double> k = linspace(-2.0, 2.0, knots);
+  std::vector<double> fk(knots);
+  std::transform(k.begin(), k.end(), fk.begin(), func);
+  const interp::Spline spline(k, fk);
+  const interp::Chebyshev cheb(func, -2.0, 2.0, 90);
+
+  std::mt19937_64 gen(91);
+  std::uniform_real_distribution<double> U(-2.0, 2.0);
+  std::vector<double> q(queries), sorted(queries), out(queries), ref(queries);
+  for (auto& v : q) {
+    v = U(gen);
+  }
+  sorted = q;
+  std::sort(sorted.begin(), sorted.end());
+
+  // reference, std::upper_bound over the knots and the same cubic
+  const double tb = milliseconds([&]() {
+    const auto& pieces = spline.pieces();
+    for (size_t i = 0; i < queries; i++) {
+      const size_t j = std::upper_bound(k.begin() + 1, k.end() - 1, q[i]) - (k.begin() + 1);
+      const double t = q[i] - pieces[j].x0;
+      ref[i] = pieces[j].a + t * (pieces[j].b + t * (pieces[j].c + t * pieces[j].d));
+    }
+  });
+  const double te = milliseconds([&]() { spline.evaluate(q, out); });
+  double diff = 0.0;
+  for (size_t i = 0; i < queries; i++) {
+    diff = std::max(diff, std::abs(out[i] - ref[i]));
+  }
+  const double tp = milliseconds([&]() { spline.evaluate(q, out, &pool); });
+  const double tw = milliseconds([&]() { spline.evaluate_sorted(sorted, out); });
+  const double tc = milliseconds([&]() { cheb.evaluate(q, out, &pool); });
+
+  auto report = [&](const char* name, double ms) {
+    std::printf("%-26s %10.3f ms %9.1f Mq/s\n", name, ms, 1e-3 * static_cast<double>(queries) / ms);
+  };
+  std::printf("\n%zu queries, %zu knots, %zu threads\n", queries, knots, pool.size());
+  report("spline binary search", tb);
+  report("spline eytzinger", te);
+  report("spline eytzinger, pool", tp);
+  report("spline sorted walk", tw);
+  report("chebyshev N = 90, pool", tc);
+  std::printf("eytzinger vs binary search max difference %.3e\n", diff);
+}
+
+int main(int argc, char* argv[])
+{
+  ThreadPool pool;
+  degrees(pool);
+  parametric(( argc > 1 ) ? argv[1] : "lab3_data-1.txt");
+  throughput(pool);
+  return 0;
+}
@@ -3,14 +3,25 @@
  *
  * Linear, Cubic polynomial, and Log Linear fits from least squares  
  * Additional errors plots are included. Usage: ./run.sh [args]
+ * ./approx [data] [fit enum] [fit.png] --stream fits out-of-core, no plots
+ * fit enum 5 with --degree k gives a QR least squares polynomial of degree k
+ * fit enum 6 interpolates the data with a natural cubic spline 
  *
  */ 
 
 #include <iostream> 
 #include <cmath> 
-#include <fstream> 
+#include <cstdio> 
 #include <cstdint> 
+#include <cstring> 
+#include <cctype> 
+#include <charconv> 
 #include <string_view>
+#include <span>
+#include <array>
+#include <functional>
+#include <future>
+#include <thread>
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
@@ -18,6 +29,12 @@
 #include <gplot++.h>
 #include <lapacke.h> 
 
+#include "../common/instrument.hpp"
+#include "../common/interp.hpp"
+#include "../common/pool.hpp"
+#include "../common/render.hpp"
+#include "../common/vmath.hpp"
+
 static inline std::vector<double> linspace(double s, double e, int n);
 
 /************ polynomial evaluation overloads *************/ 
@@ -27,6 +44,471 @@ static inline std::vector<double> evaluate(const std::vector<double>& coeffs,
 static inline std::vector<double> evaluate_loglinear(const std::vector<double>& coeffs,
                                                      const std::vector<double>& x);
 
+// every LAPACK call goes through here so the probe counts and times it 
+template<typename Call> 
+static inline lapack_int 
+lapack(Call&& call) 
+{
+  PROBE_ADD(LapackCalls, 1); 
+  PROBE_TIME(Lapack); 
+  return call(); 
+}
+
+/*
+ * Compensated (Kahan) summation. Keeps the low order bits that a running 
+ * sum over hundreds of millions of points would otherwise drop 
+ */ 
+struct Kahan {
+  double sum{0.0}, c{0.0}; 
+
+  inline void 
+  add(const double v) 
+  {
+    const double y = v - c; 
+    const double t = sum + y; 
+    c = (t - sum) - y; 
+    sum = t; 
+  }
+
+  operator double() const { return sum; }
+};
+
+/*
+ * Least squares polynomial fit of arbitrary degree through Householder QR 
+ * (dgels) rather than normal equations. x is mapped onto [-1, 1] before the 
+ * design matrix is built, so large x does not wreck the conditioning. The 
+ * workspace is sized once and reused across repeated fits of the same shape, 
+ * and nrhs y-columns sharing one x grid are solved off a single factorization 
+ */ 
+class PolyFit {
+public: 
+
+  enum Basis : int8_t {
+    Vandermonde,  // columns t^j 
+    Chebyshev     // columns T_j(t) 
+  };
+
+  PolyFit(size_t degree = 3, Basis basis = Chebyshev) 
+    : k_(degree + 1), basis_(basis) {}
+
+  /********** PolyFit::solve() ****************************/
+  /*
+   * Y is column-major m x nrhs. Returns the (degree + 1) x nrhs column-major 
+   * block of basis coefficients, valid until the next call 
+   */ 
+  const std::vector<double>& 
+  solve(std::span<const double> x, std::span<const double> Y, size_t nrhs = 1)
+  {
+    const size_t m = x.size(); 
+    if ( m < k_ ) {
+      throw std::invalid_argument("fewer points than polynomial coefficients");
+    }
+    if ( Y.size() != m * nrhs ) {
+      throw std::invalid_argument("y block does not match x grid");
+    }
+
+    reserve_(m, nrhs); 
+    lo_ = *std::min_element(x.begin(), x.end()); 
+    hi_ = *std::max_element(x.begin(), x.end()); 
+    design_(x); 
+    std::copy(Y.begin(), Y.end(), B_.begin()); 
+
+    const lapack_int info = lapack([&]() {
+      return LAPACKE_dgels_work(LAPACK_COL_MAJOR, 'N', m, k_, nrhs, A_.data(), m, B_.data(), 
+                                m, work_.data(), static_cast<lapack_int>(work_.size())); 
+    });
+    if ( info != 0 ) {
+      throw std::runtime_error("lapacke least squares failure"); 
+    }
+
+    coeffs_.resize(k_ * nrhs); 
+    for (size_t j = 0; j < nrhs; j++) {
+      std::copy_n(B_.begin() + j * m, k_, coeffs_.begin() + j * k_); 
+    }
+    return coeffs_; 
+  }
+
+  // evaluates column col of the last solve at x, Clenshaw for Chebyshev 
+  double 
+  evaluate(const double x, size_t col = 0) const 
+  {
+    const double t = map_(x); 
+    const double* c = coeffs_.data() + col * k_; 
+    double b1 = 0.0, b2 = 0.0; 
+    int j = 0; 
+
+    if ( basis_ == Vandermonde ) {
+      for (j = k_ - 1; j >= 0; j--) {
+        b1 = b1 * t + c[j]; 
+      }
+      return b1; 
+    }
+
+    for (j = k_ - 1; j >= 1; j--) {
+      const double b0 = 2.0 * t * b1 - b2 + c[j]; 
+      b2 = b1; 
+      b1 = b0; 
+    }
+    return t * b1 - b2 + c[0]; 
+  }
+
+  /*
+   * Converts column col to monomial coefficients in x for display. The 
+   * conversion brings back the conditioning the mapped basis avoids, so fits 
+   * are evaluated through evaluate() above 
+   */ 
+  std::vector<double> 
+  monomial(size_t col = 0) const 
+  {
+    const double* c = coeffs_.data() + col * k_; 
+    std::vector<double> pt(k_, 0.0); 
+
+    if ( basis_ == Vandermonde ) {
+      std::copy_n(c, k_, pt.begin()); 
+    } else {
+      // T_j in powers of t by T_{j+1} = 2t T_j - T_{j-1} 
+      std::vector<double> Tm(k_, 0.0), T(k_, 0.0), Tp(k_, 0.0); 
+      Tm[0] = 1.0; 
+      pt[0] = c[0]; 
+      if ( k_ > 1 ) {
+        T[1] = 1.0; 
+        pt[1] += c[1]; 
+      }
+      for (size_t j = 2; j < k_; j++) {
+        Tp[0] = -Tm[0]; 
+        for (size_t i = 1; i < k_; i++) {
+          Tp[i] = 2.0 * T[i - 1] - Tm[i]; 
+        }
+        for (size_t i = 0; i < k_; i++) {
+          pt[i] += c[j] * Tp[i]; 
+        }
+        std::swap(Tm, T); 
+        std::swap(T, Tp); 
+      }
+    }
+
+    // substitute t = s x + o by Horner over polynomials 
+    const double s = scale_(), o = -(hi_ + lo_) / (hi_ - lo_); 
+    std::vector<double> px(k_, 0.0); 
+    for (int i = k_ - 1; i >= 0; i--) {
+      for (size_t j = k_ - 1; j > 0; j--) {
+        px[j] = o * px[j] + s * px[j - 1]; 
+      }
+      px[0] = o * px[0] + pt[i]; 
+    }
+    return px; 
+  }
+
+  size_t degree() const { return k_ - 1; }
+
+private: 
+  static constexpr size_t block = 256;  // rows per design matrix block 
+
+  size_t k_; 
+  Basis basis_; 
+  double lo_{-1.0}, hi_{1.0}; 
+  size_t m_{0}, nrhs_{0}; 
+  std::vector<double> A_{}, B_{}, work_{}, coeffs_{}; 
+
+  inline double scale_() const { return 2.0 / (hi_ - lo_); }
+  inline double map_(const double x) const { return scale_() * (x - lo_) - 1.0; }
+
+  // grows buffers and queries the optimal dgels workspace only on shape change 
+  void 
+  reserve_(size_t m, size_t nrhs) 
+  {
+    if ( m == m_ && nrhs == nrhs_ ) {
+      return; 
+    }
+    m_ = m; 
+    nrhs_ = nrhs; 
+    A_.resize(m * k_); 
+    B_.resize(m * nrhs); 
+
+    double query = 0.0; 
+    lapack([&]() {
+      return LAPACKE_dgels_work(LAPACK_COL_MAJOR, 'N', m, k_, nrhs, A_.data(), m, 
+                                B_.data(), m, &query, -1); 
+    }); 
+    work_.resize(std::max<size_t>(1, static_cast<size_t>(query))); 
+  }
+
+  /*
+   * Builds the m x k column-major design matrix a block of rows at a time so 
+   * every column of the block stays in cache while the recurrence fills it 
+   */ 
+  void 
+  design_(std::span<const double> x) 
+  {
+    const size_t m = x.size(); 
+    double* A = A_.data(); 
+
+    for (size_t r0 = 0; r0 < m; r0 += block) {
+      const size_t r1 = std::min(m, r0 + block); 
+      for (size_t i = r0; i < r1; i++) {
+        A[i] = 1.0; 
+      }
+      if ( k_ == 1 ) {
+        continue; 
+      }
+      for (size_t i = r0; i < r1; i++) {
+        A[m + i] = map_(x[i]); 
+      }
+      for (size_t j = 2; j < k_; j++) {
+        const double* t  = A + m; 
+        const double* c1 = A + (j - 1) * m; 
+        const double* c2 = A + (j - 2) * m; 
+        double* cj = A + j * m; 
+        for (size_t i = r0; i < r1; i++) {
+          cj[i] = ( basis_ == Chebyshev ) 
+            ? 2.0 * t[i] * c1[i] - c2[i] 
+            : t[i] * c1[i]; 
+        }
+      }
+    }
+  }
+};
+
+/*
+ * Levenberg-Marquardt nonlinear least squares over P parameters for a user 
+ * supplied model. The model evaluates a block of points at once, writing 
+ * f(x_i; p) and the row-major n x P Jacobian df/dp, so it can use vectorized 
+ * kernels internally. Each evaluation reduces J^T J, J^T r and r^T r over the 
+ * points, split across the pool's workers when the data is resident, or block 
+ * by block through a streaming source when it is not. Several starts run concurrently 
+ * and the lowest cost converged solution is returned 
+ */ 
+template<size_t P> 
+class LevenbergMarquardt {
+public: 
+  using Params = std::array<double, P>; 
+  using Model  = std::function<void(const double* x, size_t n, const Params& p, 
+                                    double* f, double* J)>; 
+  using Block  = std::function<void(const double* x, const double* y, size_t n)>; 
+  using Source = std::function<void(const Block&)>; 
+
+  struct Result {
+    Params p{}; 
+    double cost{HUGE_VAL};  // 0.5 * r^T r 
+    size_t iterations{0}; 
+    bool converged{false}; 
+  };
+
+  static constexpr size_t block = 256; 
+
+  // resident data, reduction split over pool, serial without one 
+  LevenbergMarquardt(Model model, std::span<const double> x, std::span<const double> y, 
+                     ThreadPool* pool = nullptr)
+    : model_(std::move(model)), x_(x), y_(y), pool_(pool), 
+      threads_(( pool ) ? pool->size() : 1) 
+  {
+    if ( x.size() != y.size() ) {
+      throw std::invalid_argument("x and y differ in length");
+    }
+  }
+
+  // out-of-core data, source replays every block on each evaluation 
+  LevenbergMarquardt(Model model, Source source)
+    : model_(std::move(model)), source_(std::move(source)), threads_(1) {}
+
+  /********** LevenbergMarquardt::solve() *****************/
+  /*
+   * Runs every start to convergence, concurrently when data is resident, 
+   * and returns the best result 
+   */ 
+  Result 
+  solve(const std::vector<Params>& starts) 
+  {
+    std::vector<Result> results(starts.size()); 
+
+    if ( source_ || starts.size() == 1 ) {
+      for (size_t i = 0; i < starts.size(); i++) {
+        results[i] = run_(starts[i], threads_); 
+      }
+    } else {
+      const size_t share = std::max<size_t>(1, threads_ / starts.size()); 
+      std::vector<std::future<Result>> jobs; 
+      for (auto& p0 : starts) {
+        jobs.push_back(std::async(std::launch::async, [this, p0, share]() {
+          return run_(p0, share); 
+        }));
+      }
+      for (size_t i = 0; i < jobs.size(); i++) {
+        results[i] = jobs[i].get(); 
+      }
+    }
+
+    return *std::min_element(results.begin(), results.end(), 
+      [](const Result& a, const Result& b) {
+        if ( a.converged != b.converged ) {
+          return a.converged; 
+        }
+        return a.cost < b.cost; 
+      }
+    ); 
+  }
+
+  // convergence controls 
+  size_t maxiter{200}; 
+  double ftol{1e-12}, xtol{1e-12}, gtol{1e-12}; 
+
+private: 
+  static constexpr size_t parallel_min = size_t{1} << 15;  // points per thread 
+
+  struct Normal {
+    double JtJ[P * P]{0.0}; 
+    double Jtr[P]{0.0}; 
+    double cost{0.0}; 
+
+    void 
+    merge(const Normal& o) 
+    {
+      for (size_t i = 0; i < P * P; i++) {
+        JtJ[i] += o.JtJ[i]; 
+      }
+      for (size_t i = 0; i < P; i++) {
+        Jtr[i] += o.Jtr[i]; 
+      }
+      cost += o.cost; 
+    }
+  };
+
+  Model model_; 
+  Source source_{}; 
+  std::span<const double> x_{}, y_{}; 
+  ThreadPool* pool_{nullptr}; 
+  size_t threads_; 
+
+  // accumulates one block into N, scratch lives on the stack 
+  void 
+  accumulate_(const double* x, const double* y, size_t n, const Params& p, 
+              Normal& N) const 
+  {
+    double f[block], J[block * P]; 
+
+    for (size_t b0 = 0; b0 < n; b0 += block) {
+      const size_t nb = std::min(block, n - b0); 
+      model_(x + b0, nb, p, f, J); 
+
+      for (size_t i = 0; i < nb; i++) {
+        const double r = y[b0 + i] - f[i]; 
+        const double* Ji = J + i * P; 
+        N.cost += 0.5 * r * r; 
+        for (size_t a = 0; a < P; a++) {
+          N.Jtr[a] += Ji[a] * r; 
+          for (size_t c = 0; c < P; c++) {
+            N.JtJ[a * P + c] += Ji[a] * Ji[c]; 
+          }
+        }
+      }
+    }
+  }
+
+  Normal 
+  evaluate_(const Params& p, size_t threads) const 
+  {
+    Normal N{}; 
+
+    if ( source_ ) {
+      source_([&](const double* x, const double* y, size_t n) {
+        accumulate_(x, y, n, p, N); 
+      });
+      return N; 
+    }
+
+    const size_t m = x_.size(); 
+    const size_t T = std::clamp<size_t>(m / parallel_min, 1, threads); 
+    if ( T == 1 || !pool_ ) {
+      accumulate_(x_.data(), y_.data(), m, p, N); 
+      return N; 
+    }
+
+    // fixed partition and merge order keeps the reduction deterministic 
+    std::vector<Normal> partial(T); 
+    pool_->parallel_for(T, [&](size_t t) {
+      const size_t lo = m * t / T, hi = m * (t + 1) / T; 
+      accumulate_(x_.data() + lo, y_.data() + lo, hi - lo, p, partial[t]); 
+    });
+    for (auto& part : partial) {
+      N.merge(part); 
+    }
+    return N; 
+  }
+
+  /*
+   * Marquardt scaled damping: solve (J^T J + lambda diag(J^T J)) dp = J^T r, 
+   * shrink lambda on an accepted step, grow it on a rejected one 
+   */ 
+  Result 
+  run_(const Params& p0, size_t threads) const 
+  {
+    Result res{p0}; 
+    Normal N = evaluate_(p0, threads); 
+    double lambda = 1e-3; 
+    res.cost = N.cost; 
+
+    while ( res.iterations < maxiter ) {
+      res.iterations++; 
+      PROBE_ADD(NewtonIterations, 1); 
+
+      double gmax = 0.0; 
+      for (auto& g : N.Jtr) {
+        gmax = std::max(gmax, std::abs(g)); 
+      }
+      if ( gmax <= gtol ) {
+        res.converged = true; 
+        break; 
+      }
+
+      double A[P * P], dp[P]; 
+      lapack_int ipiv[P]; 
+      for (size_t i = 0; i < P * P; i++) {
+        A[i] = N.JtJ[i]; 
+      }
+      for (size_t i = 0; i < P; i++) {
+        A[i * P + i] *= (1.0 + lambda); 
+        dp[i] = N.Jtr[i]; 
+      }
+
+      if ( lapack([&]() { return LAPACKE_dgesv(LAPACK_ROW_MAJOR, P, 1, A, P, ipiv, dp, 1); }) != 0 ) {
+        lambda *= 10.0; 
+        continue; 
+      }
+
+      Params pn = res.p; 
+      double step = 0.0, scale = 0.0; 
+      for (size_t i = 0; i < P; i++) {
+        pn[i] += dp[i]; 
+        step  += dp[i] * dp[i]; 
+        scale += res.p[i] * res.p[i]; 
+      }
+
+      Normal Nn = evaluate_(pn, threads); 
+      if ( Nn.cost < res.cost ) {
+        // relative drop, an exact fit has nothing left to drop 
+        const double drop = ( res.cost > 0.0 ) ? (res.cost - Nn.cost) / res.cost : 0.0; 
+        res.p = pn; 
+        res.cost = Nn.cost; 
+        N = Nn; 
+        lambda = std::max(lambda * 0.1, 1e-12); 
+
+        if ( drop <= ftol || std::sqrt(step) <= xtol * (std::sqrt(scale) + xtol) ) {
+          res.converged = true; 
+          break; 
+        }
+      } else {
+        lambda *= 10.0; 
+        // no downhill step at any damping, already at the minimum 
+        if ( lambda > 1e16 ) {
+          res.converged = true; 
+          break; 
+        }
+      }
+    }
+    return res; 
+  }
+};
+
 class DataSet {
 public: 
 
@@ -35,22 +517,74 @@ public:
     Cubic,
     LogLinear,
     NonLinear, 
-    All 
+    All,
+    Polynomial, 
+    Spline 
   };
 
+  // a Spline curve carries the knot curvatures, evaluation goes through spline() 
   struct FitCurve {
     FitType type;
     std::vector<double> coeffs; 
   };
+
+  /*
+   * Every sum the linear, cubic and log linear fits need, accumulated in a 
+   * single pass so the fits never rescan the data 
+   */ 
+  struct Moments {
+    size_t m{0}; 
+    Kahan xp[7];          // \sum x^k,     k = 0..6 
+    Kahan xyp[4];         // \sum x^k y,   k = 0..3 
+    Kahan logy, xlogy;    // \sum ln y,  \sum x ln y 
+    bool positive{true};  // every y > 0, log linear fit is defined 
+    double xmin{HUGE_VAL}, xmax{-HUGE_VAL}; 
+    double x0{0.0}, y0{0.0}; 
+
+    inline void 
+    add(const double x, const double y) 
+    {
+      if ( m == 0 ) {
+        x0 = x; 
+        y0 = y; 
+      }
+      m++; 
+      xmin = std::min(xmin, x); 
+      xmax = std::max(xmax, x); 
+
+      double p = 1.0; 
+      for (size_t k = 0; k < 7; k++) {
+        xp[k].add(p); 
+        if ( k < 4 ) {
+          xyp[k].add(p * y); 
+        }
+        p *= x; 
+      }
+
+      if ( y > 0.0 ) {
+        const double ly = std::log(y); 
+        logy.add(ly); 
+        xlogy.add(x * ly); 
+      } else {
+        positive = false; 
+      }
+    }
+  };
   
-  DataSet(const char* path) : path_(path) {
-    fptr_.open(path);  
-    if ( !fptr_.is_open() ) {
+  /*
+   * streaming: keep only the running moments, never the points themselves. 
+   * Resident memory stays O(1) in the number of points 
+   */ 
+  DataSet(const char* path, bool streaming = false) 
+    : path_(path), streaming_(streaming) 
+  {
+    fptr_ = std::fopen(path, "rb");  
+    if ( !fptr_ ) {
       throw std::runtime_error("choked on invalid file");
     }
   }
 
-  ~DataSet() { fptr_.close(); }
+  ~DataSet() { std::fclose(fptr_); }
 
   /********** DataSet::read() *****************************/
   /* 
@@ -62,28 +596,15 @@ public:
   {
     x_.clear(); 
     y_.clear(); 
-    fptr_.clear(); 
-    fptr_.seekg(0, std::ios::beg);
-
-    double x = 0.0, y = 0.0; 
-    // live running totals 
-    double lxsq = 0.0, lxy = 0.0, lsx = 0.0, lsy = 0.0; 
+    moments_ = Moments{}; 
 
-    while ( fptr_ >> x >> y ) {
-      x_.push_back(x);
-      y_.push_back(y);
-      
-      lxsq += x * x; 
-      lxy  += x * y; 
-      lsx  += x; 
-      lsy  += y; 
-    }
-
-    // save collected totals 
-    xsq_ = lxsq; 
-    xy_  = lxy; 
-    sx_  = lsx; 
-    sy_  = lsy; 
+    stream_([&](double x, double y) {
+      if ( !streaming_ ) {
+        x_.push_back(x);
+        y_.push_back(y);
+      }
+      moments_.add(x, y); 
+    });
   }
 
   /********** DataSet::fit() ******************************/ 
@@ -93,9 +614,14 @@ public:
    *
    */
   std::vector<FitCurve> 
-  fit(FitType fit_enum)
+  fit(FitType fit_enum, size_t degree = 3)
   {
+    PROBE_TIME(Fit); 
     switch (fit_enum) {
+      case Polynomial: 
+        return { FitCurve{Polynomial, polynomial_(degree)} };
+      case Spline: 
+        return { FitCurve{Spline, spline_()} };
       case Linear: 
         return { FitCurve{Linear, linear_()} };
       case Cubic: 
@@ -127,6 +653,10 @@ public:
         return "NonLinear";
       case All:
         return "All";
+      case Polynomial: 
+        return "Polynomial";
+      case Spline: 
+        return "Spline";
     }
     return "invalid";
   }
@@ -134,29 +664,65 @@ public:
   /********** DataSet::plot() ******************************/
   /*
    * Plots all fits provided to it, utilizes enum methods to 
-   * properly label fits to their approximation method
+   * properly label fits to their approximation method. Fits are sampled 
+   * twice per output pixel and handed to the render queue, so this returns 
+   * before gnuplot runs. Nothing is evaluated when running headless. The 
+   * spline interpolates, so it has no error panel entry 
    *
    */ 
   void 
   plot(const std::vector<FitCurve>& coeff_table, 
        std::string& png, std::string& title)
   {
+    using RQ = RenderQueue; 
+
+    if ( streaming_ ) {
+      throw std::runtime_error("plot requires in-memory data");
+    }
+    if ( RQ::headless() ) {
+      return; 
+    }
+
+    const std::string size = "1200,800"; 
     double xmin = *std::min_element(x_.begin(), x_.end()); 
     double xmax = *std::max_element(x_.begin(), x_.end()); 
-    auto xarr = linspace(xmin, xmax, (xmax - xmin) * 1000.0 );
-    int i = 0, m = y_.size(); 
-    std::vector<std::vector<double>> ytable, err_table; 
+    auto xarr = linspace(xmin, xmax, 2 * RQ::width(size));
+    int m = y_.size(); 
+
+    RQ::Panel fits{title, "x", "y", std::pair{xmin, xmax}}; 
+    RQ::Panel logs{"LogLinear and NonLinear Fits on Logscale", "x", "y [logscale]", 
+                   std::pair{xmin, xmax}, {}, RQ::Scale::LogY}; 
+    RQ::Panel errs{"Log-Scale Error: " + title, "x", "relative error [log-scale]", 
+                   std::pair{xmin, xmax}, {}, RQ::Scale::LogY}; 
     
     for (auto& [type, coeff] : coeff_table) {
+      const bool exponential = (type == LogLinear || type == NonLinear); 
+      const std::string label(to_string(type)); 
       std::vector<double> err(m); 
 
-      std::vector<double> yhat = (type == LogLinear || type == NonLinear)
-        ? evaluate_loglinear(coeff, x_)
-        : evaluate(coeff, x_);
+      if ( type == Spline ) {
+        std::vector<double> yarr(xarr.size()); 
+        spline_fit_.evaluate_sorted(xarr, yarr); 
+        fits.series.push_back({xarr, std::move(yarr), label});
+        continue; 
+      }
+
+      // polynomial coefficients are in the mapped Chebyshev basis of poly_ 
+      auto curve = [&](const std::vector<double>& xs) {
+        if ( exponential ) {
+          return evaluate_loglinear(coeff, xs); 
+        }
+        if ( type == Polynomial ) {
+          std::vector<double> ys(xs.size()); 
+          std::transform(xs.begin(), xs.end(), ys.begin(), 
+                         [&](double x) { return poly_.evaluate(x); }); 
+          return ys; 
+        }
+        return evaluate(coeff, xs); 
+      }; 
 
-      std::vector<double> yarr = (type == LogLinear || type == NonLinear)
-        ? evaluate_loglinear(coeff, xarr)
-        : evaluate(coeff, xarr);
+      std::vector<double> yhat = curve(x_); 
+      std::vector<double> yarr = curve(xarr); 
 
       std::transform(
         y_.begin(), y_.end(), yhat.begin(), err.begin(),
@@ -165,131 +731,196 @@ public:
         }
       );
 
-      ytable.push_back(yarr);
-      err_table.push_back(err);
-    }
-
-    {
-      Gnuplot plt{};
-      
-      plt.redirect_to_png(png, "1200,800");
-
-      plt.set_title(title);
-      plt.set_xlabel("x");
-      plt.set_ylabel("y");
-      plt.set_xrange(xmin, xmax); 
-      
-      for (i = 0; i < coeff_table.size(); i++) {
-        plt.plot(xarr, ytable[i], to_string(coeff_table[i].type).data(), 
-                 Gnuplot::LineStyle::LINES);
-      }
-      plt.plot(x_, y_, "Data", Gnuplot::LineStyle::LINESPOINTS);
-      plt.show();
-    } // end plot 1 scope 
-
-    {
-      Gnuplot plt{};
-      
-      plt.redirect_to_png("log_"+png, "1200,800");
-
-      plt.set_title("LogLinear and NonLinear Fits on Logscale");
-      plt.set_xlabel("x");
-      plt.set_ylabel("y [logscale]");
-      plt.set_xrange(xmin, xmax);
-      plt.set_logscale(Gnuplot::AxisScale::LOGY);
-      
-      for (i = 0; i < coeff_table.size(); i++) {
-        // only plot loglinear approximations on logscale 
-        if ( coeff_table[i].type == LogLinear || coeff_table[i].type == NonLinear ) {
-          plt.plot(xarr, ytable[i], to_string(coeff_table[i].type).data(), 
-                   Gnuplot::LineStyle::LINES);
-        }
+      // only plot loglinear approximations on logscale 
+      if ( exponential ) {
+        logs.series.push_back({xarr, yarr, label}); 
       }
-      plt.plot(x_, y_, "Data", Gnuplot::LineStyle::LINESPOINTS);
-      plt.show();
+      fits.series.push_back({xarr, std::move(yarr), label});
+      errs.series.push_back({x_, std::move(err), label});
     }
 
-    {
-      Gnuplot plt{}; 
-      plt.redirect_to_png("errors_" + png, "1200,800");
-
-      plt.set_title("Log-Scale Error: " + title); 
-      plt.set_xlabel("x");
-      plt.set_ylabel("relative error [log-scale]");
-      plt.set_logscale(Gnuplot::AxisScale::LOGY);
-      plt.set_xrange(xmin, xmax); 
+    fits.series.push_back({x_, y_, "Data", Gnuplot::LineStyle::LINESPOINTS}); 
+    logs.series.push_back({x_, y_, "Data", Gnuplot::LineStyle::LINESPOINTS}); 
 
-      for (i = 0; i < err_table.size(); i++) {
-        plt.plot(x_, err_table[i], to_string(coeff_table[i].type).data(),
-                 Gnuplot::LineStyle::LINES);
-      }
-      plt.show(); 
-    } // end plot 3 scope 
+    auto& queue = RQ::instance(); 
+    queue.submit({png, size, "", {std::move(fits)}}); 
+    queue.submit({"log_" + png, size, "", {std::move(logs)}}); 
+    queue.submit({"errors_" + png, size, "", {std::move(errs)}}); 
   }
 
-  // returns errors for newtons and loglinear at x[0]
-  std::pair<std::vector<double>, std::vector<double>>  
-  compare()
+  /********** DataSet::nonlinear() ************************/
+  /*
+   * Fits y = b * e^{ax} by Levenberg-Marquardt, started concurrently from the 
+   * log linear coefficients and a spread of decay rates around it 
+   */ 
+  LevenbergMarquardt<2>::Result 
+  nonlinear() 
   {
-    auto ab0 = log_linear_(); 
-    double a = ab0[1], b = ab0[0];
-    size_t k = 0, m = x_.size(); 
-    double C[7]{0.0};
-
-    auto set_sums = [&](double a, double b) {
-      for (auto& c : C) {
-        c = 0.0; 
-      }
-
-      size_t i = 0;
-      for (i = 0; i < m; i++) {
-        double c = std::exp(a * x_[i]);
-        double c2 = c * c; 
-        C[0] += c2; 
-        C[1] += y_[i] * c; 
-        C[2] += x_[i] * c2; 
-        C[3] += x_[i] * y_[i] * c; 
-        C[4] += 2.0 * x_[i] * c2; 
-        C[5] += 2.0 * x_[i] * x_[i] * c2; 
-        C[6] += x_[i] * x_[i] * y_[i] * c; 
+    using LM = LevenbergMarquardt<2>; 
+
+    // p = {b, a}, f = b e^{ax}, J = [e^{ax}, b x e^{ax}] 
+    LM::Model model = [](const double* x, size_t n, const LM::Params& p, 
+                         double* f, double* J) {
+      size_t i = 0; 
+      for (i = 0; i < n; i++) {
+        f[i] = p[1] * x[i]; 
+      }
+      exp_kernel(f, n); 
+      for (i = 0; i < n; i++) {
+        J[2 * i]     = f[i]; 
+        J[2 * i + 1] = p[0] * x[i] * f[i]; 
+        f[i] *= p[0]; 
       }
     }; 
 
-    // iterate starting from log linear coefficients 10 iterations to check improvement
-    for (k = 0; k < 10; k++) {
-      set_sums(a, b);
-
-      // using closed for expression where b is solved for and substituted, making 
-      // this a 1d newtons instead of a 2d system 
-      b = C[1] / C[0];
-      double F  = ( C[1] * C[2] ) / C[0] - C[3];
-      double dF = ((C[3]*C[2] + C[1]*C[5] - (C[1]*C[2]/C[0])*C[4]) / C[0]) - C[6];
+    auto ab0 = log_linear_(); 
+    std::vector<LM::Params> starts = {
+      {ab0[0], ab0[1]}, {ab0[0], 0.5 * ab0[1]}, 
+      {ab0[0], 2.0 * ab0[1]}, {moments_.y0, ab0[1]}
+    }; 
 
-      a += -F / dF; 
+    if ( !streaming_ ) {
+      return LM(model, x_, y_, &pool_).solve(starts); 
     }
 
-    set_sums(a, b);
-    b = C[1] / C[0];
+    // out-of-core, replay the file in blocks on every evaluation 
+    LM::Source source = [this](const LM::Block& fn) {
+      double bx[LM::block], by[LM::block]; 
+      size_t n = 0; 
+      stream_([&](double x, double y) {
+        bx[n] = x; 
+        by[n] = y; 
+        if ( ++n == LM::block ) {
+          fn(bx, by, n); 
+          n = 0; 
+        }
+      });
+      if ( n > 0 ) {
+        fn(bx, by, n); 
+      }
+    }; 
+    return LM(model, source).solve(starts); 
+  }
 
-    auto yhat = evaluate_loglinear({b, a}, x_);
-    auto y    = evaluate_loglinear(log_linear_(), x_);
-    return {{b, a}, {std::abs(y_[0] - y[0]), std::abs(y_[0] - yhat[0])}};
+  // returns errors for nonlinear and loglinear at x[0]
+  std::pair<std::vector<double>, std::vector<double>>  
+  compare()
+  {
+    auto fit = nonlinear(); 
+    const double b = fit.p[0], a = fit.p[1]; 
+    const double x0 = moments_.x0, y0 = moments_.y0; 
+    auto ll = log_linear_(); 
+    const double yhat = b * std::exp(a * x0); 
+    const double y    = ll[0] * std::exp(ll[1] * x0); 
+    return {{b, a}, {std::abs(y0 - y), std::abs(y0 - yhat)}};
   }
 
   // getters 
   std::vector<double> x() const { return x_; }
   std::vector<double> y() const { return y_; }
-  double sum_x_sq() const { return xsq_; }
-  double sum_xy() const { return xy_; }
-  double sum_x() const { return sx_; }
-  double sum_y() const { return sy_; }
+  const Moments& moments() const { return moments_; }
+  const interp::Spline& spline() const { return spline_fit_; }
+  size_t size() const { return moments_.m; }
+  double sum_x_sq() const { return moments_.xp[2]; }
+  double sum_xy() const { return moments_.xyp[1]; }
+  double sum_x() const { return moments_.xp[1]; }
+  double sum_y() const { return moments_.xyp[0]; }
 
 private: 
+  static constexpr size_t chunk = size_t{4} << 20;  // 4 MiB read buffer 
+
   const char* path_; 
-  std::ifstream fptr_;
+  std::FILE* fptr_{nullptr};
+  bool streaming_{false}; 
+  std::vector<char> buffer_{}; 
   std::vector<double> x_{}; 
   std::vector<double> y_{}; 
-  double xsq_{0.0}, xy_{0.0}, sx_{0.0}, sy_{0.0}; 
+  Moments moments_{}; 
+  PolyFit poly_{};  // QR workspace, reused while the degree is unchanged 
+  ThreadPool pool_{};  // LM reductions over resident points 
+  interp::Spline spline_fit_{}; 
+
+  /********** DataSet::stream_() **************************/
+  /*
+   * Reads whitespace separated (x, y) pairs in fixed size chunks and hands 
+   * each pair to fn. A token split across a chunk boundary is carried into 
+   * the front of the next read. Replaces ifstream >> which was the hot spot 
+   */ 
+  template<typename Fn> 
+  void 
+  stream_(Fn&& fn) 
+  {
+    buffer_.resize(chunk); 
+    std::rewind(fptr_); 
+
+    char* buf = buffer_.data(); 
+    size_t carry = 0; 
+    double pair[2]{0.0}; 
+    int have = 0; 
+
+    while ( true ) {
+      const size_t got = std::fread(buf + carry, 1, chunk - carry, fptr_);
+      const bool eof = got < chunk - carry; 
+      const char* p = buf; 
+      const char* end = buf + carry + got; 
+      const char* stop = end; 
+
+      // only parse up to the last whitespace unless this is the final chunk 
+      if ( !eof ) {
+        while ( stop > p && !std::isspace(static_cast<unsigned char>(stop[-1])) ) {
+          stop--; 
+        }
+        // a full buffer with no delimiter would be carried forever 
+        if ( stop == p ) {
+          throw std::runtime_error("choked on invalid file, token longer than read buffer"); 
+        }
+      }
+
+      while ( true ) {
+        while ( p < stop && std::isspace(static_cast<unsigned char>(*p)) ) {
+          p++; 
+        }
+        if ( p >= stop ) {
+          break; 
+        }
+        if ( *p == '+' ) {
+          p++; 
+        }
+
+        auto [next, ec] = std::from_chars(p, stop, pair[have]); 
+        if ( ec != std::errc() ) {
+          throw std::runtime_error("malformed data point"); 
+        }
+        p = next; 
+
+        if ( ++have == 2 ) {
+          fn(pair[0], pair[1]); 
+          have = 0; 
+        }
+      }
+
+      if ( eof ) {
+        break; 
+      }
+      carry = end - stop; 
+      std::memmove(buf, stop, carry); 
+    }
+  }
+
+  // visits resident points, or streams them again when running out-of-core 
+  template<typename Fn> 
+  void 
+  for_each_point_(Fn&& fn) 
+  {
+    if ( streaming_ ) {
+      stream_(fn); 
+      return; 
+    }
+
+    for (size_t i = 0; i < x_.size(); i++) {
+      fn(x_[i], y_[i]); 
+    }
+  }
 
   /********** fit functions *******************************/
   /* wrapped over by exposed fit api */ 
@@ -297,80 +928,103 @@ private:
   linear_()
   {
     std::vector<double> coeff(2, 0);  
-    size_t m(x_.size());
+    const double m = moments_.m; 
+    const double xsq = sum_x_sq(), xy = sum_xy(), sx = sum_x(), sy = sum_y(); 
 
-    coeff[0] = ((xsq_ * sy_) - (xy_ * sx_)) / (m * xsq_ - sx_ * sx_);  
-    coeff[1] = ((m * xy_) - (sx_ * sy_)) / (m * xsq_ - sx_ * sx_); 
+    coeff[0] = ((xsq * sy) - (xy * sx)) / (m * xsq - sx * sx);  
+    coeff[1] = ((m * xy) - (sx * sy)) / (m * xsq - sx * sx); 
     return coeff; 
   }
 
   std::vector<double> 
   cubic_() 
   {
-    size_t m = x_.size(), i = 0, k = 0;
+    size_t i = 0, k = 0;
     std::vector<double> A(16, 0.0); 
     std::vector<double> b(4, 0.0);
 
-    double sums[7]  = {0.0}; 
-    double cross[4] = {0.0};
-    
-    // compute all sums into static arrays 
-    for (i = 0; i < m; i++) {
-      double x = x_[i], y = y_[i], sum = 1.0; 
-
-      sums[0]  += 1.0; 
-      cross[0] += y;
-
-      // compute exponential terms and crossing terms 
-      for (k = 1; k <= 6; k++) {
-        sum *= x; 
-        sums[k] += sum; 
-        if ( k <= 3 ) {
-          cross[k] += sum * y; 
-        }
-      }
-    }
-
-    // set value of A and cross terms  
+    // set value of A and cross terms from the accumulated moments 
     for (i = 0; i < 4; i++) {
       for (k = 0; k < 4; k++) {
-        A[i * 4 + k] = sums[i + k]; 
+        A[i * 4 + k] = moments_.xp[i + k]; 
       }
-      b[i] = cross[i];
+      b[i] = moments_.xyp[i];
     }
     
     int ipiv[4]; 
 
     // solve 4x4, 4x1 system of linear equations 
-    if ( LAPACKE_dgesv(LAPACK_ROW_MAJOR, 4, 1, A.data(), 4, ipiv, b.data(), 1) != 0 ) {
+    const auto solve = [&]() {
+      return LAPACKE_dgesv(LAPACK_ROW_MAJOR, 4, 1, A.data(), 4, ipiv, b.data(), 1); 
+    }; 
+    if ( lapack(solve) != 0 ) {
       std::cerr << "lapacke general solve failure\n";
       exit( 99 ); // constitutes major failure 
     }
     return b; // contains coefficients      
   }
 
+  // Chebyshev coefficients on poly_'s mapped x, evaluated by poly_.evaluate() 
+  std::vector<double> 
+  polynomial_(size_t degree) 
+  {
+    if ( streaming_ ) {
+      throw std::runtime_error("polynomial fit requires in-memory data");
+    }
+    if ( poly_.degree() != degree ) {
+      poly_ = PolyFit(degree); 
+    }
+    const std::vector<double>& c = poly_.solve(x_, y_); 
+    return {c.begin(), c.begin() + degree + 1}; 
+  }
+
+  // natural cubic spline through the points in x order, returns S'' at the knots 
+  std::vector<double> 
+  spline_() 
+  {
+    if ( streaming_ ) {
+      throw std::runtime_error("spline requires in-memory data");
+    }
+
+    std::vector<size_t> order(x_.size()); 
+    for (size_t i = 0; i < order.size(); i++) {
+      order[i] = i; 
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return x_[a] < x_[b]; }); 
+
+    // repeated abscissae become one knot at their mean y, knots must increase 
+    std::vector<double> xs, ys; 
+    xs.reserve(order.size()); 
+    ys.reserve(order.size()); 
+    for (size_t i = 0; i < order.size();) {
+      const double x = x_[order[i]]; 
+      double sum = 0.0; 
+      size_t j = i; 
+      for (; j < order.size() && x_[order[j]] == x; j++) {
+        sum += y_[order[j]]; 
+      }
+      xs.push_back(x); 
+      ys.push_back(sum / static_cast<double>(j - i)); 
+      i = j; 
+    }
+    spline_fit_.build(xs, ys); 
+    return spline_fit_.curvature(); 
+  }
+
   std::vector<double> 
   log_linear_()
   {
-    size_t m = x_.size(), i = 0;
-    std::vector<double> logy(y_.size(), 0.0);
     std::vector<double> coeff(2, 0);  
-    double sumx = 0.0, sxx = 0.0, sxy = 0.0, sumy = 0.0;  
 
-    // compute running sums, get coefficients
-    for (i = 0; i < m; i++) {
-      // if any value of y is negative assume malformed and throw exception 
-      if ( y_[i] <= 0.0 ) {
-        throw std::runtime_error("negative data point in log linear fit");
-      }
-      // take log of each element from y 
-      double x = x_[i], logy = std::log(y_[i]);
-      sumx += x; 
-      sumy += logy; 
-      sxx  += x * x; 
-      sxy  += x * logy; 
+    // if any value of y is negative assume malformed and throw exception 
+    if ( !moments_.positive ) {
+      throw std::runtime_error("negative data point in log linear fit");
     }
 
+    const double m = moments_.m; 
+    const double sumx = moments_.xp[1], sxx = moments_.xp[2]; 
+    const double sumy = moments_.logy, sxy = moments_.xlogy; 
+
     const double den = (m * sxx) - (sumx * sumx);
     coeff[0] = std::exp((sxx * sumy - sxy * sumx) / den); 
     coeff[1] = (m * sxy - sumx * sumy) / den;  
@@ -380,22 +1034,49 @@ private:
 
 int main(int argc, char* argv[]) {
 
-  if ( argc != 4 ) {
-    std::cerr << "invalid usage: ./approx [lab4-data.txt] [fit enum] [fit.png]\n";
+  bool streaming = false, valid = ( argc >= 4 ); 
+  size_t degree = 3; 
+  int i = 0; 
+
+  for (i = 4; i < argc; i++) {
+    if ( std::strcmp(argv[i], "--stream") == 0 ) {
+      streaming = true; 
+    } else if ( std::strcmp(argv[i], "--degree") == 0 && i + 1 < argc ) {
+      degree = std::stoul(argv[++i]); 
+    } else {
+      valid = false; 
+    }
+  }
+
+  if ( !valid ) {
+    std::cerr << "invalid usage: ./approx [lab4-data.txt] [fit enum] [fit.png] "
+              << "[--stream] [--degree k]\n";
     exit( 1 ); 
   }
 
   DataSet::FitType ft = static_cast<DataSet::FitType>(std::stoi(argv[2]));
-  DataSet ds(argv[1]);
+  DataSet ds(argv[1], streaming);
 
   ds.read();
 
-  std::vector<DataSet::FitCurve> coeff_table = ds.fit(ft);
+  std::vector<DataSet::FitCurve> coeff_table = ds.fit(ft, degree);
   auto [coeff, rel] = ds.compare();
   coeff_table.push_back({DataSet::FitType::NonLinear, coeff});
 
   std::cout << "LogLinear Error at x[0]: " << rel[0] << '\n'
-            << "Nonlinear Newton's at x[0]: " << rel[1] << '\n';
+            << "Nonlinear LM at x[0]: " << rel[1] << '\n';
+
+  // out-of-core runs report coefficients only, points were never resident 
+  if ( streaming ) {
+    for (auto& [type, c] : coeff_table) {
+      std::cout << DataSet::to_string(type) << ':';
+      for (auto& v : c) {
+        std::cout << ' ' << v; 
+      }
+      std::cout << '\n'; 
+    }
+    exit( 0 ); 
+  }
 
   std::string title = std::string(DataSet::to_string(ft));
   std::string png   = std::string(argv[3]);
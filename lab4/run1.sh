@@ -11,7 +11,7 @@ fi
 
 rm -f *.o approx *.png
 
-g++ -std=c++20 -O3 -I"${GPINC:-.}" approx.cpp -o approx \
+g++ -std=c++20 -O3 -march=native -pthread -I"${GPINC:-.}" approx.cpp -o approx \
   -llapacke -llapack -lblas -lm
 
 ./approx "$1" "$2" "$3" 
@@ -2,7 +2,7 @@
 
 rm -f washer *.o washer_*.png
 
-g++ -std=c++20 -O3 washer.cpp -o washer -llapacke -llapack -lopenblas -lm 
+g++ -std=c++20 -O3 -march=native -pthread washer.cpp -o washer -lm 
 
 ./washer 
 
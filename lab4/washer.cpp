@@ -2,395 +2,689 @@
  * washer.cpp  Andrew Belles  Oct 14th, 2025 
  *
  * Solution to washer problem on lab 4 
- *
+ * ./washer runs the lab design and plots, ./washer --sweep sweeps link lengths 
+ * ./washer --bench [step=...] [reps=n] times kinematics() of the lab design 
  *
  */ 
 
 #include <cmath> 
+#include <array> 
+#include <atomic> 
+#include <cstdint> 
+#include <cstring> 
 #include <vector> 
-#include <lapacke.h>
+#include <iostream> 
+#include <algorithm> 
+#include <fcntl.h> 
+#include <unistd.h> 
 #include <gplot++.h>
 
-typedef double (*f)(const double*, const double*, const double&);
-typedef void (*Jacobian)(const double*, double*, const double*);
+#include "../common/bench.hpp"
+#include "../common/dual.hpp"
+#include "../common/instrument.hpp"
+#include "../common/pool.hpp"
+#include "../common/render.hpp"
+#include "../common/stencil.hpp"
 
 constexpr size_t MAXITER = 500; 
 constexpr double TOL = 1e-9;
 constexpr double pi = M_PI;
 constexpr double offset = (149.0 * pi) / 180.0; 
 constexpr double stepsize = (1.0 * pi) / 180.0;
+constexpr size_t lanes = 4;  // crank angles per SIMD batch (AVX2 doubles) 
 
-double recontinuous(double x0, double x1);
-inline double wrap(double angle);
-double linkage_one(const double r[4], const double T[2], const double& t4);
-double linkage_two(const double r[4], const double T[2], const double& t4);
-void linkage_jacobian(const double r[4], double J[4], const double T[2]);
-double error(const double r[4], const std::vector<f>& funcs, 
-             const double T[2], const double t4);
-void update(const double J[4], double F[2], double X[2]);
-std::vector<double> newton_system(const double r[4], Jacobian junc, 
-                                  const std::vector<f>& funcs, const double X0[2], 
-                                  const double& t4);
-std::vector<double> forward_difference(const std::vector<double>& angles, double h);
-std::vector<double> centered_difference(const std::vector<double>& angles, double h);
-std::vector<double> second_centered(const std::vector<double>& angles, double h);
-std::vector<double> second_forward(const std::vector<double>& angles, double h);
-
-int main(void) 
-{
-  int i = 0; 
-  std::vector<std::vector<double>> first(361);
-  std::vector<std::vector<double>> second(361); 
+/************ fixed size newton's method *******************/
+/*
+ * Newton's method for an N x N nonlinear system with all state on the stack. 
+ * Everything is written over W lanes in structure-of-arrays form, X[i][l] is 
+ * component i of lane l, so a batch of independent systems iterates in 
+ * lockstep and the scalar solver is just W = 1. Converged lanes are masked 
+ * and hold their root while the rest keep iterating 
+ *
+ * Caller Provides: 
+ *   eval(P, X, F, J): residuals F and row-major Jacobian J at X for lane 
+ *   parameters P in a single call, so shared terms are computed once 
+ */ 
+template<size_t N> 
+struct NewtonSystem {
+  using Vec = std::array<double, N>; 
+
+  struct Result {
+    Vec x{}; 
+    size_t iterations{0}; 
+    bool converged{false}; 
+    bool singular{false}; 
+  };
+
+  /********** NewtonSystem::run() *************************/
+  template<size_t W, typename Eval> 
+  static size_t 
+  run(Eval&& eval, const double (&P)[W], double (&X)[N][W], Result (&res)[W]) 
+  {
+    double F[N][W], J[N * N][W], dX[N][W]; 
+    bool active[W]; 
+    size_t iter = 0, i = 0, l = 0; 
+    PROBE_TIME(Newton); 
 
-  std::vector<double> theta(361); 
-  std::vector<double> phi(361); 
-  std::vector<double> alpha(361);
-  std::vector<double> beta(361); 
+    for (l = 0; l < W; l++) {
+      res[l] = Result{}; 
+    }
 
-  std::vector<f> funcs(2);
-  double X[2] = {0.0, 1.5 * pi}, t = 0.0;
+    while ( true ) {
+      eval(P, X, F, J); 
+      PROBE_ADD(Jacobians, W); 
+
+      bool any = false; 
+      for (l = 0; l < W; l++) {
+        double sum = 0.0; 
+        for (i = 0; i < N; i++) {
+          sum += F[i][l] * F[i][l]; 
+        }
+        res[l].converged = std::sqrt(sum) <= TOL; 
+        active[l] = !res[l].converged && !res[l].singular && iter < MAXITER; 
+        any |= active[l]; 
+      }
+      if ( !any ) {
+        break; 
+      }
+
+      step_(J, F, dX, res); 
+      for (i = 0; i < N; i++) {
+        for (l = 0; l < W; l++) {
+          X[i][l] += active[l] ? dX[i][l] : 0.0; 
+        }
+      }
+
+      iter++; 
+      for (l = 0; l < W; l++) {
+        res[l].iterations += active[l]; 
+        PROBE_ADD(NewtonIterations, active[l]); 
+      }
+    }
 
-  funcs[0] = linkage_one;
-  funcs[1] = linkage_two;
+    for (l = 0; l < W; l++) {
+      for (i = 0; i < N; i++) {
+        res[l].x[i] = X[i][l]; 
+      }
+    }
+    return iter; 
+  }
 
-  // compute first linkage 
-  double r1[4] = {7.1, 2.36, 6.68, 1.94};
-  for (i = 1; i <= 360; i++) {
+  // scalar entry point 
+  template<typename Eval> 
+  static Result 
+  run(Eval&& eval, const double p, const Vec& x0) 
+  {
+    const double P[1] = {p}; 
+    double X[N][1]; 
+    Result res[1]; 
+    for (size_t i = 0; i < N; i++) {
+      X[i][0] = x0[i]; 
+    }
+    run(eval, P, X, res); 
+    return res[0]; 
+  }
+
+  /********** NewtonSystem::continuation() ****************/
+  /*
+   * Solves the system at every parameter p[k], with the root at p[k - 1] as 
+   * the guess for p[k]. The sweep is cut into W contiguous segments handled 
+   * in wavefronts: front k advances every segment one parameter in lockstep. 
+   * Segment seeds come from a scalar chain that hops every hop-th parameter, 
+   * so no guess is ever far enough away to jump to another branch 
+   */ 
+  template<size_t W, typename Eval> 
+  static std::vector<Result> 
+  continuation(Eval&& eval, const std::vector<double>& p, const Vec& x0, size_t hop = 4) 
+  {
+    const size_t n = p.size(), S = (n + W - 1) / W; 
+    std::vector<Result> out(n); 
+    double P[W], X[N][W]; 
+    Result res[W]; 
+    size_t i = 0, l = 0, k = 0; 
+
+    // seed chain, segment l starts at p[l * S] 
+    Result seed = run(eval, p[0], x0); 
+    size_t prev = 0; 
+    for (l = 0; l < W; l++) {
+      const size_t at = std::min(l * S, n - 1); 
+      for (k = prev + hop; k < at; k += hop) {
+        seed = run(eval, p[k], seed.x); 
+      }
+      if ( at != prev ) {
+        seed = run(eval, p[at], seed.x); 
+      }
+      prev = at; 
+
+      for (i = 0; i < N; i++) {
+        X[i][l] = seed.x[i]; 
+      }
+    }
+
+    // wavefronts, exhausted lanes re-solve their last point and sit converged 
+    for (k = 0; k < S; k++) {
+      for (l = 0; l < W; l++) {
+        P[l] = p[std::min(l * S + k, std::min(n, (l + 1) * S) - 1)]; 
+      }
+      run(eval, P, X, res); 
+      for (l = 0; l < W; l++) {
+        if ( l * S + k < std::min(n, (l + 1) * S) ) {
+          out[l * S + k] = res[l]; 
+        }
+      }
+    }
+    return out; 
+  }
 
-    t = (static_cast<double>(i) * stepsize) + pi;
-    first[i] = newton_system(r1, linkage_jacobian, funcs, X, t);
-    X[0] = first[i][0];
-    X[1] = first[i][1];
+private: 
+  /*
+   * Newton step dX = -J^{-1} F per lane. Closed form (Cramer) for N = 2 which 
+   * vectorizes across lanes, compile time unrolled elimination otherwise 
+   */ 
+  template<size_t W> 
+  static void 
+  step_(const double (&J)[N * N][W], const double (&F)[N][W], double (&dX)[N][W], 
+        Result (&res)[W]) 
+  {
+    size_t i = 0, j = 0, c = 0, l = 0; 
+
+    if constexpr ( N == 2 ) {
+      for (l = 0; l < W; l++) {
+        const double det = J[0][l] * J[3][l] - J[1][l] * J[2][l]; 
+        const double inv = 1.0 / det; 
+        dX[0][l] = -( J[3][l] * F[0][l] - J[1][l] * F[1][l]) * inv; 
+        dX[1][l] = -(-J[2][l] * F[0][l] + J[0][l] * F[1][l]) * inv; 
+        res[l].singular |= (det == 0.0); 
+      }
+      return; 
+    }
 
-    theta[i] = t - pi;
-    phi[i] = first[i][0];
-    alpha[i] = phi[i] + offset;
+    for (l = 0; l < W; l++) {
+      double A[N][N], b[N]; 
+      for (i = 0; i < N; i++) {
+        b[i] = -F[i][l]; 
+        for (j = 0; j < N; j++) {
+          A[i][j] = J[i * N + j][l]; 
+        }
+      }
+
+      // partial pivoting elimination, bounds are compile time constants 
+      for (c = 0; c < N; c++) {
+        size_t piv = c; 
+        for (i = c + 1; i < N; i++) {
+          if ( std::abs(A[i][c]) > std::abs(A[piv][c]) ) {
+            piv = i; 
+          }
+        }
+        if ( A[piv][c] == 0.0 ) {
+          res[l].singular = true; 
+          break; 
+        }
+        std::swap(A[c], A[piv]); 
+        std::swap(b[c], b[piv]); 
+        for (i = c + 1; i < N; i++) {
+          const double m = A[i][c] / A[c][c]; 
+          for (j = c; j < N; j++) {
+            A[i][j] -= m * A[c][j]; 
+          }
+          b[i] -= m * b[c]; 
+        }
+      }
+
+      for (i = N; i-- > 0; ) {
+        double sum = b[i]; 
+        for (j = i + 1; j < N; j++) {
+          sum -= A[i][j] * dX[j][l]; 
+        }
+        dX[i][l] = res[l].singular ? 0.0 : sum / A[i][i]; 
+      }
+    }
   }
+};
 
-  X[0] = first.back()[0];
-  X[1] = first.back()[1];
-  first[0] = newton_system(r1, linkage_jacobian, funcs, X, pi);
-  phi[0] = first[0][0];
-  alpha[0] = first[0][0] + offset;
-  theta[0] = 0.0;
+/*
+ * Unwrapped linkage angles over one crank revolution for a single design, 
+ * plus beta's centered angular velocity and acceleration at 550 rpm 
+ */ 
+struct Kinematics {
+  std::vector<double> theta, phi, alpha, beta; 
+  std::vector<double> beta_dt, beta_d2t; 
+  size_t iterations{0}; 
+  bool singular{false}; 
+};
 
-  // solve for second system 
-  double r2[4] = {1.23, 1.26, 1.82, 2.35}; 
-  X[0] = 0.0; 
-  X[1] = 1.5 * pi;
-  for (i = 0; i < 361; i++) {
-    auto a = alpha[i];
-    auto v = newton_system(r2, linkage_jacobian, funcs, X, a + pi);
-    second[i] = v;
-
-    // update initial guess; 
-    X[0] = v[0];
-    X[1] = v[1];
-
-    beta[i] = v[0];
+constexpr double rpm = 550.0 / 60.0; 
+
+double recontinuous(double x0, double x1);
+inline double wrap(double angle);
+template<size_t W> 
+inline void linkage(const double r[4], const double (&t4)[W], const double (&T)[2][W], 
+                    double (&F)[2][W], double (&J)[4][W]);
+Kinematics kinematics(const double r1[4], const double r2[4], const double step); 
+int sweep(int argc, char* argv[]); 
+int benchmark(int argc, char* argv[]); 
+
+int main(int argc, char* argv[]) 
+{
+  if ( argc > 1 && std::strcmp(argv[1], "--bench") == 0 ) {
+    return benchmark(argc, argv); 
   }
+  if ( argc > 1 ) {
+    return sweep(argc, argv); 
+  }
+
+  size_t i = 0; 
+  const double r1[4] = {7.1, 2.36, 6.68, 1.94};
+  const double r2[4] = {1.23, 1.26, 1.82, 2.35}; 
 
-  // forward differences 
-  auto delta_phi_forward   = forward_difference(phi, stepsize);
-  auto delta_alpha_forward = forward_difference(alpha, stepsize); 
-  auto delta_beta_forward  = forward_difference(beta, stepsize);
-
-  // centered differences
-  auto delta_phi_center   = centered_difference(phi, stepsize);
-  auto delta_alpha_center = centered_difference(alpha, stepsize); 
-  auto delta_beta_center  = centered_difference(beta, stepsize);
-  auto d2beta_f = forward_difference(delta_beta_center, stepsize);
-  auto d2beta_c = centered_difference(delta_beta_center, stepsize);
-
-  std::vector<double> c_beta_dt(361), c_beta_d2t(361), f_beta_dt(361), f_beta_d2t(361);
-  for (i = 0; i < 361; i++) {
-    c_beta_dt[i] = (550.0 / 60.0) * delta_beta_center[i];
-    c_beta_d2t[i] = (550.0 / 60.0) * (550.0 / 60.0) * d2beta_c[i];
-    f_beta_dt[i] = (550.0 / 60.0) * delta_beta_forward[i];
-    f_beta_d2t[i] = (550.0 / 60.0) * (550.0 / 60.0) * d2beta_f[i];
+  auto K = kinematics(r1, r2, stepsize); 
+  if ( K.singular ) {
+    std::cerr << "singular point\n";
+    exit( 99 ); 
   }
 
+  const size_t n = K.theta.size(); 
+  const auto& theta = K.theta; 
+  std::vector<double> phi = K.phi, alpha = K.alpha, beta = K.beta; 
+
+  // first order forward and second order centered stencils, each signal is 
+  // read once for both schemes and beta's are scaled to the motor speed inline 
+  using stencil::Derivative, stencil::Kind; 
+  const Derivative forward(1, 1, Kind::Forward), centered(1, 2, Kind::Centered); 
+  const Derivative forward2(2, 1, Kind::Forward); 
+
+  std::vector<double> delta_phi_forward(n), delta_phi_center(n); 
+  std::vector<double> delta_alpha_forward(n), delta_alpha_center(n); 
+  std::vector<double> f_beta_dt(n), f_beta_d2t(n); 
+  stencil::fused(forward, centered, phi, stepsize, delta_phi_forward, delta_phi_center); 
+  stencil::fused(forward, centered, alpha, stepsize, delta_alpha_forward, delta_alpha_center); 
+  stencil::fused(forward, forward2, beta, stepsize, f_beta_dt, f_beta_d2t, rpm, rpm * rpm); 
+
+  const auto& c_beta_dt = K.beta_dt, c_beta_d2t = K.beta_d2t; 
+
   // wrap values within half-open interval [0, 2pi)
-  for (i = 0; i < 361; i++) {
+  for (i = 0; i < n; i++) {
     phi[i] = wrap(phi[i]);
     alpha[i] = wrap(alpha[i]);
     beta[i] = wrap(beta[i]);
   }
 
-  std::vector<double> dt_diff(361), d2t_diff(361); 
-  std::vector<double> phi_diff(361);
-  for (i = 0; i < 361; i++) {
+  std::vector<double> dt_diff(n), d2t_diff(n); 
+  std::vector<double> phi_diff(n);
+  for (i = 0; i < n; i++) {
     phi_diff[i] = std::abs(delta_phi_center[i] - delta_phi_forward[i]);
     dt_diff[i] = std::abs(c_beta_dt[i] - f_beta_dt[i]); 
     d2t_diff[i] = std::abs(c_beta_d2t[i] - f_beta_d2t[i]); 
   }
 
-  // scoped plots
-  {
-    Gnuplot plt{};
-    plt.redirect_to_png("washer_angles.png", "1200,800");
-    plt.set_title("Washer Angles: Phi, Alpha, and Beta");
-    plt.set_xlabel("Theta [rads]");
-    
-    // plot angles 
-    plt.set_title("Angles: phi, alpha, beta");
-    plt.set_ylabel("Angle [rads]");
-    plt.set_xrange(0.0, 2.0 * pi);
-    plt.plot(theta, phi, "phi", Gnuplot::LineStyle::LINES);
-    plt.plot(theta, alpha, "alpha", Gnuplot::LineStyle::LINES);
-    plt.plot(theta, beta, "beta", Gnuplot::LineStyle::LINES);
-    plt.show(); 
-  } 
-
-  {
-    Gnuplot plt{};
-    plt.redirect_to_png("washer_derivatives.png", "1200,800");
-    plt.set_title("Phi Derivatives (Forward and Centered)");
-    plt.set_xlabel("Theta [rads]");
-    plt.set_ylabel("Change in Angle");
-    plt.set_xrange(0.0, 2.0 * pi);
-    plt.plot(theta, delta_phi_forward, "forward", Gnuplot::LineStyle::LINES);
-    plt.plot(theta, delta_phi_center, "centered", Gnuplot::LineStyle::LINES);
-    plt.show();
-  }
-
-  {
-    Gnuplot plt{};
-    plt.redirect_to_png("washer_angular.png", "1200,800");
-    plt.multiplot(1,2, "Beta Angular Velocity and Acceleration");
-
-    // plot beta's derivatives/kinematics 
-    plt.set_xrange(0.0, 2.0 * pi);
-    plt.set_xlabel("Theta [rads]");
-    plt.set_ylabel("Angular Velocity [rads/sec]");
-    plt.plot(theta, f_beta_dt, "forward", Gnuplot::LineStyle::LINES);
-    plt.plot(theta, c_beta_dt, "centered", Gnuplot::LineStyle::LINES);
-    plt.show(); 
-
-    plt.set_xrange(0.0, 2.0 * pi);
-    plt.set_ylabel("Angular Acceleration [rads/sec^2]");
-    plt.plot(theta, f_beta_d2t, "forward", Gnuplot::LineStyle::LINES);
-    plt.plot(theta, c_beta_d2t, "centered", Gnuplot::LineStyle::LINES);
-    plt.show(); 
-  }
-
-  {
-    Gnuplot plt{};
-
-    plt.redirect_to_png("washer_phi_differences.png", "1200,800");
-    plt.set_logscale(Gnuplot::AxisScale::LOGY);
-
-    plt.set_xrange(0.0, 2.0 * pi); 
-    plt.set_xlabel("Theta [rads]");
-    plt.set_ylabel("First Derivative of Phi Difference [log]");
-    plt.plot(theta, phi_diff, "diff", Gnuplot::LineStyle::LINES);
-    plt.show(); 
-  }
+  // figures are rendered on the background queue while main returns 
+  using RQ = RenderQueue; 
+  auto& queue = RQ::instance(); 
+  const std::pair<double, double> full{0.0, 2.0 * pi}; 
+  
+  // plot angles 
+  queue.submit({"washer_angles.png", "1200,800", "", {
+    RQ::Panel{"Angles: phi, alpha, beta", "Theta [rads]", "Angle [rads]", full, {}, 
+              RQ::Scale::Linear, {
+      {theta, phi, "phi"}, {theta, alpha, "alpha"}, {theta, beta, "beta"}
+    }}
+  }});
+
+  queue.submit({"washer_derivatives.png", "1200,800", "", {
+    RQ::Panel{"Phi Derivatives (Forward and Centered)", "Theta [rads]", 
+              "Change in Angle", full, {}, RQ::Scale::Linear, {
+      {theta, delta_phi_forward, "forward"}, {theta, delta_phi_center, "centered"}
+    }}
+  }});
+
+  // plot beta's derivatives/kinematics 
+  queue.submit({"washer_angular.png", "1200,800", "Beta Angular Velocity and Acceleration", {
+    RQ::Panel{"", "Theta [rads]", "Angular Velocity [rads/sec]", full, {}, 
+              RQ::Scale::Linear, {
+      {theta, f_beta_dt, "forward"}, {theta, c_beta_dt, "centered"}
+    }},
+    RQ::Panel{"", "", "Angular Acceleration [rads/sec^2]", full, {}, 
+              RQ::Scale::Linear, {
+      {theta, f_beta_d2t, "forward"}, {theta, c_beta_d2t, "centered"}
+    }}
+  }});
+
+  queue.submit({"washer_phi_differences.png", "1200,800", "", {
+    RQ::Panel{"", "Theta [rads]", "First Derivative of Phi Difference [log]", full, {}, 
+              RQ::Scale::LogY, {{theta, phi_diff, "diff"}}}
+  }});
 
   // differnece plots 
-  {
-    Gnuplot plt{};
-    plt.redirect_to_png("washer_beta_differences.png", "1200,800");
-    plt.multiplot(1,2, "Differences in forward and centered approximations");
-    plt.set_logscale(Gnuplot::AxisScale::LOGY);
-
-    plt.set_xrange(0.0, 2.0 * pi); 
-    plt.set_xlabel("Theta [rads]");
-
-    plt.set_ylabel("First Derivative of Beta Difference [log]"); 
-    plt.plot(theta, dt_diff, "diff", Gnuplot::LineStyle::LINES);    
-    plt.show(); 
-
-    plt.set_ylabel("Second Derivative of Beta Difference [log]"); 
-    plt.plot(theta, d2t_diff, "diff", Gnuplot::LineStyle::LINES);    
-    plt.show(); 
-  }
+  queue.submit({"washer_beta_differences.png", "1200,800", 
+                "Differences in forward and centered approximations", {
+    RQ::Panel{"", "Theta [rads]", "First Derivative of Beta Difference [log]", full, {}, 
+              RQ::Scale::LogY, {{theta, dt_diff, "diff"}}},
+    RQ::Panel{"", "", "Second Derivative of Beta Difference [log]", full, {}, 
+              RQ::Scale::LogY, {{theta, d2t_diff, "diff"}}}
+  }});
 
   return 0; 
 }
 
-// helper function to renormalize angles back to same [0, 2pi) to avoid discts vals
-double 
-recontinuous(double x0, double x1)
+/************ kinematics of one design *******************/
+/*
+ * Solves both loops of the linkage over a full crank revolution at the given 
+ * angular step. Each loop is one continuation chain on the calling thread 
+ */ 
+Kinematics 
+kinematics(const double r1[4], const double r2[4], const double step)
 {
-  double diff = x1 - x0; 
-  if ( diff > pi ) {
-    x1 -= 2.0 * pi; 
-  } else if ( diff < -pi ) {
-    x1 += 2.0 * pi; 
-  }
-  return x1; 
-}
+  using Newton = NewtonSystem<2>; 
+  const size_t n = static_cast<size_t>(std::round(2.0 * pi / step)); 
+  size_t i = 0; 
+  Kinematics K; 
 
-inline double 
-wrap(double angle) 
-{
-  angle = std::fmod(angle, 2.0 * pi);
-  if ( angle < 0 ) {
-    angle += 2.0 * pi; 
+  K.theta.resize(n + 1); 
+  K.phi.resize(n + 1); 
+  K.alpha.resize(n + 1); 
+  K.beta.resize(n + 1); 
+
+  auto tally = [&K](const Newton::Result& s) {
+    K.iterations += s.iterations; 
+    K.singular |= s.singular; 
+  };
+
+  // compute first linkage 
+  auto first_eval = [&](const auto& P, const auto& T, auto& F, auto& J) {
+    linkage(r1, P, T, F, J); 
+  };
+
+  std::vector<double> t(n); 
+  for (i = 1; i <= n; i++) {
+    t[i - 1] = (static_cast<double>(i) * step) + pi;
   }
-  return angle; 
-}
 
-/************ functions to optimize by newtons *************/
+  auto first = Newton::continuation<lanes>(first_eval, t, {0.0, 1.5 * pi}); 
+  for (i = 1; i <= n; i++) {
+    tally(first[i - 1]); 
+    K.theta[i] = t[i - 1] - pi;
+    K.phi[i] = first[i - 1].x[0];
+    K.alpha[i] = K.phi[i] + offset;
+  }
 
-double 
-linkage_one(const double r[4], const double T[2], const double& t4)
-{
-  return r[1] * std::cos(T[0]) + r[2] * std::cos(T[1]) + 
-         r[3] * std::cos(t4) - r[0];
-}
+  auto first0 = Newton::run(first_eval, pi, first.back().x);
+  tally(first0); 
+  K.phi[0] = first0.x[0];
+  K.alpha[0] = first0.x[0] + offset;
+  K.theta[0] = 0.0;
 
-double 
-linkage_two(const double r[4], const double T[2], const double& t4)
-{
-  return r[1] * std::sin(T[0]) + r[2] * std::sin(T[1]) + 
-         r[3] * std::sin(t4);
-}
+  // solve for second system 
+  auto second_eval = [&](const auto& P, const auto& T, auto& F, auto& J) {
+    linkage(r2, P, T, F, J); 
+  };
 
-// raw ptr to 2x2 (flattened) array of jacobian 
-void 
-linkage_jacobian(const double r[4], double J[4], const double T[2])
-{
-  J[0] = -r[1] * std::sin(T[0]); 
-  J[1] = -r[2] * std::sin(T[1]);
-  J[2] = r[1] * std::cos(T[0]);
-  J[3] = r[2] * std::cos(T[1]);
-}
+  std::vector<double> a(n + 1); 
+  for (i = 0; i <= n; i++) {
+    a[i] = K.alpha[i] + pi; 
+  }
 
-double 
-error(const double r[4], const std::vector<f>& funcs, 
-      const double T[2], const double t4)
-{
-  size_t i = 0, n = funcs.size();  
-  double v = 0.0, sum = 0.0; 
-  for (auto& fn : funcs) {
-    v = fn(r, T, t4); 
-    sum += v * v;
+  auto second = Newton::continuation<lanes>(second_eval, a, {0.0, 1.5 * pi}); 
+  for (i = 0; i <= n; i++) {
+    tally(second[i]); 
+    K.beta[i] = second[i].x[0];
   }
-  return std::sqrt(sum);
-} 
 
-void 
-update(const double J[4], double F[2], double X[2])
-{
-  X[0] = X[0] - J[0] * F[0] + J[1] * F[1];
-  X[1] = X[1] - J[2] * F[0] + J[3] * F[1]; 
+  // centered kinematics of beta at the motor speed in one pass 
+  static const stencil::Derivative velocity(1, 2), acceleration(2, 2); 
+  K.beta_dt.resize(n + 1); 
+  K.beta_d2t.resize(n + 1); 
+  stencil::fused(velocity, acceleration, K.beta, step, K.beta_dt, K.beta_d2t, 
+                 rpm, rpm * rpm); 
+  return K; 
 }
 
-/************ newton's method *****************************/ 
+/************ design space sweep **************************/
 /*
- * Defines a generic newton's method for a nonlinear system of linkage equations 
- * that takes some t0 (theta 4) and initial guesses \vec{x0} (theta 2 and 3) and 
- * computes the exact roots of the linkage system 
+ * ./washer --sweep out.bin [--step deg] [--link k lo hi count]... 
  *
- * Caller Provides: 
- *   x0: initial guesses for roots 
- *   t0: set value of theta 4 
- *   junc: function for jacobian
- *   funcs: vector of linkage equations
+ * Sweeps the cartesian product of link length ranges (k = 0..3 are r1, 
+ * 4..7 are r2, unswept links keep the lab values). Designs are independent 
+ * and spread over the work stealing pool, each loop's continuation chain 
+ * stays on one thread. Output is columnar little-endian binary: 
+ *
+ *   SweepHeader 
+ *   double links[configs][8] 
+ *   double column[5][configs][samples]  (phi, alpha, beta, beta', beta'') 
+ *
+ * so one trace of one design, or one column across every design, is a 
+ * single contiguous read. Summary statistics are printed to stdout 
  */ 
-std::vector<double> 
-newton_system(const double r[4], Jacobian junc, const std::vector<f>& funcs, 
-              const double X0[2], const double& t4)
+struct SweepHeader {
+  char magic[8]{'W', 'A', 'S', 'H', 'E', 'R', '0', '1'}; 
+  uint64_t configs{0}, samples{0}, columns{5}; 
+  double step{0.0}; 
+};
+
+struct SweepRange {
+  size_t link{0}; 
+  double lo{0.0}, hi{0.0}; 
+  size_t count{1}; 
+};
+
+int 
+sweep(int argc, char* argv[])
 {
-  double J[4] = {0.0}, eps = error(r, funcs, X0, t4);
-  double X[2] = {X0[0], X0[1]}, F[2] = {0.0}; 
-  std::vector<double> x(2); 
-  size_t iter = 0, i = 0, n = funcs.size(); 
+  if ( argc < 3 || std::strcmp(argv[1], "--sweep") != 0 ) {
+    std::cerr << "invalid usage: ./washer [--sweep out.bin [--step deg] "
+              << "[--link k lo hi count]...]\n";
+    return 1; 
+  }
 
-  while ( iter < MAXITER && eps > TOL ) {
+  const char* path = argv[2]; 
+  double step = stepsize; 
+  std::vector<SweepRange> ranges; 
+  int i = 0; 
 
-    // evaluate for iteration 
-    junc(r, J, X);
-    for (i = 0; i < n; i++) {
-      F[i] = funcs[i](r, X, t4);
+  for (i = 3; i < argc; i++) {
+    if ( std::strcmp(argv[i], "--step") == 0 && i + 1 < argc ) {
+      step = std::stod(argv[++i]) * pi / 180.0; 
+    } else if ( std::strcmp(argv[i], "--link") == 0 && i + 4 < argc ) {
+      SweepRange r{std::stoul(argv[i + 1]), std::stod(argv[i + 2]), 
+                   std::stod(argv[i + 3]), std::stoul(argv[i + 4])}; 
+      if ( r.link > 7 || r.count == 0 ) {
+        std::cerr << "link index must be 0..7 with count > 0\n"; 
+        return 1; 
+      }
+      ranges.push_back(r); 
+      i += 4; 
+    } else {
+      std::cerr << "unknown sweep argument: " << argv[i] << '\n'; 
+      return 1; 
     }
+  }
 
-    // compute offset to next term 
-    int ipiv[2]; 
-    double dX[2] = { -F[0], -F[1] };
-    int info = LAPACKE_dgesv(LAPACK_ROW_MAJOR, 2, 1, J, 2, ipiv, dX, 1);
-    if ( info != 0 ) {
-      std::cerr << "singular point\n";
-      exit( 99 ); 
+  // expand the cartesian product of every range over the lab design 
+  std::vector<std::array<double, 8>> designs{{7.1, 2.36, 6.68, 1.94, 1.23, 1.26, 1.82, 2.35}}; 
+  for (auto& r : ranges) {
+    std::vector<std::array<double, 8>> next; 
+    next.reserve(designs.size() * r.count); 
+    for (auto& d : designs) {
+      for (size_t k = 0; k < r.count; k++) {
+        auto e = d; 
+        e[r.link] = ( r.count == 1 ) 
+          ? r.lo : r.lo + (r.hi - r.lo) * static_cast<double>(k) / (r.count - 1); 
+        next.push_back(e); 
+      }
     }
+    designs = std::move(next); 
+  }
 
-    X[0] += dX[0];
-    X[1] += dX[1];
+  SweepHeader header; 
+  header.configs = designs.size(); 
+  header.samples = static_cast<uint64_t>(std::round(2.0 * pi / step)) + 1; 
+  header.step = step; 
 
-    eps = error(r, funcs, X, t4);
-    iter++; 
+  const int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644); 
+  if ( fd < 0 ) {
+    std::cerr << "choked opening " << path << '\n'; 
+    return 2; 
   }
 
-  x[0] = X[0];
-  x[1] = X[1];
-  return x; 
-}
-
-std::vector<double> 
-forward_difference(const std::vector<double>& angles, double h)
-{
-  size_t i = 0, n = angles.size(); 
-  std::vector<double> derivative(n);
+  const size_t trace = header.samples * sizeof(double); 
+  const off_t links_at = sizeof(SweepHeader); 
+  const off_t columns_at = links_at + designs.size() * sizeof(designs[0]); 
+  bool io_ok = pwrite(fd, &header, sizeof(header), 0) == sizeof(header); 
+  io_ok &= pwrite(fd, designs.data(), designs.size() * sizeof(designs[0]), links_at) 
+        == static_cast<ssize_t>(designs.size() * sizeof(designs[0])); 
+
+  struct Summary {
+    double peak_dt{0.0}, peak_d2t{0.0}, beta_swing{0.0}; 
+    size_t iterations{0}; 
+    bool singular{false}; 
+  }; 
+  std::vector<Summary> summary(designs.size()); 
+  std::atomic<bool> write_ok{io_ok}; 
+
+  ThreadPool pool; 
+  pool.parallel_for(designs.size(), [&](size_t k) {
+    const auto& d = designs[k]; 
+    auto K = kinematics(d.data(), d.data() + 4, step); 
+    const std::vector<double>* cols[5] = {&K.phi, &K.alpha, &K.beta, &K.beta_dt, &K.beta_d2t}; 
+
+    for (size_t c = 0; c < 5; c++) {
+      const off_t at = columns_at + (c * designs.size() + k) * trace; 
+      if ( pwrite(fd, cols[c]->data(), trace, at) != static_cast<ssize_t>(trace) ) {
+        write_ok = false; 
+      }
+    }
 
-  // compute all forward difference but right boundary 
-  for (i = 0; i < n - 1; i++) {
-    derivative[i] = (angles[i + 1] - angles[i]) / h;  
+    Summary& s = summary[k]; 
+    auto [bmin, bmax] = std::minmax_element(K.beta.begin(), K.beta.end()); 
+    s.beta_swing = *bmax - *bmin; 
+    for (size_t j = 0; j < K.beta.size(); j++) {
+      s.peak_dt  = std::max(s.peak_dt, std::abs(K.beta_dt[j])); 
+      s.peak_d2t = std::max(s.peak_d2t, std::abs(K.beta_d2t[j])); 
+    }
+    s.iterations = K.iterations; 
+    s.singular = K.singular; 
+  });
+  close(fd); 
+
+  if ( !write_ok ) {
+    std::cerr << "short write to " << path << '\n'; 
+    return 2; 
   }
 
-  derivative[n - 1] = (-angles[n - 2] + angles[n - 1]) / h; 
+  // one row per design, then the design with the gentlest beta acceleration 
+  size_t best = designs.size(); 
+  std::cout << "design r1[0..3] r2[0..3] peak_beta_dt peak_beta_d2t beta_swing newton_iters\n"; 
+  for (size_t k = 0; k < designs.size(); k++) {
+    const auto& s = summary[k]; 
+    std::cout << k; 
+    for (auto& v : designs[k]) {
+      std::cout << ' ' << v; 
+    }
+    if ( s.singular ) {
+      std::cout << " singular\n"; 
+      continue; 
+    }
+    std::cout << ' ' << s.peak_dt << ' ' << s.peak_d2t << ' ' << s.beta_swing 
+              << ' ' << s.iterations << '\n'; 
+    if ( best == designs.size() || s.peak_d2t < summary[best].peak_d2t ) {
+      best = k; 
+    }
+  }
 
-  return derivative;
+  if ( best < designs.size() ) {
+    std::cout << "lowest peak beta acceleration: design " << best << " at " 
+              << summary[best].peak_d2t << " rads/sec^2\n"; 
+  }
+  return 0; 
 }
 
-std::vector<double> 
-centered_difference(const std::vector<double>& angles, double h)
+/************ benchmark **********************************/
+/*
+ * ./washer --bench [step=1,0.25,0.0625] [reps=5] 
+ * Both continuation chains of the lab design at each crank step (degrees). 
+ * A step is one crank angle solved, evals are Newton iterations, each one 
+ * residual and Jacobian evaluation 
+ */ 
+int 
+benchmark(int argc, char* argv[])
 {
-  size_t i = 0, n = angles.size(); 
-  std::vector<double> derivative(n);
-
-  // use more precise forward and backward differences for left and right bounds 
-  derivative[0] = (-3.0*angles[0] + 4.0*angles[1] - angles[2]) / (2.0*h);
-  derivative[n-1] = (angles[n-3] - 4.0*angles[n-2] + 3.0*angles[n-1]) / (2.0*h); 
-
-  // compute all centered differences except at boundaries 
-  for (i = 1; i < n - 1; i++) {
-    derivative[i] = (-angles[i - 1] + angles[i + 1]) / (2.0 * h);
+  const double r1[4] = {7.1, 2.36, 6.68, 1.94};
+  const double r2[4] = {1.23, 1.26, 1.82, 2.35}; 
+
+  try {
+    const bench::Args args(argc, argv); 
+    args.allow({"step", "reps"}); 
+    const size_t reps = static_cast<size_t>(args.get("reps", 5)); 
+
+    for (double deg : args.list("step", {1.0, 0.25, 0.0625})) {
+      const double step = deg * pi / 180.0; 
+      bench::emit(bench::measure("washer_kinematics", {{"step", deg}}, reps, [&]() {
+        const auto K = kinematics(r1, r2, step); 
+        return bench::Work{2 * K.theta.size(), K.iterations}; 
+      })); 
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "invalid usage: ./washer --bench [step=deg,...] [reps=n]: " << e.what() << '\n'; 
+    return 1; 
   }
-  return derivative;
+  return 0; 
 }
 
-std::vector<double> 
-second_centered(const std::vector<double>& angles, double h)
+// helper function to renormalize angles back to same [0, 2pi) to avoid discts vals
+double 
+recontinuous(double x0, double x1)
 {
-  size_t i = 0, n = angles.size(); 
-  std::vector<double> derivative(n);
-
-  derivative[0] = (2.0*angles[0] - 5.0*angles[1] + 4.0*angles[2] - angles[3]);
-  derivative[0] /= (h * h);
-
-  derivative[n-1] = (2.0*angles[n-1] - 5.0*angles[n-2] + 4.0*angles[n-3] - angles[n-4]);
-  derivative[n-1] /= (h * h);
+  double diff = x1 - x0; 
+  if ( diff > pi ) {
+    x1 -= 2.0 * pi; 
+  } else if ( diff < -pi ) {
+    x1 += 2.0 * pi; 
+  }
+  return x1; 
+}
 
-  for (i = 1; i < n - 1; i++) {
-    derivative[i] = (angles[i - 1] - 2.0 * angles[i] + angles[i + 1]) / (h * h);
+inline double 
+wrap(double angle) 
+{
+  angle = std::fmod(angle, 2.0 * pi);
+  if ( angle < 0 ) {
+    angle += 2.0 * pi; 
   }
-  return derivative; 
+  return angle; 
 }
 
-std::vector<double> 
-second_forward(const std::vector<double>& angles, double h)
+/************ functions to optimize by newtons *************/
+/*
+ * Loop closure of one linkage at crank angle t4, written once over the 
+ * scalar type: doubles give the residual, ad::Dual<2> its Jacobian too 
+ */ 
+template<typename T> 
+inline std::array<T, 2> 
+closure(const double r[4], const double t4, const std::array<T, 2>& theta)
 {
-  size_t i = 0, n = angles.size(); 
-  std::vector<double> derivative(n);
+  using std::cos, std::sin; 
+  return {r[1] * cos(theta[0]) + r[2] * cos(theta[1]) + r[3] * std::cos(t4) - r[0], 
+          r[1] * sin(theta[0]) + r[2] * sin(theta[1]) + r[3] * std::sin(t4)}; 
+}
 
-  // backwards at right bound
-  derivative[n-1] = (angles[n-1] - 2.0*angles[n-2] + angles[n-3]) / (h * h);
-  derivative[n-2] = (angles[n-2] - 2.0*angles[n-3] + angles[n-4]) / (h * h);
-  
-  for (i = 0; i < n - 2; i++) {
-    derivative[i] = (angles[i] - 2.0*angles[i+1] + angles[i+2]) / (h * h); 
+/*
+ * Linkage residuals and their Jacobian for W crank angles at once, both 
+ * from one forward mode evaluation of closure() per lane 
+ */ 
+template<size_t W> 
+inline void 
+linkage(const double r[4], const double (&t4)[W], const double (&T)[2][W], 
+        double (&F)[2][W], double (&J)[4][W])
+{
+  for (size_t l = 0; l < W; l++) {
+    std::array<double, 2> f; 
+    std::array<double, 4> j; 
+    ad::jacobian<2>([&](const auto& theta) { return closure(r, t4[l], theta); }, 
+                    {T[0][l], T[1][l]}, f, j); 
+
+    F[0][l] = f[0]; 
+    F[1][l] = f[1]; 
+    for (size_t k = 0; k < 4; k++) {
+      J[k][l] = j[k]; 
+    }
   }
-  return derivative; 
 }
@@ -1,7 +1,9 @@
 #!/usr/bin/bash 
 
-rm -f *.o ode quadrature *.csv *.png
+rm -f *.o ode traj2csv quadrature *.csv *.bin *.png
 
-gcc ode.c -o ode -lm 
-g++ quadrature.cpp -o quadrature -lm 
+# the source hash versions ode's result cache, edits invalidate old entries 
+gcc -DBUILD_VERSION="\"$(sha1sum ode.c | cut -c1-16)\"" ode.c -o ode -lm 
+gcc traj2csv.c -o traj2csv 
+g++ -std=c++20 -O3 -march=native -pthread quadrature.cpp -o quadrature -lm 
 
@@ -8,25 +8,106 @@
 
 #include <stdio.h> 
 #include <stdlib.h> 
+#include <stdint.h> 
+#include <string.h> 
 #include <math.h> 
+#include <errno.h> 
+#include <fcntl.h> 
+#include <unistd.h> 
+#include <sys/mman.h> 
+#include <sys/stat.h> 
 
 typedef struct {
   double* y; 
   size_t size, max; 
 } vec_t; 
 
+/*
+ * Binary trajectory file: one header, then rows of little-endian doubles 
+ * {t, y, exact, |exact - y|}. rows is patched in when the sink closes and 
+ * order reads 0x01020304 on a host with the writer's byte order. 
+ * traj2csv converts these back into the csv layout the plot scripts read 
+ */ 
+#define TRAJ_MAGIC   "ODETRAJ1"
+#define TRAJ_COLUMNS 4 
+#define SINK_BLOCK   4096        /* rows staged before each fwrite */ 
+#define SINK_VBUF    (1 << 20)   /* stdio buffer behind the file */ 
+
+typedef struct {
+  char magic[8]; 
+  char method[24]; 
+  double dt; 
+  uint64_t rows; 
+  uint32_t columns; 
+  uint32_t order; 
+} traj_header_t; 
+
+typedef double (*exact_fn)(const double);
+
+/*
+ * Content addressed result cache. A run is keyed by FNV-1a over its method, 
+ * rate, interval, step size, initial value and build version, and its entry 
+ * <dir>/<key>.bin is the trajectory file followed by a cache_tail_t. A hit 
+ * maps the entry and writes the trajectory straight out, so a sweep only 
+ * integrates the (method, dt) pairs it has not seen before. ODE_CACHE picks 
+ * the directory, empty disables it. build.sh defines BUILD_VERSION as the 
+ * hash of this source so an edit invalidates every entry; stale entries are 
+ * never read again and go away with the directory 
+ */ 
+#ifndef BUILD_VERSION 
+#define BUILD_VERSION __DATE__ " " __TIME__ 
+#endif 
+#define CACHE_MAGIC  "ODECACH1"
+#define CACHE_DIR    ".ode-cache"
+
+typedef struct {
+  char magic[8]; 
+  uint64_t key; 
+  double last_error, max_error; 
+} cache_tail_t; 
+
+typedef struct {
+  const char* method; 
+  const char* rate; 
+  double t0, t1, dt, y0; 
+} run_key_t; 
+
+/*
+ * Streaming sink any integrator pushes its nodes into. Errors against the 
+ * exact solution are computed as the rows are written, so no trajectory or 
+ * truth vector is ever materialized 
+ */ 
+typedef struct {
+  FILE* fp; 
+  char* vbuf; 
+  exact_fn exact; 
+  traj_header_t hdr; 
+  size_t fill; 
+  int failed;   /* a block write failed, the file is truncated */ 
+  double last_error, max_error; 
+  double rows[SINK_BLOCK * TRAJ_COLUMNS]; 
+} sink_t; 
+
 typedef double (*functor)(const double, const double);
-typedef void (*ode)(functor rate, vec_t*, const vec_t*, const double);
+typedef void (*ode)(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt);
 
 static vec_t* linspace(const double lo, const double hi, const double step);
 static inline double three_rate(const double y, const double t); 
-static inline vec_t* three_exact(const vec_t* t);
-static vec_t* solve(ode method, functor rate, const double y0, const double dt, const vec_t* t);
-static void euler(functor rate, vec_t* vec, const vec_t* t, double dt);
-static void midpoint(functor rate, vec_t* vec, const vec_t* t, double dt);
-static void modified_euler(functor rate, vec_t* vec, const vec_t* t, double dt);
-static void rk4(functor rate, vec_t* vec, const vec_t* t, double dt); 
-static void abam_pred_corrector(functor rate, vec_t* vec, const vec_t* t, double dt);
+static inline double three_exact(const double t);
+static void euler(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt);
+static void midpoint(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt);
+static void modified_euler(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt);
+static void rk4(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt); 
+static void abam_pred_corrector(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt);
+
+static sink_t* sink_open(const char* path, const char* method, const double dt, exact_fn exact);
+static inline void sink_push(sink_t* s, const double t, const double y);
+static int sink_close(sink_t* s);
+
+static uint64_t run_hash(const run_key_t* k); 
+static int cache_load(const uint64_t key, const char* out, double* last_error); 
+static int cache_store(const uint64_t key, const char* traj, const double last_error, 
+                       const double max_error); 
 
 static vec_t* vec_new(size_t n, double* ar);
 static void vec_delete(vec_t* v);
@@ -49,83 +130,50 @@ const char method_enum[5][32] = { "euler", "midpoint", "mod_euler", "rk4", "abam
 
 int main(void) 
 {
-  vec_t* t = NULL, *v = NULL, *truth = NULL; 
-  vec_t *error[num_sizes][method_count];
-  int i = 0, j = 0;
-  size_t k = 0; 
+  vec_t* t = NULL; 
+  sink_t* sink = NULL; 
+  double final_error[num_sizes][method_count];
+  int i = 0, j = 0, hits = 0;
   double y0 = exp(-1);
+  const double t0 = 1.0, t1 = 2.0; 
+  double max_error = 0.0; 
+  uint64_t key = 0; 
   char bufr[256]; 
   FILE* fp = NULL; 
 
+  // one pass per run: integrate, compare to the exact solution and write 
   for (j = 0; j < num_sizes; j++) {
-    t = linspace(1.0, 2.0, stepsizes[j]); 
-    truth = three_exact(t); 
+    t = linspace(t0, t1, stepsizes[j]); 
 
     for (i = 0; i < method_count; i++) {
-      error[j][i] = vec_new(t->size, NULL);
-      error[j][i]->size = t->size; 
+      const run_key_t run = { method_enum[i], "three_rate", t0, t1, stepsizes[j], y0 }; 
+      key = run_hash(&run); 
 
-      snprintf(bufr, sizeof(bufr), "%s_traj_%d.csv", method_enum[i], j + 3); 
-      if ( (fp = fopen(bufr, "w")) == NULL ) {
-        exit( 99 ); 
+      snprintf(bufr, sizeof(bufr), "%s_traj_%d.bin", method_enum[i], j + 3); 
+      if ( cache_load(key, bufr, &final_error[j][i]) == 0 ) {
+        hits++; 
+        continue; 
       }
-      fprintf(fp, "%.4e\n", stepsizes[j]);
-      v = solve(methods[i], three_rate, y0, stepsizes[j], t);
-
-      for (k = 0; k < t->size; k++) {
-        error[j][i]->y[k] = fabs(truth->y[k] - v->y[k]);
-        fprintf(fp, "%.15f, %.15f, %.15f\n", t->y[k], v->y[k], truth->y[k]);
+      if ( (sink = sink_open(bufr, method_enum[i], stepsizes[j], three_exact)) == NULL ) {
+        exit( 99 ); 
       }
-      fclose(fp);
 
-      if ( v ) {
-        vec_delete(v); 
-        v = NULL; 
-      }
-    }
+      methods[i](three_rate, sink, y0, t, stepsizes[j]);
+      final_error[j][i] = sink->last_error; 
+      max_error = sink->max_error; 
 
-    // build vector of analytic solution 
-    if ( t ) {
-      vec_delete(t);
-      t = NULL; 
-    }
-
-    if ( truth ) {
-      vec_delete(truth); 
-      truth = NULL; 
-    }
-  }
-
-  /********** save errors **********************************/ 
-
-  for (j = 0; j < num_sizes; j++) {
-    t = linspace(1.0, 2.0, stepsizes[j]); 
-    truth = three_exact(t); 
-
-    for (i = 0; i < method_count; i++) {
-      snprintf(bufr, sizeof(bufr), "%s_error_%d.csv", method_enum[i], j + 3);
-      if ( (fp = fopen(bufr, "w")) == NULL ) {
+      if ( sink_close(sink) != 0 ) {
         exit( 99 ); 
       }
-      fprintf(fp, "%.4e\n", stepsizes[j]);
-
-      for (k = 0; k < t->size; k++) {
-        // save relative error over time 
-        fprintf(fp, "%.15f, %.15f\n", t->y[k], error[j][i]->y[k]);
-      }
-
-      fclose(fp);
+      // only a cleanly closed trajectory is cached, a failed store only costs 
+      // the next run a recompute 
+      cache_store(key, bufr, final_error[j][i], max_error); 
     }
 
     if ( t ) {
       vec_delete(t);
       t = NULL; 
     }
-
-    if ( truth ) {
-      vec_delete(truth); 
-      truth = NULL; 
-    }
   }
 
   for (i = 0; i < method_count; i++) {
@@ -134,20 +182,17 @@ int main(void)
       exit( 99 ); 
     }
 
+    // get absolute error at t = 2 
     for (j = 0; j < num_sizes; j++) {
-      k = error[j][i]->size - 1; 
-
-      // get absolute error 
-      fprintf(fp, "%.15f, %.15f\n", 1.0 / stepsizes[j], error[j][i]->y[k]);
-      if ( error[j][i] ) { 
-        vec_delete(error[j][i]);
-        error[j][i] = NULL; 
-      }
+      fprintf(fp, "%.15f, %.15f\n", 1.0 / stepsizes[j], final_error[j][i]);
     }
 
     fclose(fp);
   }
 
+  if ( hits > 0 ) {
+    fprintf(stderr, "ode: %d of %d runs reused from the cache\n", hits, num_sizes * method_count); 
+  }
   exit(0);
 }
 
@@ -157,132 +202,341 @@ three_rate(const double y, const double t)
   return (2.0 * y) * (( 1.0 / t ) - t);   
 }
 
-static inline vec_t* 
-three_exact(const vec_t* t)
+static inline double 
+three_exact(const double t)
+{
+  const double t2 = t * t; 
+  return t2 * exp(-t2);
+}
+
+/************ trajectory sink *****************************/
+
+static sink_t* 
+sink_open(const char* path, const char* method, const double dt, exact_fn exact)
 {
-  size_t i = 0, n = t->size; 
-  vec_t* v = vec_new(n, NULL);
-  v->size = n;
+  const uint32_t order = 0x01020304; 
+  sink_t* s = calloc(1, sizeof(sink_t)); 
+  if ( !s ) {
+    return NULL; 
+  }
+
+  if ( (s->fp = fopen(path, "wb")) == NULL ) {
+    free(s); 
+    return NULL; 
+  }
 
-  for (i = 0; i < n; i++) {
-    const double t2 = t->y[i] * t->y[i]; 
-    v->y[i] = t2 * exp(-t2);
+  // large stdio buffer so rows leave in few, big writes 
+  if ( (s->vbuf = malloc(SINK_VBUF)) != NULL ) {
+    setvbuf(s->fp, s->vbuf, _IOFBF, SINK_VBUF); 
   }
 
-  return v; 
+  memcpy(s->hdr.magic, TRAJ_MAGIC, sizeof(s->hdr.magic)); 
+  memcpy(s->hdr.method, method, strnlen(method, sizeof(s->hdr.method) - 1)); 
+  s->hdr.dt      = dt; 
+  s->hdr.columns = TRAJ_COLUMNS; 
+  s->hdr.order   = order; 
+  s->exact       = exact; 
+
+  // placeholder header, rows is filled in on close 
+  if ( fwrite(&s->hdr, sizeof(s->hdr), 1, s->fp) != 1 ) {
+    fclose(s->fp); 
+    free(s->vbuf); 
+    free(s); 
+    return NULL; 
+  }
+  return s; 
 }
 
-/************ wrapper over ode solvers *********************/
+static inline int 
+sink_flush(sink_t* s)
+{
+  const size_t n = s->fill * TRAJ_COLUMNS; 
+  s->fill = 0; 
+  return ( fwrite(s->rows, sizeof(double), n, s->fp) == n ) ? 0 : -1; 
+}
 
-static vec_t*
-solve(ode method, functor rate, const double y0, const double dt, const vec_t* t)
+static inline void 
+sink_push(sink_t* s, const double t, const double y)
 {
-  const size_t n = t->size; 
-  vec_t* vec = vec_new(n, NULL); // prefix sum 
-  vec->y[0] = y0; // set ic  
- 
-  method(rate, vec, t, dt);
-  vec->size = n; 
-  return vec; 
+  const double exact = s->exact(t); 
+  const double err = fabs(exact - y); 
+  double* row = s->rows + s->fill * TRAJ_COLUMNS; 
+
+  row[0] = t; 
+  row[1] = y; 
+  row[2] = exact; 
+  row[3] = err; 
+  s->last_error = err; 
+  if ( err > s->max_error ) {
+    s->max_error = err; 
+  }
+
+  s->hdr.rows++; 
+  if ( ++s->fill == SINK_BLOCK && sink_flush(s) != 0 ) {
+    s->failed = 1; 
+  }
+}
+
+static int 
+sink_close(sink_t* s)
+{
+  int rc = ( sink_flush(s) == 0 && !s->failed ) ? 0 : -1; 
+
+  // patch the final row count into the header 
+  if ( fseek(s->fp, 0, SEEK_SET) != 0 || fwrite(&s->hdr, sizeof(s->hdr), 1, s->fp) != 1 ) {
+    rc = -1; 
+  }
+  if ( fclose(s->fp) != 0 ) {
+    rc = -1; 
+  }
+  free(s->vbuf); 
+  free(s); 
+  return rc; 
+}
+
+/************ result cache ********************************/
+
+static uint64_t 
+run_hash(const run_key_t* k)
+{
+  char text[512]; 
+  uint64_t h = 0xcbf29ce484222325ULL; 
+  int n = 0, i = 0; 
+
+  // %a is exact, so keys never depend on decimal rounding 
+  n = snprintf(text, sizeof(text), "%s|%s|%a|%a|%a|%a|%s|%s", k->method, k->rate, k->t0, 
+               k->t1, k->dt, k->y0, BUILD_VERSION, __VERSION__); 
+  for (i = 0; i < n && i < (int)sizeof(text); i++) {
+    h ^= (unsigned char)text[i]; 
+    h *= 0x100000001b3ULL; 
+  }
+  return h; 
+}
+
+// entry path for key, NULL when ODE_CACHE is set empty 
+static const char* 
+cache_path(const uint64_t key, char* path, size_t len)
+{
+  const char* dir = getenv("ODE_CACHE"); 
+  if ( !dir ) {
+    dir = CACHE_DIR; 
+  }
+  if ( *dir == '\0' ) {
+    return NULL; 
+  }
+  if ( mkdir(dir, 0755) != 0 && errno != EEXIST ) {
+    return NULL; 
+  }
+  snprintf(path, len, "%s/%016llx.bin", dir, (unsigned long long)key); 
+  return path; 
+}
+
+// read only map of a whole file, NULL on failure 
+static const unsigned char* 
+map_file(const char* path, size_t* size)
+{
+  struct stat st; 
+  void* p = MAP_FAILED; 
+  const int fd = open(path, O_RDONLY); 
+  if ( fd < 0 ) {
+    return NULL; 
+  }
+  if ( fstat(fd, &st) == 0 && st.st_size > 0 ) {
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0); 
+  }
+  close(fd); 
+  if ( p == MAP_FAILED ) {
+    return NULL; 
+  }
+  *size = (size_t)st.st_size; 
+  return p; 
+}
+
+/*
+ * Writes the cached trajectory for key to out. Any entry that is short, 
+ * foreign or stored under another key is a miss 
+ */ 
+static int 
+cache_load(const uint64_t key, const char* out, double* last_error)
+{
+  char path[512]; 
+  size_t size = 0, body = 0; 
+  traj_header_t hdr; 
+  cache_tail_t tail; 
+  const unsigned char* p = NULL; 
+  FILE* fp = NULL; 
+  int rc = -1; 
+
+  if ( !cache_path(key, path, sizeof(path)) || !(p = map_file(path, &size)) ) {
+    return -1; 
+  }
+  if ( size < sizeof(hdr) + sizeof(tail) ) {
+    munmap((void*)p, size); 
+    return -1; 
+  }
+
+  memcpy(&hdr, p, sizeof(hdr)); 
+  memcpy(&tail, p + size - sizeof(tail), sizeof(tail)); 
+  body = sizeof(hdr) + (size_t)hdr.rows * hdr.columns * sizeof(double); 
+  if ( memcmp(hdr.magic, TRAJ_MAGIC, sizeof(hdr.magic)) == 0 
+    && memcmp(tail.magic, CACHE_MAGIC, sizeof(tail.magic)) == 0 
+    && tail.key == key && body + sizeof(tail) == size 
+    && (fp = fopen(out, "wb")) != NULL ) {
+    rc = ( fwrite(p, 1, body, fp) == body ) ? 0 : -1; 
+    rc = ( fclose(fp) == 0 ) ? rc : -1; 
+    *last_error = tail.last_error; 
+  }
+  munmap((void*)p, size); 
+  return rc; 
+}
+
+/*
+ * Copies the closed trajectory file traj into the entry for key. Written 
+ * under a temporary name and renamed, so a concurrent or interrupted run 
+ * never leaves a partial entry behind 
+ */ 
+static int 
+cache_store(const uint64_t key, const char* traj, const double last_error, 
+            const double max_error)
+{
+  char path[512], tmp[560]; 
+  size_t size = 0; 
+  cache_tail_t tail; 
+  const unsigned char* p = NULL; 
+  FILE* fp = NULL; 
+  int rc = -1; 
+
+  if ( !cache_path(key, path, sizeof(path)) || !(p = map_file(traj, &size)) ) {
+    return -1; 
+  }
+
+  memset(&tail, 0, sizeof(tail)); 
+  memcpy(tail.magic, CACHE_MAGIC, sizeof(tail.magic)); 
+  tail.key        = key; 
+  tail.last_error = last_error; 
+  tail.max_error  = max_error; 
+
+  snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid()); 
+  if ( (fp = fopen(tmp, "wb")) != NULL ) {
+    rc = ( fwrite(p, 1, size, fp) == size && fwrite(&tail, sizeof(tail), 1, fp) == 1 ) ? 0 : -1; 
+    rc = ( fclose(fp) == 0 ) ? rc : -1; 
+    if ( rc != 0 || rename(tmp, path) != 0 ) {
+      remove(tmp); 
+      rc = -1; 
+    }
+  }
+  munmap((void*)p, size); 
+  return rc; 
 }
 
 /************ explicit single step methods ****************/
 
 static void  
-euler(functor rate, vec_t* vec, const vec_t* t, double dt)
+euler(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt)
 {
   size_t n = t->size, i = 0; 
-  double r = 0.0; 
+  double r = 0.0, y = y0; 
 
+  sink_push(out, t->y[0], y); 
   for (i = 1; i < n; i++) {
-    r = rate(vec->y[i - 1], t->y[i - 1]); 
-    vec->y[i] = vec->y[i - 1] + (dt * r); 
+    r = rate(y, t->y[i - 1]); 
+    y = y + (dt * r); 
+    sink_push(out, t->y[i], y); 
   }
 }
 
 static void 
-midpoint(functor rate, vec_t* vec, const vec_t* t, double dt)
+midpoint(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt)
 {
   size_t n = t->size, i = 0; 
-  double r = 0.0, ymid = 0.0, tmid = 0.0, half = 0.0; 
+  double r = 0.0, ymid = 0.0, tmid = 0.0, half = 0.0, y = y0; 
 
+  sink_push(out, t->y[0], y); 
   for (i = 1; i < n; i++) {
     // compute half step 
-    r = rate(vec->y[i - 1], t->y[i - 1]);
-    ymid = vec->y[i - 1] + (0.5 * dt * r);
+    r = rate(y, t->y[i - 1]);
+    ymid = y + (0.5 * dt * r);
     tmid = t->y[i - 1] + (0.5 * dt);
     half = rate(ymid, tmid);
 
-    vec->y[i] = vec->y[i - 1] + (dt * half);
+    y = y + (dt * half);
+    sink_push(out, t->y[i], y); 
   }
 }
 
 static void 
-modified_euler(functor rate, vec_t* vec, const vec_t* t, double dt)
+modified_euler(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt)
 {
   size_t n = t->size, i = 0; 
-  double r = 0.0, yfull = 0.0, full = 0.0; 
+  double r = 0.0, yfull = 0.0, full = 0.0, y = y0; 
 
+  sink_push(out, t->y[0], y); 
   for (i = 1; i < n; i++) {
     // compute half step 
-    r = rate(vec->y[i - 1], t->y[i - 1]);
-    yfull = vec->y[i - 1] + dt * r;
+    r = rate(y, t->y[i - 1]);
+    yfull = y + dt * r;
     full = rate(yfull, t->y[i]);
 
-    vec->y[i] = vec->y[i - 1] + (0.5 * dt * (full + r));
+    y = y + (0.5 * dt * (full + r));
+    sink_push(out, t->y[i], y); 
   }
 }
 
 static void 
-rk4(functor rate, vec_t* vec, const vec_t* t, double dt)
+rk4(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt)
 {
   size_t n = t->size, i = 0; 
-  double r = 0.0, half1 = 0.0, half2 = 0.0, full = 0.0; 
+  double r = 0.0, half1 = 0.0, half2 = 0.0, full = 0.0, y = y0; 
   double yhalf1 = 0.0, yhalf2 = 0.0, yfull = 0.0, thalf = 0.0; 
 
+  sink_push(out, t->y[0], y); 
   for (i = 1; i < n; i++) {
-    r      = rate(vec->y[i - 1], t->y[i - 1]); 
+    r      = rate(y, t->y[i - 1]); 
     thalf  = t->y[i - 1] + 0.5 * dt; 
-    yhalf1 = vec->y[i - 1] + (0.5 * dt) * r; 
+    yhalf1 = y + (0.5 * dt) * r; 
     half1  = rate(yhalf1, thalf);
-    yhalf2 = vec->y[i - 1] + (0.5 * dt) * half1; 
+    yhalf2 = y + (0.5 * dt) * half1; 
     half2  = rate(yhalf2, thalf); 
-    yfull  = vec->y[i - 1] + dt * half2;
+    yfull  = y + dt * half2;
     full   = rate(yfull, t->y[i]); 
     
-    vec->y[i] = vec->y[i - 1] + (dt / 6.0) * (r + 2.0 * (half1 + half2) + full);
+    y = y + (dt / 6.0) * (r + 2.0 * (half1 + half2) + full);
+    sink_push(out, t->y[i], y); 
   }
 }
 
 /************ multi-step predictor corrector scheme *******/ 
 
 static void 
-abam_pred_corrector(functor rate, vec_t* vec, const vec_t* t, double dt)
+abam_pred_corrector(functor rate, sink_t* out, const double y0, const vec_t* t, const double dt)
 {
   size_t n = t->size, i = 0; 
-  double fi = 0.0, fprev = 0.0, ynext = 0.0, next = 0.0; 
+  double fi = 0.0, fprev = 0.0, ynext = 0.0, next = 0.0, y = y0; 
+
+  sink_push(out, t->y[0], y); 
 
   // compute a single midpoint (~O(h^2)) step 
   {
-    double f1 = rate(vec->y[0], t->y[0]);
-    double ymid = vec->y[0] + (0.5 * dt * f1);
+    double f1 = rate(y, t->y[0]);
+    double ymid = y + (0.5 * dt * f1);
     double tmid = t->y[0] + (0.5 * dt);
     double f2 = rate(ymid, tmid);
-    vec->y[1] = vec->y[0] + (dt * f2);
+    y = y + (dt * f2);
     fi = f1;  
   } // end scope midpoint local values 
-
+  sink_push(out, t->y[1], y); 
 
   for (i = 2; i < n; i++) {
     // compute two-step AB 
     fprev = fi; 
-    fi = rate(vec->y[i - 1], t->y[i - 1]);
-    ynext = vec->y[i - 1] + (0.5 * dt) * (3.0 * fi - fprev);
+    fi = rate(y, t->y[i - 1]);
+    ynext = y + (0.5 * dt) * (3.0 * fi - fprev);
     // prediction of y_{i+1}
     next  = rate(ynext, t->y[i]);
     
     // correct prediction 
-    vec->y[i] = vec->y[i - 1] + (dt / 12.0) * (5.0 * next + 8.0 * fi - fprev); 
+    y = y + (dt / 12.0) * (5.0 * next + 8.0 * fi - fprev); 
+    sink_push(out, t->y[i], y); 
   }
 }
 
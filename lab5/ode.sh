@@ -2,6 +2,7 @@
 
 ./build.sh 
 ./ode 
+./traj2csv *_traj_*.bin 
 
 ./plot.sh "Euler" euler_traj_*.csv  
 ./plot.sh "Midpoint" midpoint_traj_*.csv  
@@ -18,4 +19,4 @@
 ./convg.sh euler_abs_error.csv midpoint_abs_error.csv mod_euler_abs_error.csv \
   abam_abs_error.csv rk4_abs_error.csv 
 
-rm -f *.csv
+rm -f *.csv *.bin
@@ -3,95 +3,417 @@
  * quadrature.cpp  Andrew Belles  Oct 30th, 2025 
  *
  * Computes Romberg and Gaussian Quadratures, makes some analytic comparison 
- * on different methods 
+ * on different methods. ./quadrature --bench [tol=...] [reps=n] times romberg() 
  */ 
 
 #include <csignal>
+#include <cstring> 
 #include <iostream> 
 #include <cmath> 
-#include <unordered_map>
+#include <algorithm> 
+#include <array> 
+#include <chrono> 
+#include <future> 
+#include <map> 
+#include <mutex> 
+#include <span> 
+#include <thread> 
 #include <vector> 
 #include <tuple> 
 #include <iomanip> 
+#include <limits> 
+
+#include "../common/bench.hpp"
+#include "../common/instrument.hpp"
+#include "../common/pool.hpp"
+#include "../common/vmath.hpp"
 
 typedef double (*functor)(const double&);
+typedef void (*batch_functor)(std::span<const double> x, std::span<double> fx);
+
+/*
+ * Integrand seen by every rule, which hand their abscissae over a level or 
+ * panel at a time. A batch functor gets the whole span (split across threads 
+ * past parallel_min points), a scalar functor is looped over by the adapter 
+ */ 
+class Integrand {
+public:
+  Integrand(functor f) : scalar_(f) {}
+  Integrand(batch_functor g) : batch_(g) {}
+
+  // threads a single large batch may be split across, 1 keeps it serial 
+  void threads(size_t t) { threads_ = std::max<size_t>(1, t); }
+
+  void 
+  operator()(std::span<const double> x, std::span<double> fx) const
+  {
+    const size_t n = x.size(); 
+    const size_t t = std::min(threads_, n / parallel_min); 
+    PROBE_ADD(IntegrandEvals, n); 
+    if ( t < 2 ) {
+      run_(x, fx); 
+      return; 
+    }
+
+    const size_t chunk = (n + t - 1) / t; 
+    std::vector<std::future<void>> parts; 
+    for (size_t lo = chunk; lo < n; lo += chunk) {
+      const size_t len = std::min(chunk, n - lo); 
+      parts.push_back(std::async(std::launch::async, [this, x, fx, lo, len]() {
+        run_(x.subspan(lo, len), fx.subspan(lo, len)); 
+      }));
+    }
+    run_(x.first(chunk), fx.first(chunk)); 
+    for (auto& p : parts) {
+      p.get(); 
+    }
+  }
+
+  double 
+  operator()(const double& x) const
+  {
+    double fx = 0.0; 
+    run_({&x, 1}, {&fx, 1}); 
+    PROBE_ADD(IntegrandEvals, 1); 
+    return fx; 
+  }
+
+private:
+  static constexpr size_t parallel_min = 1 << 16; 
+  functor scalar_{nullptr}; 
+  batch_functor batch_{nullptr}; 
+  size_t threads_{std::max(1u, std::thread::hardware_concurrency())}; 
+
+  void 
+  run_(std::span<const double> x, std::span<double> fx) const
+  {
+    if ( batch_ ) {
+      batch_(x, fx); 
+      return; 
+    }
+    for (size_t i = 0; i < x.size(); i++) {
+      fx[i] = scalar_(x[i]); 
+    }
+  }
+};
 
 using LResult = std::tuple<double, double, size_t, size_t>; 
 using SResult = std::tuple<double, size_t>;
+using CResult = std::tuple<double, size_t, size_t>;  // T_n, n, evals spent searching 
+using AResult = std::tuple<double, double, size_t, size_t>;  // I, error, evals, panels 
+
+/*
+ * Gauss-Kronrod pair over the non-negative nodes, descending from the end 
+ * point with the center last. wg is zero where a Kronrod node is not also a 
+ * Gauss node, so the Gauss and Kronrod sums share one loop 
+ */ 
+template<size_t K>
+struct Kronrod {
+  std::array<double, K> x, wk, wg; 
+};
+
+// QUADPACK qk15 
+constexpr Kronrod<8> G7K15{
+  {0.991455371120812639206854697526329, 0.949107912342758524526189684047851, 
+   0.864864423359769072789712788640926, 0.741531185599394439863864773280788, 
+   0.586087235467691130294144845693013, 0.405845151377397166906606412076961, 
+   0.207784955007898467600689403773245, 0.0}, 
+  {0.022935322010529224963732008058970, 0.063092092629978553290700663189204, 
+   0.104790010322250183839876322541518, 0.140653259715525918745189590510238, 
+   0.169004726639267902826583426598550, 0.190350578064785409913256402421014, 
+   0.204432940075298892414161999234649, 0.209482141084727828012999174891714}, 
+  {0.0, 0.129484966168869693270611432679082, 0.0, 0.279705391489276667901467771423780, 
+   0.0, 0.381830050505118944950369775488975, 0.0, 0.417959183673469387755102040816327} 
+}; 
+
+// QUADPACK qk21 
+constexpr Kronrod<11> G10K21{
+  {0.995657163025808080735527280689003, 0.973906528517171720077964012084452, 
+   0.930157491355708226001207180059508, 0.865063366688984510732096688423493, 
+   0.780817726586416897063717578345042, 0.679409568299024406234327365114874, 
+   0.562757134668604683339000099272694, 0.433395394129247190799265943165784, 
+   0.294392862701460198131126603103866, 0.148874338981631210884826001129720, 0.0}, 
+  {0.011694638867371874278064396062192, 0.032558162307964727478818972459390, 
+   0.054755896574351996031381300244580, 0.075039674810919952767043140916190, 
+   0.093125454583697605535065465083366, 0.109387158802297641899210590325805, 
+   0.123491976262065851077208980478125, 0.134709217311473325928054001771707, 
+   0.142775938577060080797094273138717, 0.147739104901338491374841515972068, 
+   0.149445554002916905664936468389821}, 
+  {0.0, 0.066671344308688137593568809893332, 0.0, 0.149451349150580593145776339657697, 
+   0.0, 0.219086362515982043995534934228163, 0.0, 0.269266719309996355091226921569469, 
+   0.0, 0.295524224714752870173892994651338, 0.0}
+}; 
+
+// n-point Gauss-Legendre rule on [-1, 1], ascending nodes 
+struct GaussRule {
+  std::vector<double> x, w; 
+};
+
+static const GaussRule& gauss_rule(size_t n); 
+static GaussRule golub_welsch(size_t n); 
+
+static void first_batch(std::span<const double> x, std::span<double> fx); 
+static double second(const double& x); 
+static LResult romberg(const Integrand& f, const double& a, const double& b, 
+                       const double& tol = 1e-9); 
+static inline bool isSufficient(const double& Rprev, const double& Rcurr, const double& tol); 
+static double composite(const Integrand& f, const double& a, const double& b, const size_t& n);
+static CResult search_composite_best(const double& I, const Integrand& f, const double& a, 
+                                     const double& b, const double& tol = 1e-9);
+static SResult gaussian_quad(const Integrand& f, const double& a, const double& b, const size_t& n);
+template<size_t K> 
+static AResult gauss_kronrod(const Integrand& f, const double& a, const double& b, 
+                             const Kronrod<K>& rule, const double& tol);
+
+/************ job runner **********************************/
+enum class Method : int8_t {
+  Romberg, 
+  Composite, 
+  Gauss, 
+  Kronrod15, 
+  Kronrod21
+};
 
-std::unordered_map<int, std::vector<double>> roots, coeffs; 
+/*
+ * One integral for run_jobs(). tol drives every adaptive method; n is the 
+ * Gauss point count (0 raises n until successive rules agree to tol) and 
+ * reference is the value the composite panel search closes on 
+ */ 
+struct Job {
+  Integrand f; 
+  double a, b; 
+  Method method; 
+  double tol{1e-9}; 
+  size_t n{0}; 
+  double reference{0.0}; 
+};
 
-static void gauss_root_table(std::unordered_map<int, std::vector<double>>& table);
-static void gauss_coeff_table(std::unordered_map<int, std::vector<double>>& table);
+/*
+ * value, error estimate (NaN where a method has none), function evaluations 
+ * and wall time. n is method specific: romberg levels, composite panels, 
+ * gauss points or kronrod panels. coarse is romberg's trapezoid R(n,0) 
+ */ 
+struct Result {
+  double value{0.0}, error{0.0}; 
+  size_t evals{0}, n{0}; 
+  double coarse{0.0}, seconds{0.0}; 
+};
+
+static Result run_job(const Job& job, const bool serial); 
+static std::vector<Result> run_jobs(std::span<const Job> jobs, ThreadPool& pool); 
+static void report(const std::string& label, std::span<const Result> lab, const Result& search); 
+int benchmark(int argc, char* argv[]); 
+
+int main(int argc, char* argv[]) 
+{
+  if ( argc > 1 && std::strcmp(argv[1], "--bench") == 0 ) {
+    return benchmark(argc, argv); 
+  }
 
-static double first(const double& x); 
-static double second(const double& x); 
-static LResult romberg(const functor& f, const double& a, const double& b); 
-static inline bool isSufficient(const double& Rprev, const double& Rcurr); 
-static double composite(const functor& f, const double& a, const double& b, const size_t& n);
-static SResult search_composite_best(const double& I, const functor& f, const double& a, const double& b);
-static SResult gaussian_quad(const functor& f, const double& a, const double& b, const double& n);
+  const std::array<std::tuple<std::string, Integrand, double, double>, 4> integrals{{
+    {"x^2*e^{-x} on interval [0, 1]", first_batch, 0.0, 1.0}, 
+    {"x^{1/3} on interval [0, 1]", second, 0.0, 1.0}, 
+    {"x^2*e^{-x} on interval [1, 2]", first_batch, 1.0, 2.0}, 
+    {"x^{1/3} on interval [1, 2]", second, 1.0, 2.0}
+  }}; 
+  constexpr size_t per = 8;  // romberg, gauss n = 1..5, both kronrod pairs 
+  ThreadPool pool; 
+
+  std::vector<Job> jobs; 
+  for (auto& [label, f, a, b] : integrals) {
+    jobs.push_back({f, a, b, Method::Romberg}); 
+    for (size_t n = 1; n <= 5; n++) {
+      jobs.push_back({f, a, b, Method::Gauss, 1e-9, n}); 
+    }
+    jobs.push_back({f, a, b, Method::Kronrod15}); 
+    jobs.push_back({f, a, b, Method::Kronrod21}); 
+  }
+  auto results = run_jobs(jobs, pool); 
 
-static void evaluate(const std::string& label, const functor& f, const double& a, const double& b);
+  // the composite search closes on each romberg value, so it runs second 
+  std::vector<Job> searches; 
+  for (size_t k = 0; k < integrals.size(); k++) {
+    auto& [label, f, a, b] = integrals[k]; 
+    searches.push_back({f, a, b, Method::Composite, 1e-9, 0, results[k * per].value}); 
+  }
+  auto found = run_jobs(searches, pool); 
 
-int main(void) 
+  for (size_t k = 0; k < integrals.size(); k++) {
+    report(std::get<0>(integrals[k]), 
+           std::span<const Result>(results).subspan(k * per, per), found[k]); 
+  }
+  return 0; 
+}
+
+/************ run_jobs() **********************************/
+/*
+ * Every job is one pool task writing its own slot, so results come back in 
+ * job order. Once there are at least as many jobs as workers the pool is 
+ * the parallelism and each integrand's large batches stay serial 
+ */ 
+static std::vector<Result> 
+run_jobs(std::span<const Job> jobs, ThreadPool& pool)
+{
+  std::vector<Result> results(jobs.size()); 
+  const bool serial = jobs.size() >= pool.size(); 
+
+  pool.parallel_for(jobs.size(), [&](size_t i) {
+    results[i] = run_job(jobs[i], serial); 
+  });
+  return results; 
+}
+
+static Result 
+run_job(const Job& job, const bool serial)
 {
-  gauss_root_table(roots); 
-  gauss_coeff_table(coeffs);
+  using clock = std::chrono::steady_clock; 
+  constexpr double none = std::numeric_limits<double>::quiet_NaN(); 
+  PROBE_TIME(Quadrature); 
+  constexpr size_t max_points = 64; 
+
+  Integrand f = job.f; 
+  if ( serial ) {
+    f.threads(1); 
+  }
 
-  evaluate("x^2*e^{-x} on interval [0, 1]", first, 0.0, 1.0);
-  evaluate("x^{1/3} on interval [0, 1]", second, 0.0, 1.0);
-  evaluate("x^2*e^{-x} on interval [1, 2]", first, 1.0, 2.0);
-  evaluate("x^{1/3} on interval [1, 2]", second, 1.0, 2.0);
+  Result r; 
+  const auto start = clock::now(); 
+  switch (job.method) {
+    case Method::Romberg: {
+      auto [v, rn0, levels, evals] = romberg(f, job.a, job.b, job.tol); 
+      r = {v, std::abs(v - rn0), evals, levels, rn0}; 
+      break; 
+    }
+    case Method::Composite: {
+      auto [v, panels, evals] = search_composite_best(job.reference, f, job.a, job.b, job.tol); 
+      r = {v, std::abs(v - job.reference), evals, panels}; 
+      break; 
+    }
+    case Method::Gauss: {
+      if ( job.n > 0 ) {
+        auto [v, k] = gaussian_quad(f, job.a, job.b, job.n); 
+        r = {v, none, k, k}; 
+        break; 
+      }
+
+      // raise n until two successive rules agree 
+      auto [prev, k] = gaussian_quad(f, job.a, job.b, 1); 
+      r = {prev, none, k, k}; 
+      for (size_t n = 2; n <= max_points; n++) {
+        auto [v, m] = gaussian_quad(f, job.a, job.b, n); 
+        r = {v, std::abs(v - prev), r.evals + m, n}; 
+        if ( r.error < job.tol ) {
+          break; 
+        }
+        prev = v; 
+      }
+      break; 
+    }
+    case Method::Kronrod15: 
+    case Method::Kronrod21: {
+      auto [v, err, evals, panels] = ( job.method == Method::Kronrod15 ) 
+        ? gauss_kronrod(f, job.a, job.b, G7K15, job.tol) 
+        : gauss_kronrod(f, job.a, job.b, G10K21, job.tol); 
+      r = {v, err, evals, panels}; 
+      break; 
+    }
+  }
+  r.seconds = std::chrono::duration<double>(clock::now() - start).count(); 
+  return r; 
+}
 
+/************ benchmark() *********************************/
+/*
+ * ./quadrature --bench [tol=1e-6,1e-9] [reps=5] 
+ * romberg() on the lab integrals at each tolerance, one thread per integral. 
+ * A step is one Romberg row, evals are integrand evaluations. x^{1/3} on 
+ * [0, 1] only gains ~1.3 bits a level, so tighter tol grows its levels fast 
+ */ 
+int 
+benchmark(int argc, char* argv[])
+{
+  const std::array<std::tuple<std::string, Integrand, double, double>, 4> integrals{{
+    {"romberg_x2exp", first_batch, 0.0, 1.0}, {"romberg_cbrt", second, 0.0, 1.0}, 
+    {"romberg_x2exp", first_batch, 1.0, 2.0}, {"romberg_cbrt", second, 1.0, 2.0}
+  }}; 
+
+  try {
+    const bench::Args args(argc, argv); 
+    args.allow({"tol", "reps"}); 
+    const size_t reps = static_cast<size_t>(args.get("reps", 5)); 
+
+    for (double tol : args.list("tol", {1e-6, 1e-9})) {
+      for (auto [name, f, a, b] : integrals) {
+        f.threads(1); 
+        bench::emit(bench::measure(name, {{"a", a}, {"b", b}, {"tol", tol}}, reps, [&]() {
+          auto [v, rn0, levels, evals] = romberg(f, a, b, tol); 
+          return bench::Work{levels, evals}; 
+        })); 
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "invalid usage: ./quadrature --bench [tol=...] [reps=n]: " << e.what() << '\n'; 
+    return 1; 
+  }
   return 0; 
 }
 
+/************ report() ************************************/
+/*
+ * Formats one integral's results once everything has been computed. lab 
+ * holds romberg, gauss n = 1..5 and the two kronrod pairs in job order 
+ */ 
 static void 
-evaluate(const std::string& label, const functor& f, const double& a, const double& b)
+report(const std::string& label, std::span<const Result> lab, const Result& search)
 {
-  size_t n = 0; 
+  const Result& rom = lab[0]; 
+  const double res = rom.value; 
+  auto us = [](const Result& r) { return r.seconds * 1e6; }; 
 
   std::cout << std::setprecision(15); 
-    
-  auto [res, rn0, ext, evals] = romberg(f, a, b); 
   std::cout << "1)\n" << label << ": " << res << '\n'
-            << "n: " << ext << " and " << evals << " function evaluations\n";
+            << "n: " << rom.n << " and " << rom.evals << " function evaluations in " 
+            << us(rom) << " us\n";
 
-  std::cout << "trapezoidal approx: " << rn0 << '\n'
-            << "Rn0, Rnn diff: " << std::abs(res - rn0) << '\n';
+  std::cout << "trapezoidal approx: " << rom.coarse << '\n'
+            << "Rn0, Rnn diff: " << rom.error << '\n';
 
-  auto [v, comp_n] = search_composite_best(res, f, a, b);
-  std::cout << comp_n << " panels, " << comp_n + 1 << " evaluations required for " 
-            << std::abs(v - res) << " difference\n\n";
-
-  std::vector<SResult> gauss_results; 
-  for (n = 1; n <= 5; n++) {
-    gauss_results.push_back(gaussian_quad(f, a, b, n));
-  }
+  std::cout << search.n << " panels, " << search.n + 1 << " evaluations required for " 
+            << search.error << " difference, found in " << search.evals 
+            << " function evaluations in " << us(search) << " us\n\n";
 
   std::cout << "2)\n" << label << " gaussian quadrature\n"; 
-  for (auto& [r, k] : gauss_results) {
-    if ( k < 5 ) {
+  for (size_t i = 1; i <= 5; i++) {
+    const Result& r = lab[i]; 
+    if ( r.n < 5 ) {
       std::cout << std::setprecision(8);
     } else { 
       std::cout << std::setprecision(15); 
     }
-    std::cout << "I(b)=" << r << ", n=" << k << ", romberg diff: " 
-              << std::abs(res - r) << '\n';   
+    std::cout << "I(b)=" << r.value << ", n=" << r.n << ", romberg diff: " 
+              << std::abs(res - r.value) << '\n';   
+  }
+
+  std::cout << std::setprecision(15) << "3)\n" << label << " adaptive gauss-kronrod\n"; 
+  const char* names[2] = {"G7K15", "G10K21"}; 
+  for (size_t i = 0; i < 2; i++) {
+    const Result& r = lab[6 + i]; 
+    std::cout << names[i] << ": " << r.value << ", error estimate: " << r.error << ", " 
+              << r.evals << " evaluations over " << r.n << " panels in " << us(r) 
+              << " us, romberg diff: " << std::abs(res - r.value) << '\n'; 
   }
   std::cout << '\n';
 }
 
 static LResult 
-romberg(const functor& f, const double& a, const double& b) 
+romberg(const Integrand& f, const double& a, const double& b, const double& tol) 
 {
   size_t i = 0, j = 0, n = 1, k = 2; 
   const double h0 = b - a;
   double sum = 0.0, h = 0.0; 
   const double boundary = f(a) + f(b); 
   
-  std::vector<double> prow; 
+  std::vector<double> prow, xs, fs; 
   prow.push_back(0.5 * h0 * boundary);
 
   // compute Rn,1 
@@ -99,11 +421,17 @@ romberg(const functor& f, const double& a, const double& b)
 
     h = h0 / std::pow(2.0, n);  
 
+    // new midpoints of this level in one batch 
     sum = 0.0; 
     size_t evals = (1 << (n - 1));
+    xs.resize(evals); 
+    fs.resize(evals); 
+    for (i = 0; i < evals; i++) {
+      xs[i] = a + (2.0 * i + 1) * h; 
+    }
+    f(xs, fs); 
     for (i = 0; i < evals; i++) {
-      double x = a + (2.0 * i + 1) * h; 
-      sum += f(x);
+      sum += fs[i];
     }
     k += evals;
 
@@ -116,7 +444,7 @@ romberg(const functor& f, const double& a, const double& b)
       crow[j] = crow[j - 1] + ((crow[j - 1] - prow[j - 1]) / den);
     }
     
-    if ( isSufficient(crow.back(), prow.back()) ) {
+    if ( isSufficient(crow.back(), prow.back(), tol) ) {
       return { crow.back(), crow.front(), n, k }; 
     } else {
       prow = std::move(crow); 
@@ -128,9 +456,8 @@ romberg(const functor& f, const double& a, const double& b)
 }
 
 static inline bool 
-isSufficient(const double& Rcurr, const double& Rprev)
+isSufficient(const double& Rcurr, const double& Rprev, const double& tol)
 {
-  constexpr double tol = 1e-9; 
   if ( std::abs(Rcurr - Rprev) < tol ) {
     return true; 
   } else {
@@ -139,61 +466,234 @@ isSufficient(const double& Rcurr, const double& Rprev)
 }
 
 static double 
-composite(const functor& f, const double& a, const double& b, const size_t& n)
+composite(const Integrand& f, const double& a, const double& b, const size_t& n)
 {
   const double h = (b - a) / n;
   double midsum = 0.0; 
   size_t i = 0; 
+  std::vector<double> xs(n - 1), fs(n - 1); 
 
   for (i = 1; i < n; i++) {
-    double x = a + static_cast<double>(i) * h; 
-    midsum += f(x);
+    xs[i - 1] = a + static_cast<double>(i) * h; 
+  }
+  f(xs, fs); 
+  for (i = 0; i + 1 < n; i++) {
+    midsum += fs[i];
   }
 
   return 0.5 * h * (f(a) + 2.0 * midsum + f(b));
 }
 
-static SResult   
-search_composite_best(const double& I, const functor& f, const double& a, const double& b)
+/************ search_composite_best() ********************/
+/*
+ * Smallest n whose composite trapezoid is within tol of I. Panel doubling 
+ * reuses every previous point (only the new midpoints are evaluated, like 
+ * each romberg row) until the tolerance is met, then the crossing inside 
+ * the last doubling is bisected on n. Probes are first placed where the 
+ * trapezoid's c/n^2 error model predicts the crossing, falling back to the 
+ * midpoint when that fails to halve the bracket, so the whole search costs 
+ * a small multiple of n evaluations instead of O(n^2) 
+ */ 
+static CResult   
+search_composite_best(const double& I, const Integrand& f, const double& a, const double& b, 
+                      const double& tol)
 {
-  size_t n = 1; 
-  double C = composite(f, a, b, n);
   constexpr size_t max_n = 1e5; 
-  
-  while ( n < max_n && std::abs(I - C) >= 1e-9 ) {
-    C = composite(f, a, b, ++n);
+  size_t n = 1, evals = 2, i = 0; 
+  double T = 0.5 * (b - a) * (f(a) + f(b)); 
+  std::vector<double> xs, fs; 
+
+  while ( std::abs(I - T) >= tol && 2 * n <= max_n ) {
+    const double h = (b - a) / static_cast<double>(2 * n); 
+    double sum = 0.0; 
+    xs.resize(n); 
+    fs.resize(n); 
+    for (i = 0; i < n; i++) {
+      xs[i] = a + (2.0 * i + 1) * h; 
+    }
+    f(xs, fs); 
+    for (i = 0; i < n; i++) {
+      sum += fs[i]; 
+    }
+    evals += n; 
+    T = 0.5 * T + h * sum; 
+    n *= 2; 
+  }
+
+  if ( std::abs(I - T) < tol && n == 1 ) {
+    return {T, n, evals}; 
+  }
+
+  // doubling ran out before max_n was reached, the cap itself is the last probe 
+  size_t lo = n / 2, hi = n; 
+  if ( std::abs(I - T) >= tol ) {
+    T = composite(f, a, b, max_n); 
+    evals += max_n + 1; 
+    if ( std::abs(I - T) >= tol ) {
+      return {T, max_n, evals}; 
+    }
+    lo = n; 
+    hi = max_n; 
   }
 
-  return {C, n}; 
+  // T_lo fails and T_hi passes 
+  double Thi = T, Ehi = std::abs(I - T); 
+  bool model = true; 
+  while ( hi - lo > 1 ) {
+    const size_t width = hi - lo; 
+    size_t probe = lo + width / 2; 
+    if ( model && Ehi > 0.0 ) {
+      const double guess = std::ceil(static_cast<double>(hi) * std::sqrt(Ehi / tol)); 
+      probe = std::clamp(static_cast<size_t>(guess), lo + 1, hi - 1); 
+    }
+
+    const double C = composite(f, a, b, probe); 
+    evals += probe + 1; 
+    if ( std::abs(I - C) < tol ) {
+      hi = probe; 
+      Thi = C; 
+      Ehi = std::abs(I - C); 
+    } else {
+      lo = probe; 
+    }
+    model = ( 2 * (hi - lo) <= width ); 
+  }
+
+  return {Thi, hi, evals}; 
 }
 
 static SResult 
-gaussian_quad(const functor& f, const double& a, const double& b, const double& n)
+gaussian_quad(const Integrand& f, const double& a, const double& b, const size_t& n)
+{
+  constexpr size_t block = 64; 
+  const GaussRule& rule = gauss_rule(n); 
+  const double mid = 0.5 * (a + b), half = 0.5 * (b - a); 
+  double sum = 0.0, xs[block], fs[block]; 
+  size_t i = 0, j = 0; 
+
+  // project points into space a stack block at a time 
+  for (i = 0; i < n; i += block) {
+    const size_t m = std::min(block, n - i); 
+    for (j = 0; j < m; j++) {
+      xs[j] = mid + half * rule.x[i + j]; 
+    }
+    f({xs, m}, {fs, m}); 
+    for (j = 0; j < m; j++) {
+      sum += rule.w[i + j] * fs[j]; 
+    }
+  }
+  
+  return {half * sum, n};
+}
+
+/************ gauss_kronrod() *****************************/
+/*
+ * Globally adaptive Gauss-Kronrod: the panel with the largest error estimate 
+ * is bisected until the summed estimate drops below tol. Panels live in a 
+ * fixed-capacity max heap on the stack so the call never allocates, and the 
+ * error per panel uses QUADPACK's |K - G| scaling 
+ */
+template<size_t K> 
+static AResult 
+gauss_kronrod(const Integrand& f, const double& a, const double& b, 
+              const Kronrod<K>& rule, const double& tol)
 {
-  // get points from table 
-  std::vector<double> groots = roots[n], gcoeffs = coeffs[n];
-  size_t k = groots.size(), i = 0; 
-  std::vector<double> evals;
-  double sum = 0.0; 
-  evals.reserve(k);
+  struct Panel {
+    double a, b, value, error; 
+    bool operator<(const Panel& o) const { return error < o.error; }
+  };
+  constexpr size_t limit = 2000; 
+  constexpr double eps = 2.220446049250313e-16; 
+
+  size_t evals = 0, count = 0, i = 0; 
+  std::array<Panel, limit> heap; 
+
+  auto panel = [&](const double l, const double r) -> Panel {
+    const double mid = 0.5 * (l + r), half = 0.5 * (r - l); 
+    // center, left nodes then right nodes in one batch 
+    double xs[2 * K - 1], fs[2 * K - 1]; 
+    xs[0] = mid; 
+    for (size_t j = 0; j < K - 1; j++) {
+      xs[1 + j] = mid - half * rule.x[j]; 
+      xs[K + j] = mid + half * rule.x[j]; 
+    }
+    f(xs, fs); 
+
+    const double fc = fs[0]; 
+    const double* fl = fs + 1; 
+    const double* fr = fs + K; 
+    double kronrod = rule.wk[K - 1] * fc, gauss = rule.wg[K - 1] * fc; 
+
+    for (size_t j = 0; j < K - 1; j++) {
+      kronrod += rule.wk[j] * (fl[j] + fr[j]); 
+      gauss += rule.wg[j] * (fl[j] + fr[j]); 
+    }
+    evals += 2 * K - 1; 
+
+    // absolute variation about the mean scales the raw |K - G| difference 
+    const double mean = 0.5 * kronrod; 
+    double asc = rule.wk[K - 1] * std::abs(fc - mean); 
+    for (size_t j = 0; j < K - 1; j++) {
+      asc += rule.wk[j] * (std::abs(fl[j] - mean) + std::abs(fr[j] - mean)); 
+    }
+
+    double error = std::abs((kronrod - gauss) * half); 
+    asc *= std::abs(half); 
+    if ( asc != 0.0 && error != 0.0 ) {
+      error = asc * std::min(1.0, std::pow(200.0 * error / asc, 1.5)); 
+    }
+    error = std::max(error, 50.0 * eps * std::abs(kronrod * half)); 
+    return {l, r, kronrod * half, error}; 
+  };
 
-  // project points into space 
-  for (auto& r : groots) {
-    evals.push_back(f((a + b) / 2.0 + (b - a) / 2.0 * r));  
+  heap[count++] = panel(a, b); 
+  double value = heap[0].value, error = heap[0].error; 
+
+  while ( error > tol && count + 1 < limit ) {
+    std::pop_heap(heap.begin(), heap.begin() + count); 
+    const Panel worst = heap[--count]; 
+    const double mid = 0.5 * (worst.a + worst.b); 
+
+    // stop once the worst panel can no longer be split in floating point 
+    if ( !(worst.a < mid && mid < worst.b) ) {
+      heap[count++] = worst; 
+      std::push_heap(heap.begin(), heap.begin() + count); 
+      break; 
+    }
+
+    const Panel left = panel(worst.a, mid), right = panel(mid, worst.b); 
+    heap[count++] = left; 
+    std::push_heap(heap.begin(), heap.begin() + count); 
+    heap[count++] = right; 
+    std::push_heap(heap.begin(), heap.begin() + count); 
+
+    value += left.value + right.value - worst.value; 
+    error += left.error + right.error - worst.error; 
   }
 
-  for (i = 0; i < k; i++) {
-    sum += gcoeffs[i] * evals[i]; 
+  // resum from the panels so the running update's cancellation is dropped 
+  value = 0.0, error = 0.0; 
+  for (i = 0; i < count; i++) {
+    value += heap[i].value; 
+    error += heap[i].error; 
   }
-  sum *= 0.5 * (b - a);
-  
-  return {sum, k};
+  return {value, error, evals, count}; 
 }
 
-static double 
-first(const double& x)
+// x^2 e^{-x} over a batch, e^{-x} through the vectorized kernel 
+static void 
+first_batch(std::span<const double> x, std::span<double> fx)
 {
-  return x * x * exp(-x); 
+  const size_t n = x.size(); 
+  size_t i = 0; 
+
+  for (i = 0; i < n; i++) {
+    fx[i] = -x[i]; 
+  }
+  exp_kernel(fx.data(), n); 
+  for (i = 0; i < n; i++) {
+    fx[i] *= x[i] * x[i]; 
+  }
 }
 
 static double 
@@ -202,49 +702,107 @@ second(const double& x)
   return pow(x, 0.333333);
 }
 
-static void 
-gauss_root_table(std::unordered_map<int, std::vector<double>>& table)
+/************ gauss_rule() ********************************/
+/*
+ * Cached n-point Gauss-Legendre rule, built by Golub-Welsch on first use. 
+ * Rules never move once inserted so the reference stays valid for the life 
+ * of the program and later calls are a lookup 
+ */ 
+static const GaussRule& 
+gauss_rule(size_t n)
 {
-  const double a = std::sqrt(1.0 / 3.0);
-  const double b = std::sqrt(3.0 / 5.0); 
-  const double c[2] = {
-    (1.0 / 35.0) * std::sqrt(525.0 + 70.0 * std::sqrt(30.0)), 
-    (1.0 / 35.0) * std::sqrt(525.0 - 70.0 * std::sqrt(30.0))
-  }; 
-  const double d[2] = {
-    (1.0 / 21.0) * std::sqrt(245.0 + 14.0 * std::sqrt(70.0)),
-    (1.0 / 21.0) * std::sqrt(245.0 - 14.0 * std::sqrt(70.0))
-  };
+  static std::mutex mtx; 
+  static std::map<size_t, GaussRule> cache; 
 
-  table[1] = {0.0}; 
-  table[2] = {-a, a};
-  table[3] = {-b, 0.0, b}; 
-  table[4] = {-c[0], -c[1], c[1], c[0]};
-  table[5] = {-d[0], -d[1], 0.0, d[1], d[0]};
+  std::lock_guard<std::mutex> lock(mtx); 
+  auto it = cache.find(n); 
+  if ( it == cache.end() ) {
+    it = cache.emplace(n, golub_welsch(n)).first; 
+  }
+  return it->second; 
 }
 
-
-static void 
-gauss_coeff_table(std::unordered_map<int, std::vector<double>>& table)
+/************ golub_welsch() ******************************/
+/*
+ * Nodes are the eigenvalues of the symmetric tridiagonal Jacobi matrix of 
+ * the Legendre recurrence (zero diagonal, k / sqrt(4k^2 - 1) off diagonal), 
+ * weights are 2 v0^2 for the first component of each unit eigenvector. 
+ * Implicit QL with Wilkinson shifts, tracking only that first row 
+ */ 
+static GaussRule 
+golub_welsch(size_t n)
 {
-  const double a[2] = {1.0 / 36.0, std::sqrt(30.0)};
-  const double b = 13.0 * std::sqrt(70.0);
-
-  table[1] = {2.0};
-  table[2] = {1.0, 1.0}; 
-  table[3] = {5.0 / 9.0, 8.0 / 9.0, 5.0 / 9.0};
-  table[4] = {
-    a[0] * (18.0 - a[1]), 
-    a[0] * (18.0 + a[1]), 
-    a[0] * (18.0 + a[1]), 
-    a[0] * (18.0 - a[1])
-  }; 
+  std::vector<double> d(n, 0.0), e(n, 0.0), z(n, 0.0); 
+  size_t i = 0, l = 0, m = 0, iter = 0; 
   
-  table[5] = {
-    (1.0 / 900.0) * (322.0 - b), 
-    (1.0 / 900.0) * (322.0 + b), 
-    128.0 / 225.0,  
-    (1.0 / 900.0) * (322.0 + b),
-    (1.0 / 900.0) * (322.0 - b)
-  }; 
+  for (i = 1; i < n; i++) {
+    const double k = static_cast<double>(i); 
+    e[i - 1] = k / std::sqrt(4.0 * k * k - 1.0); 
+  }
+  if ( n > 0 ) {
+    z[0] = 1.0; 
+  }
+
+  for (l = 0; l < n; l++) {
+    for (iter = 0; iter < 64; iter++) {
+      for (m = l; m + 1 < n; m++) {
+        const double dd = std::abs(d[m]) + std::abs(d[m + 1]); 
+        if ( std::abs(e[m]) <= 1e-16 * dd ) {
+          break; 
+        }
+      }
+      if ( m == l ) {
+        break; 
+      }
+
+      double g = (d[l + 1] - d[l]) / (2.0 * e[l]); 
+      double r = std::hypot(g, 1.0); 
+      g = d[m] - d[l] + e[l] / (g + std::copysign(r, g)); 
+      double s = 1.0, c = 1.0, p = 0.0; 
+      bool deflated = false; 
+
+      for (i = m; i-- > l; ) {
+        double f = s * e[i], b = c * e[i]; 
+        r = std::hypot(f, g); 
+        e[i + 1] = r; 
+        if ( r == 0.0 ) {
+          d[i + 1] -= p; 
+          e[m] = 0.0; 
+          deflated = true; 
+          break; 
+        }
+        s = f / r; 
+        c = g / r; 
+        g = d[i + 1] - p; 
+        r = (d[i] - g) * s + 2.0 * c * b; 
+        p = s * r; 
+        d[i + 1] = g + p; 
+        g = c * r - b; 
+
+        f = z[i + 1]; 
+        z[i + 1] = s * z[i] + c * f; 
+        z[i] = c * z[i] - s * f; 
+      }
+      // a zero off-diagonal split the block, redo the sweep on what is left 
+      if ( deflated ) {
+        continue; 
+      }
+      d[l] -= p; 
+      e[l] = g; 
+      e[m] = 0.0; 
+    }
+  }
+
+  std::vector<size_t> order(n); 
+  for (i = 0; i < n; i++) {
+    order[i] = i; 
+  }
+  std::sort(order.begin(), order.end(), [&d](size_t p, size_t q) { return d[p] < d[q]; }); 
+
+  GaussRule rule{std::vector<double>(n), std::vector<double>(n)}; 
+  for (i = 0; i < n; i++) {
+    rule.x[i] = d[order[i]]; 
+    rule.w[i] = 2.0 * z[order[i]] * z[order[i]]; 
+  }
+  return rule; 
 }
@@ -2,6 +2,6 @@
 
 rm -f *.o quadrature 
 
-g++ quadrature.cpp -o quadrature -lm 
+g++ -std=c++20 -O3 -march=native -pthread quadrature.cpp -o quadrature -lm 
 
 ./quadrature 
@@ -0,0 +1,131 @@
+/*
+ * traj2csv.c  Andrew Belles
+ *
+ * Converts binary trajectories written by ode back into the csv files the
+ * gnuplot scripts read. For every <name>_traj_<k>.bin it writes
+ * <name>_traj_<k>.csv (t, y, exact) and <name>_error_<k>.csv (t, error),
+ * each led by the stepsize line
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TRAJ_MAGIC   "ODETRAJ1"
+#define TRAJ_COLUMNS 4
+#define READ_BLOCK   4096
+
+typedef struct {
+  char magic[8];
+  char method[24];
+  double dt;
+  uint64_t rows;
+  uint32_t columns;
+  uint32_t order;
+} traj_header_t;
+
+static int convert(const char* path);
+static int output_paths(const char* path, char* traj, char* error, size_t len);
+
+int main(int argc, char* argv[])
+{
+  int i = 0, rc = 0;
+
+  if ( argc < 2 ) {
+    fprintf(stderr, "usage: %s file_traj_k.bin ...\n", argv[0]);
+    exit( 99 );
+  }
+
+  for (i = 1; i < argc; i++) {
+    if ( convert(argv[i]) != 0 ) {
+      fprintf(stderr, "traj2csv: failed on %s\n", argv[i]);
+      rc = 99;
+    }
+  }
+
+  exit( rc );
+}
+
+static int
+output_paths(const char* path, char* traj, char* error, size_t len)
+{
+  const char* ext = strrchr(path, '.');
+  const char* tag = strstr(path, "_traj_");
+  int stem = ( ext ) ? (int)(ext - path) : (int)strlen(path);
+
+  if ( snprintf(traj, len, "%.*s.csv", stem, path) >= (int)len ) {
+    return -1;
+  }
+
+  // name_traj_k -> name_error_k, anything else gets an _error suffix
+  if ( tag && tag < path + stem ) {
+    const int head = (int)(tag - path);
+    const char* rest = tag + strlen("_traj_");
+    if ( snprintf(error, len, "%.*s_error_%.*s.csv", head, path,
+                  (int)(path + stem - rest), rest) >= (int)len ) {
+      return -1;
+    }
+  } else if ( snprintf(error, len, "%.*s_error.csv", stem, path) >= (int)len ) {
+    return -1;
+  }
+  return 0;
+}
+
+static int
+convert(const char* path)
+{
+  traj_header_t hdr;
+  double rows[READ_BLOCK * TRAJ_COLUMNS];
+  char traj[512], error[512];
+  FILE *in = NULL, *ft = NULL, *fe = NULL;
+  uint64_t left = 0;
+  size_t i = 0, n = 0;
+  int rc = -1;
+
+  if ( output_paths(path, traj, error, sizeof(traj)) != 0 ) {
+    return -1;
+  }
+  if ( (in = fopen(path, "rb")) == NULL ) {
+    return -1;
+  }
+  if ( fread(&hdr, sizeof(hdr), 1, in) != 1
+    || memcmp(hdr.magic, TRAJ_MAGIC, sizeof(hdr.magic)) != 0
+    || hdr.order != 0x01020304 || hdr.columns != TRAJ_COLUMNS ) {
+    fclose(in);
+    return -1;
+  }
+
+  if ( (ft = fopen(traj, "w")) == NULL || (fe = fopen(error, "w")) == NULL ) {
+    goto done;
+  }
+
+  fprintf(ft, "%.4e\n", hdr.dt);
+  fprintf(fe, "%.4e\n", hdr.dt);
+
+  left = hdr.rows;
+  while ( left > 0 ) {
+    n = ( left < READ_BLOCK ) ? (size_t)left : READ_BLOCK;
+    if ( fread(rows, sizeof(double) * TRAJ_COLUMNS, n, in) != n ) {
+      goto done;
+    }
+    for (i = 0; i < n; i++) {
+      const double* r = rows + i * TRAJ_COLUMNS;
+      fprintf(ft, "%.15f, %.15f, %.15f\n", r[0], r[1], r[2]);
+      fprintf(fe, "%.15f, %.15f\n", r[0], r[3]);
+    }
+    left -= n;
+  }
+  rc = 0;
+
+done:
+  if ( fe ) {
+    fclose(fe);
+  }
+  if ( ft ) {
+    fclose(ft);
+  }
+  fclose(in);
+  return rc;
+}
@@ -2,97 +2,177 @@
  * stability.cpp  Andrew Belles  Nov 6th, 2025 
  *
  * A-B/A-M two-step predictor corrector model to visualize stability range for
- * the given prototype problem. 
+ * the given prototype problem, against implicit BDF2 and Crank-Nicolson 
+ * which stay stable at the step size that breaks it. 
+ * ./stability --bench [h=...] [tf=...] [reps=n] times ABAM::run() 
  *
  */
 
+#include <algorithm>
 #include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
 #include <vector>
 #include <functional>
+#include <fcntl.h>
+#include <unistd.h>
 #include <gplot++.h>
 
+#include "../common/bench.hpp"
+#include "../common/integrate.hpp"
+#include "../common/implicit.hpp"
+#include "../common/pool.hpp"
+#include "../common/render.hpp"
+
 template<typename R> 
 using Interval = std::pair<R, R>; 
 
 template<typename R> 
 using Rate = std::function<R(const R&, const R&)>; 
 
+/*
+ * W test equations advanced together, one per SIMD lane. Vec already has 
+ * the flat +, - and scalar *; the lane-wise product is all the rate adds 
+ */ 
+template<size_t W> 
+using Pack = ode::Vec<1, W>; 
+
+template<size_t W> 
+inline Pack<W> 
+operator*(const Pack<W>& a, const Pack<W>& b)
+{
+  Pack<W> r; 
+  for (size_t l = 0; l < W; l++) {
+    r.v[l] = a.v[l] * b.v[l]; 
+  }
+  return r; 
+}
+
+template<size_t W> 
+inline Pack<W> 
+operator-(const Pack<W>& a)
+{
+  return -1.0 * a; 
+}
+
+// size of the state the early exit compares, a pack only exits once all lanes have 
+inline double magnitude(const double& w) { return std::abs(w); }
+inline double magnitude(const std::complex<double>& w) { return std::abs(w); }
+
+template<size_t W> 
+inline double 
+magnitude(const Pack<W>& w)
+{
+  double m = std::numeric_limits<double>::infinity(); 
+  for (size_t l = 0; l < W; l++) {
+    const double a = std::abs(w.v[l]); 
+    m = std::isnan(a) ? m : std::min(m, a); 
+  }
+  return m; 
+}
+
+/*
+ * Thin front end over the shared A-B/A-M two-step PECE stepper, which keeps 
+ * only the last two rate evaluations. With stride > 1 only every stride-th 
+ * node (and the last) is stored, so memory follows the output resolution 
+ * rather than the step count. R is the state and parameter type (double, 
+ * std::complex<double>, Pack<W>), time is always real. With a limit set the 
+ * run ends as soon as magnitude(w) passes it 
+ */ 
 template<typename R> 
 class ABAM {
 public: 
-  using Data = std::pair<std::vector<R>, std::vector<R>>; 
+  using Data = std::pair<std::vector<R>, std::vector<double>>; 
 
   // A-B/A-M two-step constructor 
-  ABAM(const R a, const R h, Interval<R> ic, Interval<R> time, Rate<R> fn) 
-    : a_(a), h_(h), rate_func_(std::move(fn))
+  ABAM(const R a, const double h, Interval<R> ic, Interval<double> time, Rate<R> fn, 
+       const size_t stride = 1) 
+    : a_(a), h_(h), ic_(ic), stride_(std::max<size_t>(1, stride)), rate_func_(std::move(fn))
   {
     auto [t0, tf] = time;
-    auto [y0, y1] = ic;  
     t0_ = t0; 
     tf_ = tf; 
-    size_t n = static_cast<size_t>(std::floor((tf_ - t0_) / h)); 
-    
-    // reserve space for all 
-    w.reserve(n + 1); t.reserve(n + 1); f.reserve(n + 1);
+    nodes_ = static_cast<size_t>(std::floor((tf_ - t0_) / h)) + 1; 
     
-    // create time vector 
-    for (size_t i{0}; i <= n; i++) {
-      t.push_back(t0 + i * h);
+    // time of every node that will be kept 
+    t.reserve(ode::Decimate<std::vector<R>>::kept(stride_, nodes_));
+    auto keep = [this](size_t, double ti, const R&) { t.push_back(ti); }; 
+    ode::Decimate<decltype(keep)> times(keep, stride_, nodes_); 
+    for (size_t i{0}; i < nodes_; i++) {
+      times(i, t0 + i * h, R{});
     }
-
-    // push back initial conditions 
-    w.push_back(y0); w.push_back(y1);
-    f.push_back(rate_func_(a_, y0)); 
-    f.push_back(rate_func_(a_, y1)); 
   }
 
+  // stop once magnitude(w) exceeds m 
+  void limit(const double m) { limit_ = m; }
+
   void run() 
   {
-    // start from cleared arrays 
-    f.erase(f.begin() + 2, f.end());
-    w.erase(w.begin() + 2, w.end());
-
-    for (auto ti = t.begin() + 2; ti != t.end(); ti++) {
-      auto wpred = ab_();                 // get predicted w value  
-      auto fpred = rate_func_(a_, wpred); // get predicted rate function 
-      auto wcorr = am_(fpred);            // get corrected w value  
-      auto fcorr = rate_func_(a_, wcorr); // update rate function at w_{i+1}
-      
-      // save new values 
-      f.push_back(fcorr); 
-      w.push_back(wcorr); 
-    } 
+    auto rate = [this](double, const R& y) -> R { return rate_func_(a_, y); };
+    ode::AdamsPC<R, 2, 3, decltype(rate)> pc(ode::AB2, ode::AM2, rate); 
+    auto [y0, y1] = ic_; 
+
+    w.clear(); 
+    w.reserve(t.size()); 
+    auto store = [this](size_t, double, const R& yi) { w.push_back(yi); }; 
+    ode::Decimate<decltype(store)> sink(store, stride_, nodes_); 
+
+    sink(0, t0_, y0); 
+    sink(1, t0_ + h_, y1); 
+    pc.seed(t0_, y0); 
+    pc.seed(t0_ + h_, y1); 
+    R y = y1; 
+    auto past = [this](size_t, double, const R& yi) { return magnitude(yi) > limit_; }; 
+    reached_ = ode::integrate_until(pc, y, t0_, h_, 1, nodes_, sink, past);
+    last_ = y; 
   }
 
   // Return Copy of Data or Time arrays
   std::vector<R> data() const { return w; }
-  std::vector<R> time() const { return t; } 
+  std::vector<double> time() const { return t; } 
   Data both() const { return {w, t}; }
 
+  // state at the last node stepped to and how many nodes that was 
+  const R& last() const { return last_; }
+  size_t reached() const { return reached_; }
+
 private: 
   std::vector<R> w;
-  std::vector<R> f; 
-  std::vector<R> t; 
+  std::vector<double> t; 
 
-  R a_{0.0}, h_{0.0};
-  R t0_{0.0}, tf_{0.0}; 
+  R a_{}, last_{};
+  double h_{0.0};
+  double t0_{0.0}, tf_{0.0}; 
+  double limit_{std::numeric_limits<double>::infinity()}; 
+  Interval<R> ic_{}; 
+  size_t stride_{1}, nodes_{0}, reached_{0}; 
   Rate<R> rate_func_{}; 
+}; 
 
-  inline R ab_() const 
-  {
-    // deref back two rate function evaluations 
-    auto f1 = *f.rbegin(); 
-    auto f2 = *(f.rbegin() + 1);  
-    return w.back() + 0.5 * h_ * (3.0 * f1 - f2);
-  }
+/*
+ * Runs any fixed step stepper (here the implicit ones) over time from y0, 
+ * returning {w, t} at every node 
+ */ 
+template<typename Stepper> 
+std::pair<std::vector<double>, std::vector<double>> 
+march(Stepper& st, const double y0, const double h, Interval<double> time)
+{
+  const size_t nodes = static_cast<size_t>(std::floor((time.second - time.first) / h)) + 1; 
+  std::vector<double> w{y0}, t{time.first}; 
+  w.reserve(nodes); 
+  t.reserve(nodes); 
 
-  inline R am_(const R& f3) const 
-  {
-    auto f1 = *f.rbegin(); 
-    auto f2 = *(f.rbegin() + 1);  
-    return w.back() + (h_ / 12.0) * (5.0 * f3 + 8.0 * f1 - f2);
-  }
-}; 
+  double y = y0; 
+  ode::integrate(st, y, time.first, h, 0, nodes, [&](size_t, double ti, const double& yi) {
+    t.push_back(ti); 
+    w.push_back(yi); 
+  });
+  return {w, t}; 
+}
 
 template <typename R> 
 void plot(const std::vector<R>& t, const std::vector<R>& w, 
@@ -102,19 +182,26 @@ void plot(const std::vector<R>& t, const std::vector<R>& w,
     return; 
   }
 
-  Gnuplot plt{}; 
-  plt.redirect_to_png(png, "1200,1000"); 
-  plt.set_title(title);
-  plt.set_xlabel("t");
-  plt.set_ylabel("w");
-  plt.plot(t, w, label, Gnuplot::LineStyle::LINES);
-  plt.show();
+  RenderQueue::instance().submit({png, "1200,1000", "", {
+    RenderQueue::Panel{title, "t", "w", {}, {}, RenderQueue::Scale::Linear, {{t, w, label}}}
+  }});
 }
 
-double rate(const double& a, const double& w);
+template<typename R> 
+R rate(const R& a, const R& w);
+
+int map(int argc, char* argv[]); 
+int benchmark(int argc, char* argv[]); 
 
-int main(void)
+int main(int argc, char* argv[])
 {
+  if ( argc > 1 && std::strcmp(argv[1], "--bench") == 0 ) {
+    return benchmark(argc, argv); 
+  }
+  if ( argc > 1 ) {
+    return map(argc, argv); 
+  }
+
   double a{1.0};
   auto e = [&a](const double& y) -> double {
     return 50.0 * std::exp(-a * y);
@@ -122,16 +209,16 @@ int main(void)
 
   // Certainly stable 
   Interval<double> ic_stable{e(0.0), e(1e-3)}, t{0.0, 100.0};
-  auto stable   = ABAM<double>(a, 1e-3, ic_stable, t, rate); 
+  auto stable   = ABAM<double>(a, 1e-3, ic_stable, t, rate<double>, 100); 
   stable.run(); 
   
   // Very close to being unstable 
   Interval<double> ic_boundary{e(0.0), e(2.5)};
-  auto semi     = ABAM<double>(a, 1.0, ic_boundary, t, rate); 
+  auto semi     = ABAM<double>(a, 1.0, ic_boundary, t, rate<double>); 
   semi.run(); 
 
   Interval<double> ic_unstable{e(0.0), e(5.0)};
-  auto unstable = ABAM<double>(a, 5.0, ic_unstable, t, rate); 
+  auto unstable = ABAM<double>(a, 5.0, ic_unstable, t, rate<double>); 
   unstable.run();
 
   // copy results 
@@ -140,16 +227,280 @@ int main(void)
   auto [w_unstable, t_unstable] = unstable.both(); 
 
   plot<double>(t_stable, w_stable,
-               "Stable solution, h = 1e-3", "stable", "stable.png");
+               "Stable solution, h = 1e-3 (every 100th step)", "stable", "stable.png");
   plot<double>(t_semi, w_semi,
                "Semi-stable solution, h = 1.0", "semi-stable", "semistable.png");
   plot<double>(t_unstable, w_unstable,
                "Unstable solution, h = 5.0", "unstable", "unstable.png");
 
+  // implicit steppers at the unstable step size 
+  auto f = [&a](double, const double& y) -> double { return rate(a, y); }; 
+  ode::BDF<double, decltype(f), 2> bdf(f); 
+  ode::CrankNicolson<double, decltype(f)> cn(f); 
+  auto [w_bdf, t_bdf] = march(bdf, e(0.0), 5.0, t); 
+  auto [w_cn, t_cn]   = march(cn, e(0.0), 5.0, t); 
+
+  std::printf("h = 5: ABAM w(tf) = %.3e, BDF2 w(tf) = %.3e, CN w(tf) = %.3e\n", 
+              w_unstable.back(), w_bdf.back(), w_cn.back()); 
+  std::printf("BDF2: %zu evals, %zu jacobians, %zu factorizations\n", bdf.newton().evals(), 
+              bdf.newton().jacobians(), bdf.newton().factorizations()); 
+
+  RenderQueue::instance().submit({"implicit.png", "1200,1000", "", {
+    RenderQueue::Panel{"Implicit solutions, h = 5.0", "t", "w", {}, {}, 
+                       RenderQueue::Scale::Linear, {
+      {t_bdf, w_bdf, "BDF2"}, {t_cn, w_cn, "Crank-Nicolson"}
+    }}
+  }});
+
   return 0; 
 }
 
-inline double rate(const double& a, const double& w)
+template<typename R> 
+inline R rate(const R& a, const R& w)
 {
   return -a * w; 
 }
+
+/************ benchmark ***********************************/
+/*
+ * ./stability --bench [h=1e-2,1e-3,1e-4] [tf=100] [stride=100] [reps=5] 
+ * The lab's stable run, w' = -w from w0 = 50, at each step size with 
+ * every stride-th node kept. A step is one PECE step, evals count calls 
+ * to the rate 
+ */ 
+int 
+benchmark(int argc, char* argv[])
+{
+  try {
+    const bench::Args args(argc, argv); 
+    args.allow({"h", "tf", "stride", "reps"}); 
+    const size_t reps = static_cast<size_t>(args.get("reps", 5)); 
+    const size_t stride = static_cast<size_t>(args.get("stride", 100)); 
+    const double tf = args.get("tf", 100.0); 
+
+    uint64_t evals = 0; 
+    Rate<double> counted = [&evals](const double& a, const double& w) { 
+      evals++; 
+      return rate(a, w); 
+    }; 
+
+    for (double h : args.list("h", {1e-2, 1e-3, 1e-4})) {
+      ABAM<double> abam(1.0, h, {50.0, 50.0 * std::exp(-h)}, {0.0, tf}, counted, stride); 
+      bench::emit(bench::measure("abam", {{"h", h}, {"tf", tf}, {"stride", 
+                                 static_cast<double>(stride)}}, reps, [&]() {
+        evals = 0; 
+        abam.run(); 
+        return bench::Work{abam.reached(), evals}; 
+      })); 
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "invalid usage: ./stability --bench [h=...] [tf=t] [stride=k] [reps=n]: " 
+              << e.what() << '\n'; 
+    return 1; 
+  }
+  return 0; 
+}
+
+/************ stability region map ************************/
+/*
+ * ./stability --map out.bin [--re lo hi n] [--im lo hi n] [--steps n] [--limit m]
+ * ./stability --scan out.bin [--h lo hi n] [--a lo hi n] [--steps n] [--limit m]
+ *
+ * --map runs ABAM<std::complex<double>> on w' = lambda w over a grid of z = 
+ * h lambda (x = Re z, y = Im z). --scan runs the lab's w' = -a w over an 
+ * (h, a) grid (x = h, y = a) with Pack lanes across h: on the test 
+ * equation only a h matters, so every lane takes unit steps with its own 
+ * a h. Either way each cell starts from w0 = 1, w1 = e^z, takes steps 
+ * steps, or stops early once |w| > limit, and is stable when |w| ends 
+ * below growth. Rows are spread over the work stealing pool. Output is 
+ * little-endian binary: 
+ *
+ *   MapHeader 
+ *   uint8_t cell[rows][cols]  (1 stable, row r at y0 + r dy, col c at x0 + c dx) 
+ *
+ * The boundary cells are plotted and the extent of the region is printed 
+ */ 
+struct MapHeader {
+  char magic[8]{'A', 'B', 'A', 'M', 'M', 'A', 'P', '1'}; 
+  uint64_t cols{0}, rows{0}, steps{0}; 
+  double x0{0.0}, x1{0.0}, y0{0.0}, y1{0.0}; 
+};
+
+struct Axis {
+  double lo{0.0}, hi{0.0}; 
+  size_t count{1}; 
+
+  double 
+  at(size_t k) const
+  {
+    return ( count == 1 ) ? lo : lo + (hi - lo) * static_cast<double>(k) / (count - 1); 
+  }
+};
+
+constexpr size_t lanes  = 8; 
+constexpr double growth = 2.0; 
+
+// one row of z = x + i y cells 
+static void 
+map_row(const Axis& x, const double y, const size_t steps, const double limit, uint8_t* row)
+{
+  using C = std::complex<double>; 
+  for (size_t c = 0; c < x.count; c++) {
+    const C z{x.at(c), y}; 
+    ABAM<C> cell(-z, 1.0, {C{1.0}, std::exp(z)}, {0.0, static_cast<double>(steps)}, 
+                 rate<C>, steps); 
+    cell.limit(limit); 
+    cell.run(); 
+    row[c] = ( magnitude(cell.last()) < growth ); 
+  }
+}
+
+// one row of a, lanes h values per run 
+static void 
+scan_row(const Axis& h, const double a, const size_t steps, const double limit, uint8_t* row)
+{
+  for (size_t c = 0; c < h.count; c += lanes) {
+    Pack<lanes> p, y1; 
+    for (size_t l = 0; l < lanes; l++) {
+      p.v[l]  = a * h.at(std::min(c + l, h.count - 1)); 
+      y1.v[l] = std::exp(-p.v[l]); 
+    }
+    Pack<lanes> y0; 
+    std::fill(y0.v, y0.v + lanes, 1.0); 
+
+    ABAM<Pack<lanes>> cell(p, 1.0, {y0, y1}, {0.0, static_cast<double>(steps)}, 
+                            rate<Pack<lanes>>, steps); 
+    cell.limit(limit); 
+    cell.run(); 
+    for (size_t l = 0; l < lanes && c + l < h.count; l++) {
+      row[c + l] = ( std::abs(cell.last().v[l]) < growth ); 
+    }
+  }
+}
+
+int 
+map(int argc, char* argv[])
+{
+  const bool scan = ( argc > 1 && std::strcmp(argv[1], "--scan") == 0 ); 
+  if ( argc < 3 || (!scan && std::strcmp(argv[1], "--map") != 0) ) {
+    std::cerr << "invalid usage: ./stability [--map out.bin [--re lo hi n] [--im lo hi n] "
+              << "| --scan out.bin [--h lo hi n] [--a lo hi n]] [--steps n] [--limit m]\n";
+    return 1; 
+  }
+
+  const char* path = argv[2]; 
+  Axis x = ( scan ) ? Axis{0.05, 3.0, 400} : Axis{-3.0, 1.0, 201}; 
+  Axis y = ( scan ) ? Axis{0.25, 2.0, 8} : Axis{-2.0, 2.0, 201}; 
+  size_t steps = 1000; 
+  double limit = 1e6; 
+  int i = 0; 
+
+  for (i = 3; i < argc; i++) {
+    const bool xs = std::strcmp(argv[i], scan ? "--h" : "--re") == 0; 
+    const bool ys = std::strcmp(argv[i], scan ? "--a" : "--im") == 0; 
+    if ( (xs || ys) && i + 3 < argc ) {
+      Axis r{std::stod(argv[i + 1]), std::stod(argv[i + 2]), std::stoul(argv[i + 3])}; 
+      if ( r.count == 0 ) {
+        std::cerr << "axis count must be positive\n"; 
+        return 1; 
+      }
+      ( xs ? x : y ) = r; 
+      i += 3; 
+    } else if ( std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc ) {
+      steps = std::max<size_t>(2, std::stoul(argv[++i])); 
+    } else if ( std::strcmp(argv[i], "--limit") == 0 && i + 1 < argc ) {
+      limit = std::stod(argv[++i]); 
+    } else {
+      std::cerr << "unknown map argument: " << argv[i] << '\n'; 
+      return 1; 
+    }
+  }
+
+  std::vector<uint8_t> grid(x.count * y.count, 0); 
+  ThreadPool pool; 
+  pool.parallel_for(y.count, [&](size_t r) {
+    uint8_t* row = grid.data() + r * x.count; 
+    if ( scan ) {
+      scan_row(x, y.at(r), steps, limit, row); 
+    } else {
+      map_row(x, y.at(r), steps, limit, row); 
+    }
+  });
+
+  MapHeader header; 
+  header.cols = x.count; 
+  header.rows = y.count; 
+  header.steps = steps; 
+  header.x0 = x.lo; 
+  header.x1 = x.hi; 
+  header.y0 = y.lo; 
+  header.y1 = y.hi; 
+
+  const int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644); 
+  if ( fd < 0 ) {
+    std::cerr << "choked opening " << path << '\n'; 
+    return 2; 
+  }
+  const bool io_ok = pwrite(fd, &header, sizeof(header), 0) == sizeof(header) 
+    && pwrite(fd, grid.data(), grid.size(), sizeof(header)) == static_cast<ssize_t>(grid.size()); 
+  close(fd); 
+  if ( !io_ok ) {
+    std::cerr << "short write to " << path << '\n'; 
+    return 2; 
+  }
+
+  // boundary: stable cells with an unstable 4-neighbour 
+  auto stable = [&](size_t r, size_t c) { return grid[r * x.count + c] != 0; }; 
+  std::vector<double> bx, by; 
+  size_t count = 0; 
+  for (size_t r = 0; r < y.count; r++) {
+    for (size_t c = 0; c < x.count; c++) {
+      if ( !stable(r, c) ) {
+        continue; 
+      }
+      count++; 
+      const bool edge = ( r > 0 && !stable(r - 1, c) ) || ( r + 1 < y.count && !stable(r + 1, c) ) 
+                     || ( c > 0 && !stable(r, c - 1) ) || ( c + 1 < x.count && !stable(r, c + 1) ); 
+      if ( edge ) {
+        bx.push_back(x.at(c)); 
+        by.push_back(y.at(r)); 
+      }
+    }
+  }
+
+  std::cout << count << " of " << grid.size() << " cells stable after " << steps << " steps\n"; 
+  if ( scan ) {
+    // largest stable h for every a, the product a h is the real stability interval 
+    std::cout << "a h_max a*h_max\n"; 
+    for (size_t r = 0; r < y.count; r++) {
+      size_t c = 0; 
+      while ( c < x.count && stable(r, c) ) {
+        c++; 
+      }
+      const double hmax = ( c == 0 ) ? 0.0 : x.at(c - 1); 
+      std::cout << y.at(r) << ' ' << hmax << ' ' << y.at(r) * hmax << '\n'; 
+    }
+  } else {
+    // real axis extent of the region 
+    const size_t r0 = static_cast<size_t>(std::lround(-y.lo / (y.hi - y.lo) * (y.count - 1))); 
+    if ( y.lo <= 0.0 && y.hi >= 0.0 && r0 < y.count ) {
+      double lo = 0.0; 
+      for (size_t c = 0; c < x.count; c++) {
+        if ( stable(r0, c) ) {
+          lo = x.at(c); 
+          break; 
+        }
+      }
+      std::cout << "real axis: stable from Re z = " << lo << '\n'; 
+    }
+  }
+
+  RenderQueue::instance().submit({scan ? "scan.png" : "region.png", "1000,1000", "", {
+    RenderQueue::Panel{scan ? "ABAM stable (h, a) boundary" : "ABAM stability region boundary", 
+                       scan ? "h" : "Re(h lambda)", scan ? "a" : "Im(h lambda)", 
+                       std::pair{x.lo, x.hi}, std::pair{y.lo, y.hi}, RenderQueue::Scale::Linear, {
+      {std::move(bx), std::move(by), "boundary", Gnuplot::LineStyle::POINTS}
+    }}
+  }});
+  return 0; 
+}
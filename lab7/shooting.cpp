@@ -3,19 +3,33 @@
  *
  * 4th Order A-B/A-M Predictor Corrector, Newton's aided Shooting Method 
  * numeric solution to ODE describing deflection of beam
+ * ./shooting --bench [dx=...] [u0=...] [reps=n] times Beam::run() 
  *
  */ 
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
 #include <iostream> 
 #include <cmath> 
+#include <mutex>
+#include <span> 
 #include <string>
 #include <vector>
 #include <format> 
 #include <gplot++.h> 
 
+#include "../common/bench.hpp"
+#include "../common/dual.hpp"
+#include "../common/instrument.hpp"
+#include "../common/integrate.hpp"
+#include "../common/pool.hpp"
+#include "../common/render.hpp"
+
 constexpr double EPS{1e-9};
 constexpr size_t MAXITER{1000};
+constexpr size_t LANES{4};     // slopes integrated in lockstep per pass 
 
 struct State {
   double y, yprime; 
@@ -38,38 +52,38 @@ inline State operator*(const double& c, const State& a)
 }
 
 
+/*
+ * Beam deflection y and its shooting sensitivity g = dy/du0 integrated as one 
+ * 4 component system {y, y', g, g'}, the variational rate taken by forward 
+ * mode AD of the deflection rate: RK4 starts the shared 4th order 
+ * A-B/A-M PECE stepper, which only keeps the last four rates. Newton shots 
+ * only carry the running state unless keep_every asks for every k-th node 
+ * of each shot, and the full optimal trajectory is only stored once z() 
+ * asks for it. The same integration runs W slopes at once as the lanes of 
+ * a Vec<4, W>, which roots() uses to bracket and refine a whole ensemble 
+ */ 
 class Beam {
 public: 
+  using System = ode::Vec<4>; 
+
+  // shot slope and the (decimated) deflection of that trajectory  
+  struct Shot {
+    double u0; 
+    std::vector<double> x, y; 
+  };
   
   Beam(const double& u, const double& alpha, const double& beta, 
-       const double& h = 1e-3) 
-    : h_(h)
+       const double& h = 1e-3, const size_t keep_every = 0) 
+    : h_(L / std::round(L / h)), n_(static_cast<size_t>(std::round(L / h)) + 1), 
+      stride_(keep_every)
   {
     bcs_ = {alpha, beta};
     u0_  = u; 
-
-    // Get distance array 
-    size_t n{static_cast<size_t>(std::round(L / h))};  
-    // Pre-allocate 
-    x_.reserve(n);
-    z_.reserve(n);
-    F_.reserve(n); 
-    v_.reserve(n);
-    G_.reserve(n);
-
-    for (size_t i = 0; i < n; i++) {
-      x_.push_back(static_cast<double>(i) * h);
-    }
-    
-    // Push back IC, get first force  
-    z_.push_back({alpha, u0_});
-    F_.push_back(system_rate(z_.front(), 0.0)); 
-    v_.push_back({0.0, 1.0});
-    G_.push_back(newton_rate(v_.front(), z_.front(), 0.0));
   }
 
   double run(void)
   {
+    PROBE_TIME(Newton); 
     shots_.clear(); 
     auto [alpha, beta] = bcs_; 
     size_t iter{0};
@@ -77,244 +91,445 @@ public:
     double beta_est = 0.0; 
     
     do {
-      predictor_corrector_(z_, F_, v_, G_);
-      beta_est = z_.back().y; 
+      System end; 
+      if ( stride_ > 0 ) {
+        Shot shot{u, {}, {}}; 
+        shot.x.reserve(ode::Decimate<Shot>::kept(stride_, n_)); 
+        shot.y.reserve(shot.x.capacity()); 
+        auto keep = [&shot](size_t, double x, const System& s) { 
+          shot.x.push_back(x); 
+          shot.y.push_back(s[0]); 
+        }; 
+        ode::Decimate<decltype(keep)> sink(keep, stride_, n_); 
+        end = shoot_(u, sink); 
+        shots_.push_back(std::move(shot)); 
+      } else {
+        end = shoot_(u, ode::Discard{}); 
+      }
+      beta_est = end[0]; 
 
-      u -= (z_.back().y - beta) / (v_.back().y);
-      shots_.push_back(z_); 
-      reinitialize_(u);
+      u -= (end[0] - beta) / end[2];
       iter++;
+      PROBE_ADD(NewtonIterations, 1); 
 
     } while ( std::abs(beta_est - beta) > EPS && iter < MAXITER ); 
 
     u_optimal_ = u; 
+    iters_ = iter; 
+    shot_ = -1.0; 
     return u; // return best trajectory  
   }
 
-  const std::pair<std::vector<State>&, std::vector<State>&> z() 
+  // trajectory of the optimal slope, columns y, y', g, g' over x 
+  const ode::Trajectory<4>& z() 
   {
-    if ( z_.size() != x_.size() ) {
-      reinitialize_(u_optimal_);
-      predictor_corrector_(z_, F_, v_, G_); 
+    if ( shot_ != u_optimal_ ) {
+      shoot_(u_optimal_, trajectory_()); 
+      shot_ = u_optimal_; 
     }
+    return traj_; 
+  }
 
-    return {z_, v_}; 
+  // state at x = L for the optimal slope without storing the trajectory 
+  System end() 
+  {
+    return ( shot_ == u_optimal_ ) ? traj_.at(n_ - 1) : shoot_(u_optimal_, ode::Discard{}); 
   }
 
-  const std::vector<double>& x() const  
+  std::span<const double> x() 
   {
-    return x_; 
+    return z().time(); 
   }
 
-  const std::vector<std::vector<State>>& shots() const 
+  const std::vector<Shot>& shots() const 
   {
     return shots_; 
   }
 
+  // Newton shots taken by the last run() 
+  size_t iterations() const { return iters_; }
+  size_t nodes() const { return n_; }
+  // h rounded so the last of the nodes() lands exactly on x = L 
+  double step() const { return h_; }
+
+  /*
+   * Miss y(L) - beta and its sensitivity g(L) for every slope in u. Slopes 
+   * run LANES at a time in lockstep, lane groups spread over the pool 
+   */ 
+  void miss(std::span<const double> u, std::span<double> f, std::span<double> df)
+  {
+    const double beta = bcs_.yprime; 
+    const size_t groups = (u.size() + LANES - 1) / LANES; 
+
+    auto group = [&](size_t k) {
+      std::array<double, LANES> us{}; 
+      for (size_t l = 0; l < LANES; l++) {
+        us[l] = u[std::min(k * LANES + l, u.size() - 1)]; 
+      }
+      const auto end = shoot_<LANES>(us, ode::Discard{}); 
+      for (size_t l = 0; l < LANES && k * LANES + l < u.size(); l++) {
+        f[k * LANES + l]  = end(0, l) - beta; 
+        df[k * LANES + l] = end(2, l); 
+      }
+    };
+
+    if ( groups > 1 ) {
+      pool_().parallel_for(groups, group); 
+    } else if ( groups == 1 ) {
+      group(0); 
+    }
+  }
+
+  /*
+   * Ensemble shooting: the miss at count slopes across [lo, hi] brackets 
+   * every sign change, then all brackets are refined together, one lockstep 
+   * pass per Newton step, falling back to bisection whenever Newton leaves 
+   * its bracket. Returns the slope of every root found 
+   */ 
+  std::vector<double> roots(const double lo, const double hi, const size_t count)
+  {
+    struct Bracket {
+      double a, b, fa, u; 
+      bool done; 
+    };
+
+    const size_t m = std::max<size_t>(2, count); 
+    std::vector<double> u(m), f(m), df(m); 
+    for (size_t k = 0; k < m; k++) {
+      u[k] = lo + (hi - lo) * static_cast<double>(k) / static_cast<double>(m - 1); 
+    }
+    miss(u, f, df); 
+
+    std::vector<Bracket> br; 
+    for (size_t k = 0; k < m; k++) {
+      if ( std::abs(f[k]) <= EPS ) {
+        br.push_back({u[k], u[k], f[k], u[k], true}); 
+      } else if ( k + 1 < m && std::abs(f[k + 1]) > EPS && (f[k] < 0.0) != (f[k + 1] < 0.0) ) {
+        // secant root of the bracket as the first iterate 
+        const double s = u[k] - f[k] * (u[k + 1] - u[k]) / (f[k + 1] - f[k]); 
+        br.push_back({u[k], u[k + 1], f[k], s, false}); 
+      }
+    }
+
+    std::vector<size_t> active; 
+    for (size_t iter = 0; iter < MAXITER; iter++) {
+      active.clear(); 
+      u.clear(); 
+      for (size_t j = 0; j < br.size(); j++) {
+        if ( !br[j].done ) {
+          active.push_back(j); 
+          u.push_back(br[j].u); 
+        }
+      }
+      if ( active.empty() ) {
+        break; 
+      }
+
+      f.resize(u.size()); 
+      df.resize(u.size()); 
+      miss(u, f, df); 
+
+      for (size_t k = 0; k < active.size(); k++) {
+        Bracket& b = br[active[k]]; 
+        if ( std::abs(f[k]) <= EPS ) {
+          b.done = true; 
+          continue; 
+        }
+        if ( (f[k] < 0.0) == (b.fa < 0.0) ) {
+          b.a = b.u; 
+          b.fa = f[k]; 
+        } else {
+          b.b = b.u; 
+        }
+
+        const double next = b.u - f[k] / df[k]; 
+        b.u = ( next > b.a && next < b.b ) ? next : 0.5 * (b.a + b.b); 
+        b.done = ( b.b - b.a <= EPS * std::max(1.0, std::abs(b.u)) ); 
+      }
+    }
+
+    std::vector<double> out; 
+    out.reserve(br.size()); 
+    for (auto& b : br) {
+      out.push_back(b.u); 
+    }
+    return out; 
+  }
+
 private: 
 
   State bcs_;
   double u0_; // ? 
   double u_optimal_{0.0}; // store optimal angle 
+  double shot_{-1.0};     // slope currently held in traj_ 
   double L{50.0}, D{8.5e7}, S{100.0}, q{1000.0};
   double h_{1e-3}; 
-  std::vector<State> F_{}, z_{}, v_{}, G_{};
-  std::vector<double> x_{}; 
-  std::vector<std::vector<State>> shots_{};
+  size_t n_{0}; 
+  size_t stride_{0};      // keep every stride-th node of each shot, 0 keeps none 
+  size_t iters_{0}; 
+  ode::Trajectory<4> traj_{0}; 
+  std::vector<Shot> shots_{};
 
-  void reinitialize_(const double u) 
+  static ThreadPool& pool_()
   {
-    z_.front().yprime = u;
-    F_.front() = system_rate(z_.front(), 0.0); 
-    G_.front() = newton_rate(v_.front(), z_.front(), 0.0);
+    static ThreadPool pool; 
+    return pool; 
   }
 
-  State system_rate(const State& z, const double x)
+  ode::Trajectory<4>& trajectory_() 
   {
-    auto [y, yp] = z; 
-
-    const double a = std::pow((1.0 + yp * yp), 1.5); 
-    const double b = (q * x * (x - L) * y) / (2.0 * D); 
-    const double c = ((S / D) * yp);
-
-    return {yp, a * (b + c)};
+    if ( traj_.size() != n_ ) {
+      traj_ = ode::Trajectory<4>(n_); 
+    }
+    shot_ = -1.0; 
+    return traj_; 
   }
 
-  State newton_rate(const State& v, const State& z, const double x)
+  /*
+   * y'' of the beam, written once over the scalar type. With ad::Dual<1> 
+   * seeded by the sensitivity (g, g') the derivative part is the 
+   * variational rate g'' = f_y g + f_y' g', from the same evaluation 
+   */ 
+  template<typename T> 
+  T system_rate(const T& y, const T& yp, const double x) const 
   {
-    const auto [g, gp] = v; 
-    const auto [y, yp] = z; 
-
-    const double a = 1.0 + yp * yp; 
-    const double sqrt_a = std::sqrt(a); 
-    const double K = std::pow(a, 1.5); 
-
-    const double B = q / (2.0 * D) * (x * x - x * L); 
-    const double A = S / D;
-
-    const double coef_g  = B * K; 
-    const double coef_gp = A * (K + 3.0 * yp * sqrt_a) + B * 2.0 * yp * y; 
+    using std::sqrt; 
+    const T s = 1.0 + yp * yp; 
+    const T a = s * sqrt(s);   // s^1.5, sqrt vectorizes across lanes 
+    const T b = (q * x * (x - L) / (2.0 * D)) * y; 
+    const T c = (S / D) * yp;
 
-    return {gp, coef_g * g + coef_gp * gp};
+    return a * (b + c);
   }
 
-  State bashforth_(const State& z, const std::vector<State>& F)
+  // rates of W independent shots, lane l of every component is shot l 
+  template<size_t W> 
+  ode::Vec<4, W> rate_(const double x, const ode::Vec<4, W>& s)
   {
-    auto it = F.end(); 
-    const State f[4] = {*(it - 4), *(it - 3), *(it - 2), *(it - 1)};
-
-    const State update = 55.0 * f[3] - 59.0 * f[2] + 37.0 * f[1] - 9.0 * f[0];  
-    return z + (h_ / 24.0) * update; 
+    using Tangent = ad::Dual<1>; 
+    ode::Vec<4, W> r; 
+    for (size_t l = 0; l < W; l++) {
+      const Tangent y{s(0, l), {s(2, l)}}, yp{s(1, l), {s(3, l)}}; 
+      const Tangent ypp = system_rate(y, yp, x); 
+      r(0, l) = s(1, l); 
+      r(1, l) = ypp.v; 
+      r(2, l) = s(3, l); 
+      r(3, l) = ypp.d[0]; 
+    }
+    return r; 
   }
 
-  State moulton_(const State& z, const std::vector<State>& F, const State& fpred)
+  template<typename Sink>
+  System shoot_(const double u, Sink&& sink)
   {
-    auto it = F.end(); 
-    const State f[4] = {*(it - 4), *(it - 3), *(it - 2), *(it - 1)};
-
-    const State a = 251.0 * fpred + 646.0 * f[3] - 264.0 * f[2]; 
-    const State b = 106.0 * f[1] - 19.0 * f[0]; 
-    return z + (h_ / 720.0) * (a + b);
+    return shoot_<1>(std::array<double, 1>{u}, std::forward<Sink>(sink)); 
   }
 
   /*
-   * We write to take z and f as arguments, 
-   *
+   * One trajectory per slope in u, lane l of every node goes to sink. Three 
+   * RK4 steps pre-load the predictor corrector, which then runs from the 
+   * 4th node 
    */
-  void predictor_corrector_(std::vector<State>& z, std::vector<State>& F, 
-                            std::vector<State>& v, std::vector<State>& G)
+  template<size_t W, typename Sink>
+  ode::Vec<4, W> shoot_(const std::array<double, W>& u, Sink&& sink)
   {
-    // Reset back to 4 values (or generate) for start  
-    if ( z.size() != 4 ) {
-      z.erase(z.begin() + 1, z.end());
-      F.erase(F.begin() + 1, F.end());
-      v.erase(v.begin() + 1, v.end());
-      G.erase(G.begin() + 1, G.end());
-      rk4_(z, F, v, G); // pre-load now 
+    using Lanes = ode::Vec<4, W>; 
+    auto rate = [this](double x, const Lanes& s) { return rate_<W>(x, s); }; 
+    ode::RungeKutta<Lanes, 4, decltype(rate)> rk(ode::RK4, rate); 
+    ode::AdamsPC<Lanes, 4, 5, decltype(rate)> pc(ode::AB4, ode::AM4, rate); 
+
+    Lanes s; 
+    for (size_t l = 0; l < W; l++) {
+      s(0, l) = bcs_.y; 
+      s(1, l) = u[l]; 
+      s(2, l) = 0.0; 
+      s(3, l) = 1.0; 
+    } 
+    sink(0, 0.0, s); 
+    pc.seed(0.0, s); 
+    for (size_t i = 1; i < 4; i++) {
+      rk.step(static_cast<double>(i - 1) * h_, s, h_); 
+      sink(i, static_cast<double>(i) * h_, s); 
+      pc.seed(static_cast<double>(i) * h_, s); 
     }
 
-    // Run A-B/A-M pred/corr starting from 4th element 
-    for (auto x_it = x_.begin() + 4; x_it != x_.end(); x_it++) {
-      auto x = *x_it; 
-      const State zpred = bashforth_(z.back(), F);
-      const State fpred = system_rate(zpred, x);
-      const State vpred = bashforth_(v.back(), G); 
-      const State gpred = newton_rate(vpred, zpred, x);
-
-      const State zcorr = moulton_(z.back(), F, fpred); 
-      const State fcorr = system_rate(zcorr, x);  
-      const State vcorr = moulton_(v.back(), G, gpred); 
-      const State gcorr = newton_rate(vcorr, zcorr, x);
-
-      z.push_back(zcorr); 
-      F.push_back(fcorr); 
-      v.push_back(vcorr); 
-      G.push_back(gcorr);
-    }
+    ode::integrate(pc, s, 0.0, h_, 3, n_, sink); 
+    return s; 
   }
+}; 
 
-  /*
-   * Computes 3 iterations of Runge-Kutta 4th order to pre-load
-   * the predictor corrector for both g and y 
-   */ 
-  void rk4_(std::vector<State>& z, std::vector<State>& F, 
-            std::vector<State>& v, std::vector<State>& G)
-  {
-    for (size_t i = 0; i < 3; i++) {
-      auto x  = x_[i];
-
-      auto z1 = z.back();
-      auto v1 = v.back();
-      const State kz1 = h_ * system_rate(z1, x); 
-      const State kv1 = h_ * newton_rate(v1, z1, x);
-
-      auto z2 = z1 + 0.5 * kz1;  
-      auto v2 = v1 + 0.5 * kv1;  
-      const State kz2 = h_ * system_rate(z2, x + (0.5 * h_)); 
-      const State kv2 = h_ * newton_rate(v2, z2, x + (0.5 * h_));
-       
-      auto z3 = z1 + 0.5 * kz2; 
-      auto v3 = v1 + 0.5 * kv2; 
-      const State kz3 = h_ * system_rate(z3, x + (0.5 * h_)); 
-      const State kv3 = h_ * newton_rate(v3, z3, x + (0.5 * h_));
-
-      auto z4 = z1 + kz3; 
-      auto v4 = v1 + kv3; 
-      const State kz4 = h_ * system_rate(z4, x + h_);
-      const State kv4 = h_ * newton_rate(v4, z4, x + h_);
-
-      z.push_back(z1 + (1.0 / 6.0) * (kz1 + 2.0 * kz2 + 2.0 * kz3 + kz4)); 
-      F.push_back(system_rate(z.back(), (x + h_)));  
-      v.push_back(v1 + (1.0 / 6.0) * (kv1 + 2.0 * kv2 + 2.0 * kv3 + kv4)); 
-      G.push_back(newton_rate(v.back(), z.back(), (x + h_)));
+/*
+ * One level of the refinement study: where its Newton iteration started, 
+ * how long it took and the boundary values it converged to 
+ */ 
+struct Level {
+  double h{0.0}; 
+  double guess{0.0}, from{0.0};   // from is the h the guess came from, 0 if cold 
+  double u{0.0}, yL{0.0}, ypL{0.0}; 
+  size_t iters{0}; 
+  double ms{0.0}; 
+}; 
+
+/*
+ * Refinement study over steps, coarsest first. Levels run concurrently on 
+ * the pool but are claimed in order, so the cheap coarse ones finish first, 
+ * and a level starts Newton from the converged slope of the finest coarser 
+ * level already done (the next-coarser grid whenever one worker runs them 
+ * all), falling back to guess while nothing coarser is 
+ */ 
+static std::vector<Level> 
+refine(const std::vector<double>& steps, const double guess, const double alpha, 
+       const double beta) 
+{
+  std::vector<Level> levels(steps.size()); 
+  std::vector<bool> done(steps.size(), false); 
+  std::mutex m; 
+  size_t next = 0; 
+  ThreadPool pool; 
+
+  // the pool may run tasks in any order, each one claims the next level 
+  pool.parallel_for(steps.size(), [&](size_t) {
+    size_t k = 0; 
+    Level lv; 
+    {
+      std::lock_guard<std::mutex> lock(m); 
+      k = next++; 
+      lv = {steps[k], guess}; 
+      for (size_t j = k; j-- > 0;) {
+        if ( done[j] ) {
+          lv.guess = levels[j].u; 
+          lv.from  = levels[j].h; 
+          break; 
+        }
+      }
+    }
+
+    const auto t0 = std::chrono::steady_clock::now(); 
+    Beam model(lv.guess, alpha, beta, lv.h); 
+    lv.u = model.run(); 
+    const auto end = model.end(); 
+    const auto t1 = std::chrono::steady_clock::now(); 
+
+    lv.h   = model.step(); 
+    lv.yL  = end[0]; 
+    lv.ypL = end[1]; 
+    lv.iters = model.iterations(); 
+    lv.ms = std::chrono::duration<double, std::milli>(t1 - t0).count(); 
+
+    std::lock_guard<std::mutex> lock(m); 
+    levels[k] = lv; 
+    done[k] = true; 
+  }); 
+  return levels; 
+}
+
+/*
+ * Richardson extrapolation of a 4th order quantity from step hc (coarse) 
+ * to hf (fine), 2^4 - 1 in the denominator when the steps halve 
+ */ 
+inline double 
+richardson(const double coarse, const double fine, const double hc, const double hf) 
+{
+  return fine + (fine - coarse) / (std::pow(hc / hf, 4.0) - 1.0); 
+}
+
+/************ benchmark ***********************************/
+/*
+ * ./shooting --bench [dx=1e-3,1e-4] [u0=0.25] [reps=3] 
+ * Newton shooting from u0 to convergence at each step size, nothing kept. 
+ * A step is one node of one shot, evals are lane batched rate calls and 
+ * only counted in -DINSTRUMENT builds 
+ */ 
+int 
+benchmark(int argc, char* argv[])
+{
+  try {
+    const bench::Args args(argc, argv); 
+    args.allow({"dx", "u0", "reps"}); 
+    const size_t reps = static_cast<size_t>(args.get("reps", 3)); 
+    const double u0 = args.get("u0", 0.25); 
+
+    for (double dx : args.list("dx", {1e-3, 1e-4})) {
+      Beam beam(u0, 0.0, 0.0, dx); 
+      bench::emit(bench::measure("beam_shooting", {{"dx", dx}, {"u0", u0}}, reps, [&]() {
+        const probe::Stats mark = probe::total(); 
+        beam.run(); 
+        return bench::Work{beam.iterations() * beam.nodes(), 
+                           (probe::total() - mark)[probe::RateEvals]}; 
+      })); 
     }
+  } catch (const std::exception& e) {
+    std::cerr << "invalid usage: ./shooting --bench [dx=...] [u0=u] [reps=n]: " << e.what() << '\n'; 
+    return 1; 
   }
-}; 
+  return 0; 
+}
 
-int main(void)
+int main(int argc, char* argv[])
 {
+  if ( argc > 1 && std::strcmp(argv[1], "--bench") == 0 ) {
+    return benchmark(argc, argv); 
+  }
+
+  // --richardson extrapolates the reference instead of running dx = 1e-5 
+  const bool extrapolate = ( argc > 1 && std::strcmp(argv[1], "--richardson") == 0 ); 
   const double L = 50.0; 
   const double alpha = 0.0, beta = 0.0; 
 
   // Preturb initial guess because y' = 0 is a trivial answer  
-  Beam sol(0.25, alpha, beta, 1e-3);
+  Beam sol(0.25, alpha, beta, 1e-3, 10);
 
   auto ustar = sol.run(); 
   std::cout << ustar << '\n'; 
 
-  auto& [z, v] = sol.z();
-  const auto& x = sol.x(); 
-  const double bu0 = z[0].yprime;
-  std::vector<double> y(x.size()), yp(x.size()); 
-  for (size_t i = 0; i < x.size(); i++) {
-    y[i]  = z[i].y;
-    yp[i] = z[i].yprime; 
+  // whole slope window at once: bracket in lockstep, then refine together 
+  const auto roots = sol.roots(-1.0, 1.0, 32); 
+  std::cout << roots.size() << " root(s) of the miss on [-1, 1]:"; 
+  for (auto& r : roots) {
+    std::cout << ' ' << r; 
   }
+  std::cout << '\n'; 
 
-  {
-    Gnuplot plt{}; 
+  const auto& z = sol.z();
+  const std::vector<double> x(sol.x().begin(), sol.x().end()); 
+  const std::vector<double> y(z.column(0).begin(), z.column(0).end()); 
+  const std::vector<double> yp(z.column(1).begin(), z.column(1).end()); 
+  const double bu0 = yp[0];
 
-    auto title = std::format("u0={:.4e}", bu0);
-    plt.redirect_to_png("deflection.png", "1200,1000");
-    plt.set_title("Beam Deflection using Newton's Shooting Method. Best: " + title); 
-    plt.set_xlabel("x [dx=1e-3]");
-    plt.set_ylabel("y & y' [m & dy/dx]");
+  using RQ = RenderQueue; 
+  auto& queue = RQ::instance(); 
+  auto title = std::format("u0={:.4e}", bu0);
 
-    plt.plot(x, y, "y(x)", Gnuplot::LineStyle::LINES);
-    plt.plot(x, yp, "y'(x)", Gnuplot::LineStyle::LINES);
-    plt.show();
-  }
+  queue.submit({"deflection.png", "1200,1000", "", {
+    RQ::Panel{"Beam Deflection using Newton's Shooting Method. Best: " + title, 
+              "x [dx=1e-3]", "y & y' [m & dy/dx]", {}, {}, RQ::Scale::Linear, {
+      {x, y, "y(x)"}, {x, yp, "y'(x)"}
+    }}
+  }});
 
   const auto& shots = sol.shots();  
   // Still using sol.x() 
 
-  {
-    Gnuplot plt{}; 
-
-    auto title = std::format("u0={:.4e}", bu0);
-    plt.redirect_to_png("traj_error.png", "1200,1000");
-    plt.set_title("Global Error of Each Trajectory from best: " + title);
-    plt.set_xlabel("x [dx=1e-3]"); 
-    plt.set_ylabel("y [m]"); 
-    plt.set_logscale(Gnuplot::AxisScale::LOGY);
-
-    for (const auto& shot : shots) { 
-      const double u0 = shot[0].yprime;
-      if ( u0 == bu0 ) {
-        continue; 
-      } // skip reference/correct point 
-
-      std::vector<double> y(x.size()), err(x.size()); 
-      for (size_t i = 0; i < x.size() - 1; i++) {
-        y[i]   = shot[i].y;
-        err[i] = y[i] - z[i].y;
-      }
+  RQ::Panel traj{"Global Error of Each Trajectory from best: " + title, 
+                 "x [dx=1e-3]", "y [m]", {}, {}, RQ::Scale::LogY}; 
+
+  for (const auto& shot : shots) { 
+    const double u0 = shot.u0;
+    if ( u0 == bu0 || RQ::headless() ) {
+      continue; 
+    } // skip reference/correct point 
 
-      auto label = std::format("u0={:.4e}", u0);
-      plt.plot(x, err, label, Gnuplot::LineStyle::LINES);
+    // shots are decimated, compare at the nodes they kept 
+    std::vector<double> err(shot.x.size()); 
+    for (size_t i = 0; i < shot.x.size(); i++) {
+      const size_t k = std::min(y.size() - 1, static_cast<size_t>(std::lround(shot.x[i] / 1e-3))); 
+      err[i] = shot.y[i] - y[k];
     }
-    plt.show();
+
+    auto label = std::format("u0={:.4e}", u0);
+    traj.series.push_back({shot.x, std::move(err), label});
   }
+  queue.submit({"traj_error.png", "1200,1000", "", {std::move(traj)}}); 
   
   std::vector<double> stepsizes(16); 
   for (size_t i = 0; i < stepsizes.size() - 1; i++) {
@@ -323,54 +538,73 @@ int main(void)
   }
   stepsizes.back() = 1e-5; 
 
+  if ( extrapolate ) {
+    stepsizes.pop_back(); 
+  }
+
   std::vector<double> trailing_y; trailing_y.reserve(stepsizes.size() - 1);
   std::vector<double> trailing_p; trailing_p.reserve(stepsizes.size() - 1);
   std::vector<double> inverse; inverse.reserve(stepsizes.size() - 1);  
 
   {
-    Gnuplot plt{}; 
-
-    plt.redirect_to_png("convergence.png", "1200,1000");
-    plt.set_title("Convergence of 4th order A-B/A-M Predictor-Corrector Scheme"); 
-    plt.set_xlabel("1/dx [m^-1]"); 
-    plt.set_ylabel("relative error at boundary x=L");
-    plt.set_logscale(Gnuplot::AxisScale::LOGXY); 
-
-    double exact_y = 0.0, exact_yp;  
-    for (const auto& dx : stepsizes) {
-      auto model = Beam(0.25, alpha, beta, dx);  
-      model.run(); 
-
-      const auto [z, _] = model.z(); 
-      const auto [yL, ypL] = z.back(); 
-
-      if ( dx != stepsizes.back() ) {
-        trailing_y.push_back(yL);
-        trailing_p.push_back(ypL);
-        inverse.push_back(1.0/dx);
-      } else {
-        exact_y  = yL; 
-        exact_yp = ypL;  
-      } 
+    const auto t0 = std::chrono::steady_clock::now(); 
+    const auto levels = refine(stepsizes, roots.back(), alpha, beta); 
+    const auto t1 = std::chrono::steady_clock::now(); 
+
+    std::cout << std::format("{:>9} {:>8} {:>9} {:>10} {:>8} {:>15} {:>15}\n", "dx", "n", 
+                             "warm from", "iters", "ms", "y(L)", "y'(L)"); 
+    for (const auto& lv : levels) {
+      std::cout << std::format("{:9.2e} {:8} {:9.2e} {:10} {:8.3f} {:15.7e} {:15.7e}\n", 
+                               lv.h, static_cast<size_t>(std::round(L / lv.h)), lv.from, 
+                               lv.iters, lv.ms, lv.yL, lv.ypL); 
+    }
+    std::cout << std::format("study wall time {:.3f} ms\n", 
+                             std::chrono::duration<double, std::milli>(t1 - t0).count()); 
+
+    // the two finest levels halve h, extrapolate them to h -> 0 
+    const Level& fine = levels[levels.size() - ( extrapolate ? 1 : 2 )]; 
+    const Level& coarse = levels[levels.size() - ( extrapolate ? 2 : 3 )]; 
+    const double rich_y = richardson(coarse.yL, fine.yL, coarse.h, fine.h); 
+    const double rich_yp = richardson(coarse.ypL, fine.ypL, coarse.h, fine.h); 
+
+    double exact_y = rich_y, exact_yp = rich_yp;  
+    if ( !extrapolate ) {
+      exact_y  = levels.back().yL; 
+      exact_yp = levels.back().ypL; 
+      std::cout << std::format("richardson y'(L) {:.10e}, dx = 1e-5 run {:.10e}\n", 
+                               rich_yp, exact_yp); 
+    } else {
+      std::cout << std::format("richardson reference y(L) {:.10e} y'(L) {:.10e}\n", 
+                               rich_y, rich_yp); 
+    }
+
+    for (size_t k = 0; k < levels.size() - ( extrapolate ? 0 : 1 ); k++) {
+      trailing_y.push_back(levels[k].yL);
+      trailing_p.push_back(levels[k].ypL);
+      inverse.push_back(1.0 / levels[k].h);
     }
 
     std::transform(trailing_y.begin(), trailing_y.end(), trailing_y.begin(), 
       [&](double el) { 
-        return std::abs(el - exact_y) / std::abs(exact_y); 
+        return std::max(std::abs(el - exact_y) / std::abs(exact_y), 1e-16); 
     }); 
 
     std::transform(trailing_p.begin(), trailing_p.end(), trailing_p.begin(), 
       [&](double el) { 
-        return std::abs(el - exact_yp) / std::abs(exact_yp); 
+        return std::max(std::abs(el - exact_yp) / std::abs(exact_yp), 1e-16); 
     }); 
 
-    plt.plot(inverse, trailing_y, "rel error y(x)", Gnuplot::LineStyle::LINES);
-    plt.plot(inverse, trailing_p, "rel error y'(x)", Gnuplot::LineStyle::LINES);
-
-    plt.set_xrange(inverse.front(), inverse.back());
-    plt.set_yrange(std::min(trailing_y.back(), trailing_p.back()),
-                   std::max(trailing_y.front(), trailing_p.front()));
-    plt.show();
+    queue.submit({"convergence.png", "1200,1000", "", {
+      RQ::Panel{"Convergence of 4th order A-B/A-M Predictor-Corrector Scheme", 
+                "1/dx [m^-1]", "relative error at boundary x=L", 
+                std::pair{inverse.front(), inverse.back()}, 
+                std::pair{std::min(trailing_y.back(), trailing_p.back()), 
+                          std::max(trailing_y.front(), trailing_p.front())}, 
+                RQ::Scale::LogXY, {
+        {inverse, trailing_y, "rel error y(x)"}, 
+        {inverse, trailing_p, "rel error y'(x)"}
+      }}
+    }});
   } 
 
   return 0; 
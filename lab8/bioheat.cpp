@@ -0,0 +1,248 @@
+/*
+ * bioheat.cpp  Andrew Belles
+ *
+ * Method of lines port of bioheat_pde.py. The interior nodes of the bioheat
+ * equation become a stiff linear system that the shared implicit steppers
+ * march from the initial state to steady state: Crank-Nicolson at the
+ * prototype's dt, and BDF2 at a step limited only by accuracy. Both reuse
+ * one factored Newton matrix for the whole run. The system is tridiagonal,
+ * so a native Crank-Nicolson on banded.hpp factors I - dt/2 A once and
+ * marches by Thomas sweeps, and the steady state itself is one direct solve
+ * (Thomas and cyclic reduction, which must agree)
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <gplot++.h>
+
+#include "../common/integrate.hpp"
+#include "../common/banded.hpp"
+#include "../common/implicit.hpp"
+#include "../common/render.hpp"
+
+/*
+ * Constants of the prototype. As there, dx = L / N for N interior nodes
+ * placed on linspace(0, L, N + 2)
+ */
+struct Bioheat {
+  static constexpr double L       = 1.0;
+  static constexpr double SIG     = 100.0;
+  static constexpr double GAMMA   = -1.0 / L;
+  static constexpr double CORE    = 37.0;
+  static constexpr double SURFACE = 32.0;
+  static constexpr double ARTERY  = CORE;
+  static constexpr double BCLEFT  = CORE - ARTERY;
+  static constexpr double BCRIGHT = SURFACE - ARTERY;
+  static constexpr double EPS     = 1e-12;
+  inline static const double LAMBDSQ = std::sqrt(2.7);
+};
+
+/*
+ * u_t = u_xx - lambda^2 u + sigma e^{gamma (L - x)} on N interior nodes with
+ * the Dirichlet values folded into the source
+ */
+template<size_t N>
+class Model {
+public:
+  using State = ode::Vec<N>;
+
+  Model() : dx2_((Bioheat::L / N) * (Bioheat::L / N))
+  {
+    for (size_t i = 0; i < N; i++) {
+      x_[i] = Bioheat::L * static_cast<double>(i + 1) / static_cast<double>(N + 1);
+      src_[i] = Bioheat::SIG * std::exp(Bioheat::GAMMA * (Bioheat::L - x_[i]));
+    }
+    src_[0]     += Bioheat::BCLEFT / dx2_;
+    src_[N - 1] += Bioheat::BCRIGHT / dx2_;
+  }
+
+  State
+  operator()(double, const State& u) const
+  {
+    State r;
+    for (size_t i = 0; i < N; i++) {
+      const double left  = ( i > 0 ) ? u[i - 1] : 0.0;
+      const double right = ( i + 1 < N ) ? u[i + 1] : 0.0;
+      r[i] = (left - 2.0 * u[i] + right) / dx2_ - Bioheat::LAMBDSQ * u[i] + src_[i];
+    }
+    return r;
+  }
+
+  const State& x() const { return x_; }
+  const State& source() const { return src_; }
+
+  // bands of the operator u -> u_xx - lambda^2 u
+  void
+  bands(std::vector<double>& a, std::vector<double>& b, std::vector<double>& c) const
+  {
+    a.assign(N, 1.0 / dx2_);
+    b.assign(N, -2.0 / dx2_ - Bioheat::LAMBDSQ);
+    c.assign(N, 1.0 / dx2_);
+    a[0] = 0.0;
+    c[N - 1] = 0.0;
+  }
+
+private:
+  double dx2_{1.0};
+  State x_{}, src_{};
+};
+
+/*
+ * Crank-Nicolson on the tridiagonal operator directly, (I - dt/2 A) u' =
+ * (I + dt/2 A) u + dt s. The left side is factored on the first step and
+ * again only if dt changes
+ */
+template<size_t N>
+class TridiagonalCN {
+public:
+  explicit TridiagonalCN(const Model<N>& model) : model_(model)
+  {
+    model.bands(a_, b_, c_);
+  }
+
+  void
+  step(double, ode::Vec<N>& u, double dt)
+  {
+    if ( dt != dt_ ) {
+      std::vector<double> a(N), b(N), c(N);
+      for (size_t i = 0; i < N; i++) {
+        a[i] = -0.5 * dt * a_[i];
+        b[i] = 1.0 - 0.5 * dt * b_[i];
+        c[i] = -0.5 * dt * c_[i];
+      }
+      lhs_.factor(a, b, c);
+      dt_ = dt;
+      factorizations_++;
+    }
+
+    band::apply(a_, b_, c_, std::span<const double>(u.v, N), rhs_);
+    for (size_t i = 0; i < N; i++) {
+      rhs_[i] = u[i] + 0.5 * dt * rhs_[i] + dt * model_.source()[i];
+    }
+    lhs_.solve(rhs_);
+    std::copy(rhs_.begin(), rhs_.end(), u.v);
+  }
+
+  size_t factorizations() const { return factorizations_; }
+
+private:
+  const Model<N>& model_;
+  std::vector<double> a_{}, b_{}, c_{}, rhs_ = std::vector<double>(N);
+  band::Tridiagonal lhs_{};
+  double dt_{0.0};
+  size_t factorizations_{0};
+};
+
+struct Run {
+  std::string scheme;
+  double dt{0.0}, t{0.0};
+  size_t steps{0}, evals{0}, jacobians{0}, factorizations{0};
+  std::vector<double> u{};
+};
+
+/*
+ * Steps until no node moves by more than EPS in one step, the prototype's
+ * steady state criterion
+ */
+template<typename Stepper, size_t N>
+static Run
+steady(const std::string& scheme, Stepper& st, const double dt)
+{
+  ode::Vec<N> u;
+  std::fill(u.v, u.v + N, -5.0);
+
+  Run run{scheme, dt};
+  while ( true ) {
+    const ode::Vec<N> prev = u;
+    st.step(run.t, u, dt);
+    run.t += dt;
+    run.steps++;
+
+    double delta = 0.0;
+    for (size_t i = 0; i < N; i++) {
+      delta = std::max(delta, std::abs(u[i] - prev[i]));
+    }
+    if ( delta < Bioheat::EPS ) {
+      break;
+    }
+  }
+
+  run.u.assign(u.v, u.v + N);
+  return run;
+}
+
+template<size_t N>
+static void
+solve(RenderQueue::Panel* panel)
+{
+  const Model<N> model;
+  ode::CrankNicolson<ode::Vec<N>, Model<N>> cn(model);
+  ode::BDF<ode::Vec<N>, Model<N>, 2> bdf(model);
+
+  TridiagonalCN<N> tri(model);
+
+  Run runs[3] = {steady<decltype(cn), N>("cn", cn, 1e-3), steady<decltype(bdf), N>("bdf2", bdf, 2e-2),
+                 steady<decltype(tri), N>("cntri", tri, 1e-3)};
+  runs[0].evals = cn.evals();
+  runs[0].jacobians = cn.newton().jacobians();
+  runs[0].factorizations = cn.newton().factorizations();
+  runs[1].evals = bdf.newton().evals();
+  runs[1].jacobians = bdf.newton().jacobians();
+  runs[1].factorizations = bdf.newton().factorizations();
+  runs[2].factorizations = tri.factorizations();
+
+  // A u = -s directly, by Thomas and by cyclic reduction
+  std::vector<double> a, b, c, direct(N), reduced(N);
+  model.bands(a, b, c);
+  for (size_t i = 0; i < N; i++) {
+    direct[i] = -model.source()[i];
+  }
+  reduced = direct;
+  band::Tridiagonal(a, b, c).solve(direct);
+  band::cyclic_reduction(a, b, c, reduced);
+
+  for (auto& r : runs) {
+    double diff = 0.0;
+    for (size_t i = 0; i < N; i++) {
+      diff = std::max(diff, std::abs(r.u[i] - direct[i]));
+    }
+    std::printf("%5zu %-5s %8.1e %8zu %9zu %5zu %5zu %8.3f %10.3e\n", N, r.scheme.c_str(), r.dt,
+                r.steps, r.evals, r.jacobians, r.factorizations, r.t, diff);
+  }
+
+  double split = 0.0;
+  for (size_t i = 0; i < N; i++) {
+    split = std::max(split, std::abs(direct[i] - reduced[i]));
+  }
+  std::printf("%5zu max |thomas - cyclic reduction| %.3e\n", N, split);
+
+  if ( panel ) {
+    std::vector<double> x(model.x().v, model.x().v + N);
+    for (auto& r : runs) {
+      panel->series.push_back({x, r.u, r.scheme});
+    }
+  }
+}
+
+int main(void)
+{
+  RenderQueue::Panel panel{"Bioheat Steady-State Solution", "x [m]", "temperature [C]",
+                           std::pair{0.0, Bioheat::L}};
+
+  std::printf("%5s %-5s %8s %8s %9s %5s %5s %8s %10s\n", "N", "mode", "dt", "steps", "evals",
+              "jac", "lu", "t", "|u - A\\s|");
+  solve<5>(nullptr);
+  solve<10>(nullptr);
+  solve<20>(nullptr);
+  solve<40>(nullptr);
+  solve<80>(nullptr);
+  solve<160>(nullptr);
+  solve<320>(&panel);
+
+  RenderQueue::instance().submit({"bioheat-steadystate.png", "1200,700", "", {panel}});
+  return 0;
+}
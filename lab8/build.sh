@@ -0,0 +1,6 @@
+#!/usr/bin/bash 
+
+rm -f *.o bioheat relax
+
+g++ -std=c++20 -O3 -march=native -pthread bioheat.cpp -o bioheat -lm 
+g++ -std=c++20 -O3 -march=native -pthread relax.cpp -o relax -lm 
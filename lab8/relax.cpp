@@ -0,0 +1,126 @@
+/*
+ * relax.cpp  Andrew Belles
+ *
+ * Port of gauseid_bioheat.py onto the shared multigrid engine. The
+ * homogeneous bioheat steady state, -u'' + lambda^2 u = 0 with the core
+ * and surface temperatures at the ends, is solved on N = 2^k - 1 interior
+ * nodes (h = L / (N + 1) as in the prototype) by red-black SOR at the
+ * Theorem 7.26 relaxation, by multigrid V-cycles and by V-cycle
+ * preconditioned CG. The residual histories replace the prototype's
+ * spectral radius bookkeeping: their mean contraction is printed per N and
+ * the histories at the finest grid are plotted
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <gplot++.h>
+
+#include "../common/multigrid.hpp"
+#include "../common/pool.hpp"
+#include "../common/render.hpp"
+
+struct Bioheat {
+  static constexpr double L       = 1.0;
+  static constexpr double CORE    = 37.0;
+  static constexpr double SURFACE = 32.0;
+  static constexpr double ARTERY  = CORE;
+  static constexpr double BCLEFT  = CORE - ARTERY;
+  static constexpr double BCRIGHT = SURFACE - ARTERY;
+  static constexpr double TOL     = 1e-12;
+  static constexpr size_t MAXITER = 100000;
+  inline static const double LAMBDSQ = std::sqrt(2.7);
+};
+
+struct Result {
+  std::string method;
+  mg::History hist{};
+  double error{0.0}, ms{0.0};
+};
+
+// sinh profile of the prototype's compute_analytic_()
+static double
+analytic(double x)
+{
+  const double k = std::sqrt(Bioheat::LAMBDSQ);
+  return (Bioheat::SURFACE - Bioheat::CORE) * std::sinh(k * x) / std::sinh(k * Bioheat::L);
+}
+
+template<typename Method>
+static Result
+run(const std::string& name, const mg::Grid<1>& g, const std::vector<double>& f, Method&& method)
+{
+  std::vector<double> u(g.length(), 0.0);
+  const auto t0 = std::chrono::steady_clock::now();
+  Result res{name, method(u, f)};
+  const auto t1 = std::chrono::steady_clock::now();
+  res.ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+  for (size_t i = 1; i <= g.n[0]; i++) {
+    res.error = std::max(res.error, std::abs(u[i] - analytic(static_cast<double>(i) * g.h[0])));
+  }
+  return res;
+}
+
+static std::vector<Result>
+solve(size_t N, ThreadPool& pool)
+{
+  mg::Grid<1> g;
+  g.n[0] = N;
+  g.h[0] = Bioheat::L / static_cast<double>(N + 1);
+  g.kappa = Bioheat::LAMBDSQ;
+
+  // the Dirichlet values move to the right hand side
+  std::vector<double> f(g.length(), 0.0);
+  f[1] += Bioheat::BCLEFT / (g.h[0] * g.h[0]);
+  f[N] += Bioheat::BCRIGHT / (g.h[0] * g.h[0]);
+
+  mg::Options opt;
+  opt.tol = Bioheat::TOL;
+  opt.maxiter = Bioheat::MAXITER;
+  opt.pool = &pool;
+  mg::Solver<1> solver(g, opt);
+
+  std::vector<Result> out;
+  out.push_back(run("rbsor", g, f, [&](auto& u, auto& b) { return solver.sor(u, b); }));
+  out.push_back(run("vcycle", g, f, [&](auto& u, auto& b) { return solver.vcycles(u, b); }));
+  out.push_back(run("mgpcg", g, f, [&](auto& u, auto& b) { return solver.pcg(u, b); }));
+
+  for (auto& r : out) {
+    std::printf("%5zu %3zu %-7s %7zu %9.5f %10.3e %10.3f %s\n", N, solver.levels(),
+                r.method.c_str(), r.hist.iterations, r.hist.rate(), r.error, r.ms,
+                r.hist.converged ? "" : "(not converged)");
+  }
+  std::printf("%5zu     omega %.6f, predicted sor contraction %.5f\n", N,
+              solver.optimal_omega(g), solver.optimal_omega(g) - 1.0);
+  return out;
+}
+
+int main(void)
+{
+  ThreadPool pool;
+  const size_t nodes[] = {7, 15, 31, 63, 127, 255, 511};
+
+  std::printf("%5s %3s %-7s %7s %9s %10s %10s\n", "N", "lvl", "method", "iters", "rate",
+              "max err", "ms");
+  std::vector<Result> finest;
+  for (size_t N : nodes) {
+    finest = solve(N, pool);
+  }
+
+  RenderQueue::Panel panel{"Residual history at N = 511", "iteration", "||f - Au|| / ||f||"};
+  panel.scale = RenderQueue::Scale::LogY;
+  for (auto& r : finest) {
+    std::vector<double> k(r.hist.residual.size());
+    for (size_t i = 0; i < k.size(); i++) {
+      k[i] = static_cast<double>(i);
+    }
+    panel.series.push_back({k, r.hist.residual, r.method});
+  }
+  RenderQueue::instance().submit({"residual-history.png", "1200,700", "", {panel}});
+  return 0;
+}
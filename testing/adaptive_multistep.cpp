@@ -3,26 +3,46 @@
  *
  * Testing idea for adaptive timestep on multistep methods 
  * that ignores recomputating rate functions 
+ * ./ode --bench [h=...] [tf=...] [mode=...] [reps=n] times MultiOde34::run() 
  *
  */ 
 
 #include <functional> 
 #include <string>
+#include <span>
 #include <vector> 
+#include <cstdio> 
 #include <cstdlib> 
+#include <cstdint> 
+#include <cstring> 
 #include <cmath> 
 #include <algorithm> 
 #include <gplot++.h> 
 
+#include "../common/bench.hpp"
+#include "../common/integrate.hpp"
+#include "../common/render.hpp"
+
 /*
  * Implementation of adaptive time step for multi-step method 
  * using 3rd and 4th order differences 
  *
- * Implements Adams-Bashforth Three and Four-Step Methods 
+ * Implements Adams-Bashforth Three and Four-Step Methods, and for 
+ * comparison the shared adaptive engines: variable order Adams continued 
+ * from the same seeded history, and Dormand-Prince from its last node 
  *
  */ 
 class MultiOde34 {
+  using Rate = std::function<double(double, const double&)>; 
+
 public: 
+  enum class Mode : int8_t {
+    Fixed,          // A-B 4 at h 
+    Difference,     // A-B 4, step from the 3rd/4th order rate difference 
+    Adams,          // variable step, variable order Adams PECE 
+    DormandPrince   // embedded RK45 with PI control 
+  };
+
   const std::string tag; 
   
   MultiOde34(
@@ -31,12 +51,14 @@ public:
       const std::vector<double>& t0, 
       const std::vector<double>& y0, 
       const double& h = 1e-4,
-      const bool& adaptive = false
-  ) : tag(tag_str), rate_(fn), h_(h), adapt_(adaptive) 
+      const Mode& mode = Mode::Fixed
+  ) : tag(tag_str), h_(h), mode_(mode), 
+      ab_(ode::AB4, counted_(fn)), 
+      va_(counted_(fn), {tol, tol}), 
+      dp_(counted_(fn), {tol, tol}) 
   {
     w_.reserve(4); 
     t_.reserve(4); 
-    f_.reserve(4); 
     q_.reserve(4);
 
     if ( y0.size() != 4 ) {
@@ -52,33 +74,62 @@ public:
       double ti = t0[0] + static_cast<double>(i) * h_; 
       w_.push_back(y0[i]); 
       t_.push_back(ti);
-      f_.push_back(rate_(y0[i]));
       q_.push_back(h_);
+      if ( mode_ == Mode::Adams ) {
+        va_.seed(ti, y0[i]); 
+      } else if ( mode_ != Mode::DormandPrince ) {
+        ab_.seed(ti, y0[i]);
+      }
     }
     tf_ = t0.back();
   }
 
+  // rate functions are bound to this instance's evaluation counter 
+  MultiOde34(const MultiOde34&) = delete; 
+  MultiOde34& operator=(const MultiOde34&) = delete; 
+
   /*
-   * Computes the A-B fourth order approximation of the ODE using 
-   * the given rate function 
+   * Computes the approximation of the ODE using the given rate function. 
+   * Sorted sample times in [t().back(), tf] are filled from dense output 
+   * (Hermite on the rate ring for the fixed step modes) into samples() 
    */ 
-  void run() 
+  void run(std::span<const double> samples = {}) 
   {
-    double ti = t_.back();
+    s_.assign(samples.size(), 0.0); 
+
+    if ( mode_ == Mode::Adams ) {
+      va_.start(h_); 
+      adaptive_(va_, samples); 
+      return; 
+    } 
+    if ( mode_ == Mode::DormandPrince ) {
+      dp_.start(t_.back(), w_.back(), h_); 
+      adaptive_(dp_, samples); 
+      return; 
+    }
+
+    double ti = t_.back(), wi = w_.back();
+    size_t k = 0; 
+    while ( k < samples.size() && samples[k] <= ti ) {
+      s_[k++] = wi; 
+    }
 
     while ( ti < tf_ ) {
-      // Slice fi through fi-3 
-      const std::vector<double> fs(f_.end() - 4, f_.end()); 
-      // Get appropriate timestep 
-      const double qh = next_q_(ti, fs); 
-      ti += qh; 
+      // Get appropriate timestep from the last four rates 
+      const double qh = next_q_(ti, ab_.rates()); 
+      const double tp = ti, wp = wi, fp = ab_.rates()[0];
       
-      // Compute next predicted value, push new values into vectors, get next rate func
-      const double N = 55.0 * fs[3] - 59.0 * fs[2] + 37.0 * fs[1] - 9.0 * fs[0]; 
-      w_.push_back(w_.back() + (qh / 24.0 * N)); 
+      // shared A-B 4 step, its ring holds the rates fi through fi-3 
+      ab_.step(ti, wi, qh); 
+      ti += qh; 
+      w_.push_back(wi); 
       t_.push_back(ti);
       q_.push_back(qh);
-      f_.push_back(rate_(w_.back()));
+
+      while ( k < samples.size() && samples[k] <= ti ) {
+        s_[k] = ode::hermite(tp, wp, fp, ti, wi, ab_.rates()[0], samples[k]); 
+        k++; 
+      }
     }
   }
 
@@ -95,72 +146,85 @@ public:
       n[i] = i + 1; 
     }
 
-    {
-      Gnuplot plt{}; 
-
-      plt.redirect_to_png(tag + "_computed_vs_exact.png", "1200,700");
-      plt.set_title(title);
-      plt.set_xlabel("t");
-      plt.set_ylabel("y");
-      plt.plot(t_, w_, "A-B", Gnuplot::LineStyle::LINES);
-      plt.plot(t_, y, "exact", Gnuplot::LineStyle::LINES); 
-      plt.show();
-    }
-
-    {
-      Gnuplot plt{}; 
-
-      plt.redirect_to_png(tag + "_error.png", "1200,700");
-      plt.set_title("Error Plot");
-      plt.set_xlabel("t");
-      plt.set_ylabel("|w - y|");
-      plt.set_logscale(Gnuplot::AxisScale::LOGY);
-      plt.plot(t_, error, "error", Gnuplot::LineStyle::LINES); 
-      plt.show(); 
-    }
-
-    {
-      Gnuplot plt{}; 
-
-      plt.redirect_to_png(tag + "_qh_over_time.png", "1200,700");
-      plt.set_title("qh value over time"); 
-      plt.set_xlabel("iter");
-      plt.set_ylabel("qh"); 
-      plt.set_xrange(1, n.back());
-      plt.set_logscale(Gnuplot::AxisScale::LOGY); 
-      plt.plot(n, q_, "qh", Gnuplot::LineStyle::LINES);
-      plt.show(); 
-    }
+    using RQ = RenderQueue; 
+    auto& queue = RQ::instance(); 
+
+    queue.submit({tag + "_computed_vs_exact.png", "1200,700", "", {
+      RQ::Panel{title, "t", "y", {}, {}, RQ::Scale::Linear, {
+        {t_, w_, "A-B"}, {t_, y, "exact"}
+      }}
+    }});
+
+    queue.submit({tag + "_error.png", "1200,700", "", {
+      RQ::Panel{"Error Plot", "t", "|w - y|", {}, {}, RQ::Scale::LogY, {
+        {t_, std::move(error), "error"}
+      }}
+    }});
+
+    queue.submit({tag + "_qh_over_time.png", "1200,700", "", {
+      RQ::Panel{"qh value over time", "iter", "qh", std::pair{1.0, n.back()}, {}, 
+                RQ::Scale::LogY, {{std::move(n), q_, "qh"}}}
+    }});
   }
 
   const std::vector<double>& w() { return w_; }
   const std::vector<double>& t() { return t_; }
   const std::vector<double>& q() { return q_; }
+  const std::vector<double>& samples() { return s_; }
+  size_t evals() const { return evals_; }
 
 private: 
   int lock{4};
   std::vector<double> t_{}; // time vector  
   std::vector<double> w_{}; // our solution
-  std::vector<double> f_{}; // rate function at i 
   std::vector<double> q_{}; // tracked adaptive q value per frame 
-  bool adapt_{false};       // whether to modify h per step  
-  const std::function<double(double)> rate_; // some rate function to solve  
+  std::vector<double> s_{}; // dense output at the requested samples 
   double tf_{0.0};           // final time value  
   double h_{0.0};
+  Mode mode_{Mode::Fixed};  // how h is chosen per step 
+  size_t evals_{0};         // rate evaluations over every engine 
+  ode::AdamsBashforth<double, 4, Rate> ab_; // last four rate evaluations 
+  ode::VariableAdams<double, Rate> va_; 
+  ode::DormandPrince<double, Rate> dp_; 
 
 /************ private methods ******************************/ 
+  Rate counted_(const std::function<double(double)>& fn)
+  {
+    return [this, fn](double, const double& y) { evals_++; return fn(y); }; 
+  }
+
+  /*
+   * Steps an adaptive engine to tf, recording every accepted node and the 
+   * dense output at the samples 
+   */ 
+  template<typename Stepper> 
+  void adaptive_(Stepper& st, std::span<const double> samples)
+  {
+    auto keep = [this](size_t i, double, const double& y) { s_[i] = y; }; 
+    ode::Sample<decltype(keep)> dense(samples, keep); 
+
+    ode::integrate_adaptive(st, tf_, [&](const Stepper& s) {
+      dense(s); 
+      if ( s.t() > t_.back() ) {
+        q_.push_back(s.t() - t_.back()); 
+        t_.push_back(s.t()); 
+        w_.push_back(s.y()); 
+      }
+    });
+  }
+
   /*
    * Computes the next value q to adapt timestep  
    *
    */ 
-  inline double next_q_(const double& ti, const std::vector<double>& fs) 
+  inline double next_q_(const double& ti, const ode::Ring<double, 4>& r) 
   {
-    if ( !adapt_ ) {
+    if ( mode_ != Mode::Difference ) {
       return h_; 
     }
 
     const double qhprev = q_.back(); 
-    const double order_difference = -a * fs[3] + b * fs[2] - b * fs[1] + a * fs[0];  
+    const double order_difference = -a * r[0] + b * r[1] - b * r[2] + a * r[3];  
     double qh = tol * h_ / std::abs(order_difference);   
     qh = std::min(qh, hceil); // clamp to hceil 
 
@@ -195,41 +259,114 @@ static double easy_rate(const double& y);
 static double hard_exact(const double& t);
 static double hard_rate(const double& y); 
 
-int main(void)
+/*
+ * Runs every adaptive mode on one problem, reports steps, rate evaluations 
+ * and the worst error at the nodes and on a uniform dense sample grid 
+ */ 
+static void 
+compare(const std::string& tag, double (*rate)(const double&), double (*exact)(const double&), 
+        const std::vector<double>& t0, const std::vector<double>& y0)
 {
-  const std::vector<double> t0 = {0.0, 2.5}; 
-  const std::vector<double> ey0 = {
-    easy_exact(0), easy_exact(1e-4), easy_exact(2.0 * 1e-4), easy_exact(3.0 * 1e-4)
+  using Mode = MultiOde34::Mode; 
+  const std::pair<Mode, std::string> modes[3] = {
+    {Mode::Difference, "diff"}, {Mode::Adams, "adams"}, {Mode::DormandPrince, "dopri"}
   };
 
-  const std::vector<double> hy0 = {
-    hard_exact(0), hard_exact(1e-4), hard_exact(2.0 * 1e-4), hard_exact(3.0 * 1e-4)
-  };
+  std::vector<double> grid(1000); 
+  const double g0 = t0[0] + 3.0 * 1e-4; 
+  for (size_t i = 0; i < grid.size(); i++) {
+    grid[i] = g0 + (t0.back() - g0) * static_cast<double>(i) / (grid.size() - 1.0);
+  }
 
-  std::vector<double> ey; 
-  std::vector<double> hy; 
+  std::printf("%s\n  %-6s %8s %8s %12s %12s\n", tag.c_str(), "mode", "steps", "evals", 
+              "node err", "dense err"); 
+  for (auto& [mode, name] : modes) {
+    MultiOde34 solver(tag + "_" + name, rate, t0, y0, 1e-4, mode);
+    solver.run(grid); 
+
+    auto& t = solver.t(); 
+    std::vector<double> y; 
+    y.reserve(t.size());
+    double node = 0.0, dense = 0.0; 
+    for (size_t i = 0; i < t.size(); i++) {
+      y.push_back(exact(t[i]));
+      node = std::max(node, std::abs(y[i] - solver.w()[i])); 
+    }
+    for (size_t i = 0; i < grid.size(); i++) {
+      dense = std::max(dense, std::abs(exact(grid[i]) - solver.samples()[i])); 
+    }
 
-  MultiOde34 easy_solver("exp", easy_rate, t0, ey0, 1e-4, true);
-  easy_solver.run(); 
+    std::printf("  %-6s %8zu %8zu %12.3e %12.3e\n", name.c_str(), t.size() - 4, 
+                solver.evals(), node, dense); 
+    solver.plot("Adaptive " + name + " against exact", y); 
+  }
+}
 
-  auto& et = easy_solver.t(); 
-  ey.reserve(et.size());
-  for (auto& ti : et) {
-    ey.push_back(easy_exact(ti));
+/*
+ * ./ode --bench [h=1e-4] [tf=2.5] [mode=0,1,2,3] [reps=5] 
+ * Both problems in every requested mode (0 fixed, 1 difference, 2 adams, 
+ * 3 dopri) seeded with exact values at spacing h. The solver is built inside 
+ * the timed region since run() consumes its history. A step is one accepted 
+ * node, evals count every rate call including the seeding 
+ */ 
+static int 
+benchmark(int argc, char* argv[])
+{
+  using Mode = MultiOde34::Mode; 
+  const char* names[4] = {"fixed", "diff", "adams", "dopri"}; 
+  const std::pair<std::string, std::pair<double (*)(const double&), double (*)(const double&)>> 
+    problems[2] = {{"exp", {easy_rate, easy_exact}}, {"logistic", {hard_rate, hard_exact}}}; 
+
+  try {
+    const bench::Args args(argc, argv); 
+    args.allow({"h", "tf", "mode", "reps"}); 
+    const size_t reps = static_cast<size_t>(args.get("reps", 5)); 
+    const double tf = args.get("tf", 2.5); 
+
+    for (double h : args.list("h", {1e-4})) {
+      for (double m : args.list("mode", {0, 1, 2, 3})) {
+        const size_t mi = static_cast<size_t>(m); 
+        if ( mi > 3 ) {
+          throw std::invalid_argument("mode must be 0..3"); 
+        }
+        for (auto& [tag, fns] : problems) {
+          auto [rate, exact] = fns; 
+          const std::vector<double> t0 = {0.0, tf}; 
+          const std::vector<double> y0 = {exact(0.0), exact(h), exact(2.0 * h), exact(3.0 * h)}; 
+          bench::emit(bench::measure("multiode34_" + tag + "_" + names[mi], 
+                                     {{"h", h}, {"tf", tf}, {"mode", m}}, reps, [&]() {
+            MultiOde34 solver(tag, rate, t0, y0, h, static_cast<Mode>(mi)); 
+            solver.run(); 
+            return bench::Work{solver.t().size() - 4, solver.evals()}; 
+          })); 
+        }
+      }
+    }
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "invalid usage: ./ode --bench [h=...] [tf=t] [mode=...] [reps=n]: %s\n", 
+                 e.what()); 
+    return 1; 
   }
+  return 0; 
+}
 
-  easy_solver.plot("Adam-Bashforth 4-Step with Adaptive Timestep", ey); 
+int main(int argc, char* argv[])
+{
+  if ( argc > 1 && std::strcmp(argv[1], "--bench") == 0 ) {
+    return benchmark(argc, argv); 
+  }
 
-  MultiOde34 hard_solver("logistic", hard_rate, t0, hy0, 1e-4, true);
-  hard_solver.run(); 
+  const std::vector<double> t0 = {0.0, 2.5}; 
+  const std::vector<double> ey0 = {
+    easy_exact(0), easy_exact(1e-4), easy_exact(2.0 * 1e-4), easy_exact(3.0 * 1e-4)
+  };
 
-  auto& ht = hard_solver.t(); 
-  hy.reserve(ht.size());
-  for (auto& ti : ht) {
-    hy.push_back(hard_exact(ti));
-  }
+  const std::vector<double> hy0 = {
+    hard_exact(0), hard_exact(1e-4), hard_exact(2.0 * 1e-4), hard_exact(3.0 * 1e-4)
+  };
 
-  hard_solver.plot("Adam-Bashforth 4-Step with Adaptive Timestep", hy); 
+  compare("exp", easy_rate, easy_exact, t0, ey0); 
+  compare("logistic", hard_rate, hard_exact, t0, hy0); 
 
   return 0; 
 }
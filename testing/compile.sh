@@ -1,4 +1,4 @@
 #!/usr/bin/bash 
 
 rm -f *.o *.png ode
-g++ -O3 adaptive_multistep.cpp -o ode 
+g++ -std=c++20 -O3 -pthread adaptive_multistep.cpp -o ode 
@@ -1,7 +1,25 @@
 
+/*
+ * pingpong.c  Andrew Belles
+ *
+ * Launch angle targeting for a ping-pong ball with drag, wind and a step. 
+ * ./pingpong [parameters.txt ...] solves every parameter file given (the 
+ * defaults without one): the 179 one degree launch angles of every file 
+ * are scanned on all cores keeping only the landing point, sign changes 
+ * of the miss are solved by Illinois, and the solution trajectories are 
+ * plotted. Shots are adaptive Dormand-Prince 5(4) with wall and floor 
+ * contacts located inside the step, so params->dt is only the first step 
+ * and the plot spacing. Build with gcc -O2 -pthread pingpong.c -o pingpong 
+ * -lm, NOPLOT skips the plots 
+ *
+ */ 
+
 #include <math.h> 
+#include <pthread.h> 
+#include <stdatomic.h> 
 #include <stdio.h> 
 #include <stdlib.h> 
+#include <unistd.h> 
 
 typedef struct {
   double x, y;
@@ -20,79 +38,239 @@ typedef struct {
   double dt; 
 } params_t; 
 
+/*
+ * Growable point buffer. Doubles as an arena: a worker keeps one for its 
+ * whole lifetime and every trajectory it records reuses the same storage 
+ */ 
 typedef struct {
   point_t* array; 
   int size, max_size; 
 } data_t; 
 
+// x, y, vx, vy of the ball 
+typedef struct {
+  double u[4]; 
+} state_t; 
+
+enum { X = 0, Y = 1, VX = 2, VY = 3 }; 
+
+typedef enum {
+  NONE = 0, 
+  FRONT,     // front of the step, bounces 
+  FLOOR,     // floor before the step, lands 
+  BACK,      // back wall, bounces 
+  TOP        // top of the step, lands 
+} contact_e; 
+
+typedef double (*scalar_fn)(void* ctx, double x); 
+
 #define g 9.81 
 #define rad_one_deg M_PI / 180.0 
 #define TRAJCOUNT 179
 #define SOLCOUNT 4
+#define MAXTHREADS 64 
+#define ATOL 1e-10
+#define RTOL 1e-10
+#define TMAX 60.0
+#define MAXITER 100
 
 // Trajectory Functions 
-int hit(params_t* params, point_t a, point_t b);
-point_t linear_interpolate_known_y(point_t a,  point_t b, double y);
-double linear_interpolate_known_x(params_t* params, point_t a, point_t b, point_t avel, 
-                                point_t bvel, point_t* pos_new, point_t* vel_new, 
-                                double x); 
-data_t eulers(params_t* params, double theta);
-point_t step(params_t* params, point_t a, point_t b, double dt, int flag);
+point_t fly(params_t* params, double theta, data_t* traj, int* evals);
+double rk_step(params_t* params, const state_t* y, const state_t* f, double h, 
+               state_t* ynew, state_t* fnew); 
+double hermite(const state_t* y0, const state_t* f0, const state_t* y1, 
+               const state_t* f1, double h, double tau, int c); 
+contact_e contact(params_t* params, const state_t* y0, const state_t* f0, 
+                  const state_t* y1, const state_t* f1, double h, double* tau); 
+state_t rate(params_t* params, const state_t* s); 
 double force(params_t* params, point_t vel, int direction);
 
-// Bisection Functions 
-void map_trajectories(params_t* params, point_t* trajectories);
-void bisection(params_t* params, point_t* trajectories, 
-               double* solutions);
+// Root Finding Functions 
+double illinois(scalar_fn fn, void* ctx, double a, double fa, double b, double fb, 
+                double xtol, double ftol, int* evals); 
+int solve_angles(params_t* params, point_t* trajectories, double* solutions, int* evals);
+
+// Threading 
+typedef void (*job_fn)(void* ctx, int i, data_t* arena); 
+void parallel_for(int n, job_fn fn, void* ctx); 
 
 // File handling, etc. Functions 
-int parse_args(params_t* params, int argc, char* argv[]);
+int parse_args(params_t* params, const char* path);
+int plot(params_t* params, double* solutions, const char* png, data_t* arena); 
+
+// every parameter set of a batch with its scan and solutions 
+typedef struct {
+  params_t* params; 
+  point_t (*trajectories)[TRAJCOUNT]; 
+  double (*solutions)[SOLCOUNT]; 
+  char (*pngs)[64]; 
+  int* plotted; 
+  int* shots; 
+  int* evals; 
+} batch_t; 
+
+static void scan_job(void* ctx, int i, data_t* arena); 
+static void solve_job(void* ctx, int i, data_t* arena); 
 
 int main(int argc, char* argv[]) {
-  int i = 0, j = 0; 
-  double solutions[SOLCOUNT];
-  point_t trajectories[TRAJCOUNT];
-  params_t params; 
-  data_t traj; 
-  FILE* gp = NULL; 
-
-  switch (parse_args(&params, argc, argv)) {
-    case 0:
-      printf("Successfully loaded parameters from file: %s\n", argv[1]); 
-      break; 
-    case 1: 
-      printf("Pass a valid pointer to parameters to parse_args\n");
-      return 1; 
-    case 2: 
-      printf("Too many arguments. Usage: ./pingpong [parameters.txt]\n");
-      return 2;  
-    case 3: 
-      printf("Default parameters loaded\n"); 
-      break; 
-    case 4: 
-    case 5: 
-      printf("Invalid parameter file: %s\n", argv[1]);
-      return 3;  
-    default: 
-      break; 
+  int i = 0, j = 0, files = ( argc > 1 ) ? argc - 1 : 1; 
+  batch_t batch; 
+
+  batch.params       = malloc(files * sizeof(params_t)); 
+  batch.trajectories = malloc(files * sizeof(*batch.trajectories)); 
+  batch.solutions    = calloc(files, sizeof(*batch.solutions)); 
+  batch.pngs         = malloc(files * sizeof(*batch.pngs)); 
+  batch.plotted      = calloc(files, sizeof(int)); 
+  batch.shots        = calloc(files, sizeof(int)); 
+  batch.evals        = calloc(files, sizeof(int)); 
+  if ( !batch.params || !batch.trajectories || !batch.solutions || !batch.pngs 
+    || !batch.plotted || !batch.shots || !batch.evals ) {
+    printf("Failed to allocate %d parameter sets\n", files); 
+    return 5; 
   }
 
-  // Clear solution array to zeros 
-  for (i = 0; i < SOLCOUNT; i++) {
-    solutions[i] = 0.0; 
+  for (i = 0; i < files; i++) {
+    const char* path = ( argc > 1 ) ? argv[i + 1] : NULL; 
+    switch (parse_args(&batch.params[i], path)) {
+      case 0:
+        printf("Successfully loaded parameters from file: %s\n", path); 
+        break; 
+      case 1: 
+        printf("Pass a valid pointer to parameters to parse_args\n");
+        return 1; 
+      case 3: 
+        printf("Default parameters loaded\n"); 
+        break; 
+      case 4: 
+      case 5: 
+        printf("Invalid parameter file: %s\n", path);
+        return 3;  
+      default: 
+        break; 
+    }
+
+    // a single set keeps the historical output name 
+    if ( files == 1 ) {
+      snprintf(batch.pngs[i], sizeof(batch.pngs[i]), "solutions.png"); 
+    } else {
+      snprintf(batch.pngs[i], sizeof(batch.pngs[i]), "solutions_%d.png", i + 1); 
+    }
   }
 
-  map_trajectories(&params, trajectories);
-  bisection(&params, trajectories, solutions);
+  // every (file, angle) pair is independent, then one solve job per file 
+  parallel_for(files * TRAJCOUNT, scan_job, &batch); 
+  parallel_for(files, solve_job, &batch); 
+
+  for (i = 0; i < files; i++) {
+    printf("%s:", ( argc > 1 ) ? argv[i + 1] : "defaults"); 
+    for (j = 0; j < SOLCOUNT; j++) {
+      if ( batch.solutions[i][j] != 0.0 ) {
+        printf(" %.4lf", batch.solutions[i][j] * 180.0 / M_PI); 
+      }
+    }
+    printf(" deg (%d shots, %d rate evaluations)\n", batch.shots[i], batch.evals[i]); 
+    if ( batch.plotted[i] == 4 ) {
+      printf("Failed to open pipe to gnuplot\n"); 
+      return 4; 
+    }
+  }
+
+  free(batch.params); 
+  free(batch.trajectories); 
+  free(batch.solutions); 
+  free(batch.pngs); 
+  free(batch.plotted); 
+  free(batch.shots); 
+  free(batch.evals); 
+  return 0; 
+}
+
+static void scan_job(void* ctx, int i, data_t* arena) {
+  batch_t* batch = ctx; 
+  const int file = i / TRAJCOUNT, k = i % TRAJCOUNT; 
+  params_t* params = &batch->params[file]; 
+  const double angle = rad_one_deg * (double)(k + 1); 
+
+  (void)arena; 
+  batch->trajectories[file][k] = (point_t){angle, fly(params, angle, NULL, NULL).x - params->d}; 
+}
+
+static void solve_job(void* ctx, int i, data_t* arena) {
+  batch_t* batch = ctx; 
+
+  batch->shots[i] = solve_angles(&batch->params[i], batch->trajectories[i], 
+                                 batch->solutions[i], &batch->evals[i]); 
+  if ( getenv("NOPLOT") == NULL ) {
+    batch->plotted[i] = plot(&batch->params[i], batch->solutions[i], batch->pngs[i], arena); 
+  }
+}
+
+/*
+ * Runs fn(ctx, i, arena) for every i in [0, n) on up to one thread per core. 
+ * Jobs are handed out through an atomic counter, and each worker owns one 
+ * arena for all of its jobs, freed when it finishes 
+ */ 
+typedef struct {
+  job_fn fn; 
+  void* ctx; 
+  int n; 
+  atomic_int next; 
+} pool_t; 
+
+static void* worker(void* arg) {
+  pool_t* pool = arg; 
+  data_t arena = {NULL, 0, 0}; 
+  int i = 0; 
+
+  while ( (i = atomic_fetch_add(&pool->next, 1)) < pool->n ) {
+    pool->fn(pool->ctx, i, &arena); 
+  }
+
+  free(arena.array); 
+  return NULL; 
+}
+
+void parallel_for(int n, job_fn fn, void* ctx) {
+  pthread_t threads[MAXTHREADS]; 
+  long cores = sysconf(_SC_NPROCESSORS_ONLN); 
+  int count = 0, started = 0, i = 0; 
+  pool_t pool; 
+
+  pool.fn = fn; 
+  pool.ctx = ctx; 
+  pool.n = n; 
+  atomic_init(&pool.next, 0); 
+
+  count = ( cores < 1 ) ? 1 : ( cores > MAXTHREADS ) ? MAXTHREADS : (int)cores; 
+  count = ( count > n ) ? n : count; 
+
+  // the calling thread is one of the workers, a failed create just means fewer 
+  for (i = 1; i < count; i++) {
+    if ( pthread_create(&threads[started], NULL, worker, &pool) == 0 ) {
+      started++; 
+    }
+  }
+  worker(&pool); 
+
+  for (i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL); 
+  }
+}
+
+/*
+ * Solution trajectories through gnuplot into png, recorded one at a time into 
+ * the caller's arena. Returns 4 if the pipe could not be opened 
+ */ 
+int plot(params_t* params, double* solutions, const char* png, data_t* arena) {
+  int i = 0, j = 0; 
+  FILE* gp = popen("gnuplot", "w"); 
 
-  gp = popen("gnuplot", "w"); 
   if (gp == NULL) {
-    printf("Failed to open pipe to gnuplot\n"); 
     return 4; 
   }
 
   fprintf(gp, "set terminal pngcairo\n");
-  fprintf(gp, "set output 'solutions.png'\n");
+  fprintf(gp, "set output '%s'\n", png);
   fprintf(gp, "set xlabel 'x [m]'\n");
   fprintf(gp, "set ylabel 'z [m]'\n");
   fprintf(gp, "set title 'Solution Trajectories'\n");
@@ -111,23 +289,20 @@ int main(int argc, char* argv[]) {
 
   for (i = 0; i < SOLCOUNT; i++) {
     if (solutions[i] != 0.0) {
-      traj = eulers(&params, solutions[i]);
-      for (j = 0; j < traj.size; j++) {
-        fprintf(gp, "%lf %lf\n", traj.array[j].x, traj.array[j].y);
+      fly(params, solutions[i], arena, NULL);
+      for (j = 0; j < arena->size; j++) {
+        fprintf(gp, "%lf %lf\n", arena->array[j].x, arena->array[j].y);
       }
       fprintf(gp, "e\n");
-      free(traj.array);
     }
   }
 
   fprintf(gp, "unset output\n");
   pclose(gp);
-
   return 0; 
 }
 
-
-int parse_args(params_t* params, int argc, char* argv[]) {
+int parse_args(params_t* params, const char* path) {
   FILE* param_file = NULL; 
   const params_t defaults = (params_t){
     .m   = 2.7e-3, 
@@ -145,18 +320,14 @@ int parse_args(params_t* params, int argc, char* argv[]) {
   if ( params == NULL ) {
     return 1; 
   }
-  
-  if (argc > 2) {
-    return 2; 
-  }
 
   // default parameters 
-  if (argc == 1) {
+  if (path == NULL) {
     (*params) = defaults;  
     return 3; 
   }
 
-  param_file = fopen(argv[1], "r"); 
+  param_file = fopen(path, "r"); 
   if (param_file == NULL) {
     return 4; 
   }
@@ -196,85 +367,268 @@ int parse_args(params_t* params, int argc, char* argv[]) {
   return 0; 
 }
 
-data_t eulers(params_t* params, double theta) {
-  data_t trajectory;
-  int done = 0, status = 0; 
-  double t_remaining = 0.0, wall_distance = 0.0, floor_height = 0.0;
-  point_t p = {0.0, 0.0}, pnext;
-  point_t v = {params->v0 * cos(theta), params->v0 * sin(theta)}, vnext; 
-
-  trajectory.array = (point_t*)malloc(1000 * sizeof(point_t));
-  trajectory.max_size = 1000; 
-  trajectory.size = 0; 
-
-  while (!done) {
-    // Ensure data array isn't at Capacity 
-    if (trajectory.size == trajectory.max_size) {
-      trajectory.max_size *= 2; 
-      trajectory.array = (point_t*)realloc(trajectory.array, 
-                                           trajectory.max_size * sizeof(point_t));
+/*
+ * Dormand-Prince 5(4) tableau, FSAL: the seventh stage is the rate at the 
+ * new state and becomes the first stage of the next step 
+ */ 
+static const double dp_a[6][5] = {
+  {1.0 / 5.0}, 
+  {3.0 / 40.0, 9.0 / 40.0}, 
+  {44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0}, 
+  {19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0}, 
+  {9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0}, 
+  {35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0} 
+}; 
+static const double dp_b6 = 11.0 / 84.0; 
+static const double dp_e[7] = {
+  71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0, -17253.0 / 339200.0, 
+  22.0 / 525.0, -1.0 / 40.0 
+}; 
+
+state_t rate(params_t* params, const state_t* s) {
+  point_t vel = {s->u[VX], s->u[VY]}; 
+  return (state_t){{s->u[VX], s->u[VY], force(params, vel, 0), force(params, vel, 1)}}; 
+}
+
+/*
+ * One step of size h from y with f = rate(y). Writes the new state and its 
+ * rate, returns the error estimate scaled by ATOL + RTOL |y| (accept <= 1) 
+ */ 
+double rk_step(params_t* params, const state_t* y, const state_t* f, double h, 
+               state_t* ynew, state_t* fnew) {
+  state_t k[7], s; 
+  double err = 0.0, e = 0.0, scale = 0.0; 
+  int i = 0, j = 0, c = 0; 
+
+  k[0] = *f; 
+  for (i = 0; i < 6; i++) {
+    s = *y; 
+    for (j = 0; j <= i && j < 5; j++) {
+      for (c = 0; c < 4; c++) {
+        s.u[c] += h * dp_a[i][j] * k[j].u[c]; 
+      }
     }
-    
-    // Get next velocity and Position 
-    vnext = step(params, p, v, params->dt, 1); 
-    pnext = step(params, p, v, params->dt, 0);
-
-    // Handle hit against wall or floor 
-    status = hit(params, p, pnext);
-    switch (status) {
-      case 1: 
-      case 3: 
-        // Get x distance to interpolate position and velocity into  
-        wall_distance = (status == 1)? params->ds : params->dw; 
-        t_remaining = linear_interpolate_known_x(params, p, pnext, v, vnext, 
-                                                 &pnext, &vnext, wall_distance);
-        // Remaining timestep after moving point to interpolated position at wall 
-        t_remaining = params->dt - t_remaining * params->dt; 
-        pnext = step(params, pnext, vnext, t_remaining, 0);
-        vnext = step(params, pnext, vnext, t_remaining, 1); 
-        break; 
-      case 2: 
-      case 4: 
-        // Interpolate with ground at either 0 or the step, flag that we are done
-        floor_height = (status == 2)? 0.0 : params->hs; 
-        pnext = linear_interpolate_known_y(p, pnext, floor_height); 
-        done = 1; 
-        break; 
-      case 0:
-      default: 
-        // Do nothing 
-        break; 
-    } 
+    // the last row is the solution weights, b5 is outside the 5 wide table 
+    if ( i == 5 ) {
+      for (c = 0; c < 4; c++) {
+        s.u[c] += h * dp_b6 * k[5].u[c]; 
+      }
+    }
+    k[i + 1] = rate(params, &s); 
+  }
 
-    // Update position and velocity, store values 
-    p = pnext; 
-    v = vnext; 
-    trajectory.array[trajectory.size] = p; 
-    trajectory.size++; 
+  for (c = 0; c < 4; c++) {
+    e = 0.0; 
+    for (j = 0; j < 7; j++) {
+      e += dp_e[j] * k[j].u[c]; 
+    }
+    scale = ATOL + RTOL * fmax(fabs(y->u[c]), fabs(s.u[c])); 
+    err = fmax(err, fabs(h * e) / scale); 
   }
 
-  return trajectory;
+  *ynew = s; 
+  *fnew = k[6]; 
+  return err; 
 }
 
-point_t step(params_t* params, point_t pos, point_t vel, double dt, int flag) {
-  point_t new; 
+// cubic Hermite through both ends of a step, at tau in [0, h] 
+double hermite(const state_t* y0, const state_t* f0, const state_t* y1, 
+               const state_t* f1, double h, double tau, int c) {
+  double s = tau / h, s2 = s * s, s3 = s2 * s; 
+  return (2.0 * s3 - 3.0 * s2 + 1.0) * y0->u[c] + (s3 - 2.0 * s2 + s) * h * f0->u[c] 
+       + (3.0 * s2 - 2.0 * s3) * y1->u[c] + (s3 - s2) * h * f1->u[c]; 
+}
 
-  switch (flag) {
-    // Update position, b is the velocity 
-    case 0: 
-      new.x = pos.x + dt * vel.x; 
-      new.y = pos.y + dt * vel.y; 
-      break; 
-    // Update velocity 
-    case 1: 
-      new.x = vel.x + dt * force(params, vel, 0);
-      new.y = vel.y + dt * force(params, vel, 1); 
+/*
+ * Illinois regula falsi on a sign change fa fb <= 0 of [a, b]. Stops when 
+ * |f| <= ftol or the bracket is inside xtol, counting calls in evals 
+ */ 
+double illinois(scalar_fn fn, void* ctx, double a, double fa, double b, double fb, 
+                double xtol, double ftol, int* evals) {
+  double x = a, fx = fa; 
+  int side = 0, i = 0; 
+
+  if ( fabs(fa) <= ftol ) {
+    return a; 
+  }
+  if ( fabs(fb) <= ftol ) {
+    return b; 
+  }
+
+  for (i = 0; i < MAXITER && fabs(b - a) > xtol; i++) {
+    x = (a * fb - b * fa) / (fb - fa); 
+    fx = fn(ctx, x); 
+    if ( evals ) {
+      (*evals)++; 
+    }
+    if ( fabs(fx) <= ftol ) {
       break; 
-    default: 
-      break;
+    }
+
+    // halve the stale end's weight whenever the same end is kept twice 
+    if ( fx * fb < 0.0 ) {
+      a = b; 
+      fa = fb; 
+      side = 0; 
+    } else if ( side == 1 ) {
+      fa *= 0.5; 
+    } else {
+      side = 1; 
+    }
+    b = x; 
+    fb = fx; 
+  }
+
+  return x; 
+}
+
+// a contact surface crossed inside one step 
+typedef struct {
+  const state_t *y0, *f0, *y1, *f1; 
+  double h, level; 
+  int c; 
+} crossing_t; 
+
+static double crossing(void* ctx, double tau) {
+  crossing_t* cr = ctx; 
+  return hermite(cr->y0, cr->f0, cr->y1, cr->f1, cr->h, tau, cr->c) - cr->level; 
+}
+
+/*
+ * Earliest contact inside the step y0 -> y1 of size h, located on the 
+ * dense output. The four surfaces are the same as before: front of the 
+ * step below its top, the floor before it, the back wall and the top of 
+ * the step. Returns the contact (NONE if there is none) and its offset 
+ */ 
+contact_e contact(params_t* params, const state_t* y0, const state_t* f0, 
+                  const state_t* y1, const state_t* f1, double h, double* tau) {
+  const double ds = params->ds, hs = params->hs, dw = params->dw; 
+  const struct { contact_e kind; int c; double level, sign; } surfaces[4] = {
+    {FRONT, X, ds, 1.0}, {FLOOR, Y, 0.0, -1.0}, {BACK, X, dw, 1.0}, {TOP, Y, hs, -1.0} 
+  }; 
+  crossing_t cr = {y0, f0, y1, f1, h, 0.0, 0}; 
+  contact_e found = NONE; 
+  double g0 = 0.0, g1 = 0.0, root = 0.0, x = 0.0, y = 0.0; 
+  int i = 0; 
+
+  for (i = 0; i < 4; i++) {
+    // only crossings in the direction of travel into the surface 
+    g0 = surfaces[i].sign * (y0->u[surfaces[i].c] - surfaces[i].level); 
+    g1 = surfaces[i].sign * (y1->u[surfaces[i].c] - surfaces[i].level); 
+    if ( !(g0 < 0.0 && g1 >= 0.0) ) {
+      continue; 
+    }
+
+    cr.c = surfaces[i].c; 
+    cr.level = surfaces[i].level; 
+    root = illinois(crossing, &cr, 0.0, surfaces[i].sign * g0, h, surfaces[i].sign * g1, 
+                    1e-15 * h, 0.0, NULL); 
+    if ( found != NONE && root >= *tau ) {
+      continue; 
+    }
+
+    x = hermite(y0, f0, y1, f1, h, root, X); 
+    y = hermite(y0, f0, y1, f1, h, root, Y); 
+    if ( (surfaces[i].kind == FRONT && y < hs) 
+      || (surfaces[i].kind == FLOOR && x < ds) 
+      || (surfaces[i].kind == BACK) 
+      || (surfaces[i].kind == TOP && x >= ds && x < dw) ) {
+      found = surfaces[i].kind; 
+      *tau = root; 
+    }
+  }
+
+  return found; 
+}
+
+static void record(data_t* traj, double x, double y) {
+  if ( traj->size == traj->max_size ) {
+    int grown = ( traj->max_size > 0 ) ? 2 * traj->max_size : 1000; 
+    point_t* array = (point_t*)realloc(traj->array, grown * sizeof(point_t)); 
+    if ( array == NULL ) {
+      exit( 99 ); 
+    }
+    traj->array = array; 
+    traj->max_size = grown; 
+  }
+  traj->array[traj->size] = (point_t){x, y}; 
+  traj->size++; 
+}
+
+/*
+ * Integrates one launch to its landing point with adaptive Dormand-Prince 
+ * steps, starting at params->dt. Contacts are located inside the step on 
+ * the dense output, polished by one Newton step on the exact state, and the 
+ * ball is restarted from the wall with its x velocity reversed. With traj 
+ * NULL nothing but the running state is kept; otherwise traj is refilled 
+ * with the dense output every params->dt and the contact points. evals, if 
+ * not NULL, accumulates rate evaluations 
+ */ 
+point_t fly(params_t* params, double theta, data_t* traj, int* evals) {
+  state_t y = {{0.0, 0.0, params->v0 * cos(theta), params->v0 * sin(theta)}}; 
+  state_t f = rate(params, &y), ynew, fnew; 
+  double t = 0.0, h = params->dt, tau = 0.0, step = 0.0, err = 0.0; 
+  double sample = 0.0, level = 0.0; 
+  contact_e hit = NONE; 
+  int calls = 1, c = 0; 
+
+  if ( traj ) {
+    traj->size = 0; 
+    record(traj, 0.0, 0.0); 
+    sample = params->dt; 
+  }
+
+  while ( t < TMAX ) {
+    err = rk_step(params, &y, &f, h, &ynew, &fnew); 
+    calls += 6; 
+    if ( err > 1.0 ) {
+      h *= fmax(0.2, 0.9 * pow(err, -0.2)); 
+      continue; 
+    }
+
+    hit = contact(params, &y, &f, &ynew, &fnew, h, &tau); 
+    if ( hit != NONE ) {
+      // Newton on the exact state, the contact coordinate moves at its rate 
+      c = ( hit == FRONT || hit == BACK ) ? X : Y; 
+      level = ( hit == FRONT ) ? params->ds : ( hit == BACK ) ? params->dw 
+            : ( hit == TOP ) ? params->hs : 0.0; 
+      rk_step(params, &y, &f, tau, &ynew, &fnew); 
+      tau -= (ynew.u[c] - level) / fnew.u[c]; 
+      rk_step(params, &y, &f, tau, &ynew, &fnew); 
+      calls += 12; 
+    }
+    step = ( hit != NONE ) ? tau : h; 
+
+    while ( traj && sample < t + step ) {
+      record(traj, hermite(&y, &f, &ynew, &fnew, step, sample - t, X), 
+             hermite(&y, &f, &ynew, &fnew, step, sample - t, Y)); 
+      sample += params->dt; 
+    }
+
+    t += step; 
+    y = ynew; 
+    f = fnew; 
+
+    if ( hit != NONE ) {
+      y.u[c] = level; 
+      if ( traj ) {
+        record(traj, y.u[X], y.u[Y]); 
+      }
+      if ( hit == FLOOR || hit == TOP ) {
+        break; 
+      }
+      y.u[VX] = -y.u[VX]; 
+      f = rate(params, &y); 
+      calls++; 
+    } else {
+      h *= fmin(5.0, fmax(0.2, 0.9 * pow(fmax(err, 1e-10), -0.2))); 
+    }
   }
 
-  return new; 
+  if ( evals ) {
+    (*evals) += calls; 
+  }
+  return (point_t){y.u[X], y.u[Y]}; 
 }
 
 double force(params_t* params, point_t vel, int direction) {
@@ -296,139 +650,50 @@ double force(params_t* params, point_t vel, int direction) {
   }
 }
 
-int hit(params_t* params, point_t a, point_t b) {
-  int status = 0; 
-  double ds = params->ds, hs = params->hs, dw = params->dw;  
-
-  // Hit front of step
-  if ( (a.x < ds && b.x >= ds) && b.y < hs ) {
-    status = 1; 
-  } 
-
-  // Hit floor before step
-  if ( (b.x < ds && a.x < ds) && (b.y <= 0.0 && a.y > 0.0) ) {
-    status = 2; 
-  } 
-
-  // Hit back wall 
-  if ( (a.x < dw && b.x > dw) ) {
-    status = 3; 
-  }
-
-  // Hit on top of step 
-  if ( (b.x >= ds && b.x < dw ) 
-    && (a.y > hs && b.y <= hs) ) {
-    status = 4; 
-  } 
-
-  return status;
-}
-
-point_t linear_interpolate_known_y(point_t a,  point_t b, double y) {
-  double dy = b.y - a.y;
-  double dx = b.x - a.x; 
-  double t = 0.0; 
-
-  // Prevent division by zero 
-  if (fabs(dy) < 1e-12) {
-    return (point_t){b.x, y}; 
-  }
-
-  // Similar triangle ratio, return interpolated point 
-  t = (y - a.y) / dy; 
-  return (point_t){a.x + t * dx, y};
-}
-
-double linear_interpolate_known_x(params_t* params, point_t a, point_t b, point_t avel, 
-                                  point_t bvel, point_t* pos_new, point_t* vel_new, 
-                                  double x) {
-  double dy = b.y - a.y; 
-  double dx = b.x - a.x; 
-  double t = (x - a.x) / dx; 
-  point_t p = (point_t){x - params->eps, a.y + t * dy};
-  point_t v = (point_t){
-    .x = -(avel.x + t * (bvel.x - avel.x)), 
-    .y = avel.y + t * (bvel.y - avel.y)
-  };
-
-  // Update values 
-  (*pos_new) = p; 
-  (*vel_new) = v; 
-  return t; 
-}
-
-void map_trajectories(params_t* params, point_t* trajectories) {
-  int i = 0, last = 0; 
-  double angle = 0.0, xfinal = 0.0, error = 0.0;
-  data_t traj; 
-
-  for (i = 0; i < TRAJCOUNT; i++) {
-    angle = rad_one_deg * (double)(i + 1);  
-    traj = eulers(params, angle);  
+// miss at the target for one launch angle, counting shots and rate calls 
+typedef struct {
+  params_t* params; 
+  int evals; 
+} shot_t; 
 
-    last = traj.size - 1; 
-    xfinal = traj.array[last].x; 
-    error = xfinal - params->d; 
-    trajectories[i] = (point_t){angle, error};
-    
-    free(traj.array);
-  }
+static double miss(void* ctx, double theta) {
+  shot_t* shot = ctx; 
+  return fly(shot->params, theta, NULL, &shot->evals).x - shot->params->d; 
 }
 
-void bisection(params_t* params, point_t* trajectories, 
-               double* solutions) {
-  int L = 0, R = 0, S = 0, done = 0; 
-  double error = 0.0, mid_angle = 0.0, left_angle = 0.0, right_angle = 0.0; 
-  double left_final = 0.0, right_final = 0.0; 
-  data_t traj; 
+/*
+ * Every sign change of the scanned miss is solved by Illinois until the 
+ * landing is within params->eps of the target. Fills solutions, returns the 
+ * shots taken beyond the scan, rate evaluations of those shots in evals 
+ */ 
+int solve_angles(params_t* params, point_t* trajectories, double* solutions, int* evals) {
+  shot_t shot = {params, 0}; 
+  int L = 0, R = 0, S = 0, shots = 0; 
 
-  while (!done && L < TRAJCOUNT - 1 && S < SOLCOUNT) {
+  while (L < TRAJCOUNT - 1 && S < SOLCOUNT) {
     R = L + 1; 
 
-    // Set up starting bracket for current Bisection 
+    // Set up starting bracket for the next root 
     while (R < TRAJCOUNT && (trajectories[L].y * trajectories[R].y) > 0.0) {
       R++; 
     }
 
     // If R made it to end, we do not have any more solutions 
     if (R >= TRAJCOUNT) {
-      done = 1; 
-    } else {
-      left_angle = trajectories[L].x; 
-      right_angle = trajectories[R].x; 
-      left_final = trajectories[L].y; 
-      right_final = trajectories[R].y; 
-
-      // Initialize Error, and First angle to left bracket in case it is a solution 
-      error = left_final; 
-      mid_angle = left_angle; 
-
-      while (fabs(error) > params->eps) {
-        // Simulate trajectory with mid angle 
-        mid_angle = 0.5 * (left_angle + right_angle); 
-        traj = eulers(params, mid_angle); 
-        error = traj.array[traj.size - 1].x - params->d; 
-
-        // If mid angle is on same side as left, replace L else replace R 
-        if (left_final * error <= 0.0) {
-          right_angle = mid_angle; 
-          right_final = error; 
-        } else {
-          left_angle = mid_angle; 
-          left_final = error; 
-        }
+      break; 
+    }
 
-        free(traj.array);
-      } 
+    solutions[S] = illinois(miss, &shot, trajectories[L].x, trajectories[L].y, 
+                            trajectories[R].x, trajectories[R].y, 1e-12, params->eps, 
+                            &shots); 
+    S++; 
 
-      // Add solution safely 
-      if (L < TRAJCOUNT) {
-        solutions[S] = mid_angle; 
-        S++; 
-      }
+    // Update left bracket to previous right bracket 
+    L = R; 
+  }
 
-      // Update left brack to previous right bracket; 
-      L = R; 
-    }
+  if ( evals ) {
+    (*evals) = shot.evals; 
   }
+  return shots; 
 }